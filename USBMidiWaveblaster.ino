@@ -29,16 +29,121 @@
 #include "hardware_config.h"
 #include "usb_midi.h"
 #include "usb_midi_device.h"
+#include "serial_tx.h"
+#include "serial_rx.h"
+#include "cycle_counter.h"
+#include "latency.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "trace.h"
+#include "utilization.h"
 #include "config.h"
 
 #define LED_FLASH_TIME 5
 #define LED_IDLE_TIME  500
 
+// Maximum number of USB packets processed in one loop iteration
+#ifndef USB_PACKET_BATCH_SIZE
+ #define USB_PACKET_BATCH_SIZE (MIDI_STREAM_EPSIZE / 4)
+#endif
+
+// Window of pending packets which are held before writing them to serial ports
+#if USB_MIDI_IO_PORT_NUM >= 2 && defined(CFG_PORT_COALESCE_WINDOW_US) && CFG_PORT_COALESCE_WINDOW_US > 0
+  #define PORT_COALESCE_WINDOW
+#endif
+
+#if defined(CFG_SERIAL_LOAD_SHEDDING) && CFG_SERIAL_LOAD_SHEDDING > 0
+  #define LOAD_SHEDDING
+#endif
+
+#if defined(CFG_SERIAL_NOTE_PRIORITY) && CFG_SERIAL_NOTE_PRIORITY > 0
+  #define NOTE_PRIORITY
+#endif
+
+#if defined(PORT_COALESCE_WINDOW) || defined(LOAD_SHEDDING) || defined(NOTE_PRIORITY)
+  #define PENDING_WINDOW
+  #ifdef NOTE_PRIORITY
+    // Maximum number of pending packets, notes can overtake all packets taken from the USB receive buffer
+    #define PENDING_WINDOW_SIZE USB_MIDI_RX_RING_SIZE
+  #else
+    #define PENDING_WINDOW_SIZE 32 // Maximum number of pending packets
+  #endif
+#endif
+
+#if USB_MIDI_IO_PORT_NUM >= 2 && defined(CFG_SERIAL_SYSEX_STAGING) && CFG_SERIAL_SYSEX_STAGING > 0
+  #define SYSEX_STAGING
+  #define SYSEX_STAGING_BLOCKS  (CFG_SERIAL_SYSEX_STAGING < 255 ? CFG_SERIAL_SYSEX_STAGING : 254)
+  #define SYSEX_STAGING_PACKETS 16 // Number of packets in one block
+  #define SYSEX_STAGING_NONE    0xFF
+#endif
+
+#if defined(CFG_SERIAL_REALTIME_EXPRESS) && CFG_SERIAL_REALTIME_EXPRESS > 0
+  #define REALTIME_EXPRESS
+#endif
+
+#if defined(CFG_SERIAL_CHANNEL_SHADOW) && CFG_SERIAL_CHANNEL_SHADOW > 0
+  #define CHANNEL_SHADOW
+#endif
+
+#if SERIAL_INTERFACE_MAX >= 2 && defined(CFG_SERIAL_CHANNEL_SPREAD) && CFG_SERIAL_CHANNEL_SPREAD > 0
+  #define CHANNEL_SPREAD
+  #define CHANNEL_SPREAD_NONE 0xFF
+#endif
+
+#if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+  #define SERIAL_MIDI_IN
+  #define USB_IN_BATCH_SIZE (MIDI_STREAM_EPSIZE / 4) // Maximum number of packets in one IN transaction
+  #define USB_IN_FLUSH_US   1000 // Maximum time (microseconds) a packet waits for more packets
+#endif
+
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+  #define LATENCY_HISTOGRAM
+#endif
+
+#if defined(CFG_PERF_COUNTERS) && CFG_PERF_COUNTERS > 0
+  #define PERF_COUNTERS
+#endif
+
+#if defined(CFG_PROFILER) && CFG_PROFILER > 0
+  #define PROFILER
+#endif
+
+#if defined(CFG_PACKET_TRACE) && CFG_PACKET_TRACE > 0
+  #define PACKET_TRACE
+#endif
+
+#if defined(CFG_SERIAL_UTILIZATION) && CFG_SERIAL_UTILIZATION > 0
+  #define SERIAL_UTILIZATION
+  #define LED_SATURATED_TIME 100 // LED blinking period (on / off) while a serial port is saturated
+#endif
+
+// Diagnostic SysEx queries need the USB MIDI IN endpoint for replies
+// (the histograms, counters, profile and trace can't be read otherwise)
+#if ( defined(LATENCY_HISTOGRAM) || defined(PERF_COUNTERS) || defined(PROFILER) || defined(PACKET_TRACE) ) && !defined(SERIAL_MIDI_IN)
+  #error "CFG_LATENCY_HISTOGRAM, CFG_PERF_COUNTERS, CFG_PROFILER and CFG_PACKET_TRACE require CFG_USB_MIDI_IN"
+#endif
+
+#if defined(SERIAL_MIDI_IN) && ( defined(LATENCY_HISTOGRAM) || defined(PERF_COUNTERS) || defined(PROFILER) || defined(PACKET_TRACE) || defined(SERIAL_UTILIZATION) )
+  #define DIAG_SYSEX
+  #define DIAG_ID_0         0x7D // Non-commercial manufacturer ID
+  #define DIAG_ID_1         0x57
+  #define DIAG_NONE         0xFF
+  #define DIAG_MESSAGE_SIZE 128  // Maximum length of reply message
+#endif
+
 typedef union  {
     uint32_t i;
     uint8_t  packet[4];
 } __packed midiPacket_t;
 
+// State of the MIDI stream sent to serial ports
+typedef struct {
+    uint8_t runningStatus;
+    uint8_t lastPort;
+    uint8_t sysEx;          // SysEx was started and not ended yet
+    uint8_t selectPort;     // Port Selection messages are sent (the serial port receives multiple USB MIDI ports)
+} serialState_t;
+
 // Serial interfaces Array
 HardwareSerial * serialHw[SERIAL_INTERFACE_MAX] = {SERIALS_PLIST};
 uint32_t serialSpeed[SERIAL_INTERFACE_MAX];
@@ -46,117 +151,1239 @@ uint32_t serialSpeed[SERIAL_INTERFACE_MAX];
 // USB Midi object & globals
 USBMidi MidiUSB;
 bool midiUSBCx    = false;
-bool isSerialBusy = false;
 
 bool ledStatus;
 
-uint8_t runningStatus = 0;
-uint8_t lastPort = 0xFF;
-uint8_t portSelection[2] = { 0xF5, 0x01 };
+// State of the MIDI stream of each serial port
+serialState_t serialState[SERIAL_INTERFACE_MAX];
+
+#ifdef SERIAL_MIDI_IN
+// USB MIDI port receiving MIDI from each serial port
+uint8_t serialInputPort[SERIAL_INTERFACE_MAX];
+
+// Packets received from serial ports which are waiting for the USB MIDI IN endpoint
+uint32_t usbInPackets[USB_IN_BATCH_SIZE];
+uint32_t usbInCount = 0;
+uint32_t usbInTime = 0;     // Arrival time of the first packet (microseconds)
+bool usbInZeroLength = false; // Last transaction was full, the transfer must be ended
+#endif
+
+// Number of bytes which can still be written to each serial port without blocking
+uint32_t serialCredit[SERIAL_INTERFACE_MAX];
+
+#if defined(REALTIME_EXPRESS) && USB_MIDI_IO_PORT_NUM >= 2
+// Number of bytes written to each serial port after the last Port Selection message
+uint32_t serialSelectAge[SERIAL_INTERFACE_MAX];
+#endif
+
+// Enabled serial ports receiving packets from each USB MIDI port (bit mask)
+uint8_t serialRouting[USB_MIDI_IO_PORT_NUM];
+
+#ifdef CHANNEL_SPREAD
+// Serial port assigned to each channel of each port (or CHANNEL_SPREAD_NONE)
+uint8_t spreadPort[USB_MIDI_IO_PORT_NUM][16];
+
+// Number of channels assigned to each serial port
+uint8_t spreadChannels[SERIAL_INTERFACE_MAX];
+#endif
+
+#ifdef PENDING_WINDOW
+typedef struct {
+    uint32_t packet;
+    uint32_t time;  // Arrival time (microseconds)
+#ifdef LATENCY_HISTOGRAM
+    uint32_t start; // Cycle counter at USB reception
+#endif
+} pendingPacket_t;
+
+// Pending packets in order of arrival
+pendingPacket_t pendingPackets[PENDING_WINDOW_SIZE];
+uint32_t pendingCount = 0;
+uint32_t pendingNow = 0;
+#endif
+
+#ifdef LOAD_SHEDDING
+// Serial ports are congested, merge pending messages
+bool sheddingActive = false;
+
+// Number of dropped (merged) packets
+uint32_t sheddingDroppedPackets = 0;
+#endif
+
+#ifdef NOTE_PRIORITY
+// Serial ports are congested, send notes first
+bool priorityActive = false;
+#endif
+
+#ifdef SYSEX_STAGING
+// Block of staged packets
+typedef struct {
+    uint32_t packets[SYSEX_STAGING_PACKETS];
+    uint8_t next;   // Next block in the chain (or in the list of free blocks)
+} stagingBlock_t;
+
+// Chain of blocks with staged packets of one port
+typedef struct {
+    uint8_t head;   // First block (SYSEX_STAGING_NONE = no staged packets)
+    uint8_t tail;   // Last block
+    uint8_t read;   // Index of the first packet in the first block
+    uint8_t write;  // Index after the last packet in the last block
+} stagingChain_t;
+
+stagingBlock_t stagingPool[SYSEX_STAGING_BLOCKS];
+uint8_t stagingFree;
+stagingChain_t stagingChains[USB_MIDI_IO_PORT_NUM];
+#endif
+
+#ifdef CHANNEL_SHADOW
+// Values in the channel state shadow
+enum {
+    SHADOW_PROGRAM = 0,
+    SHADOW_BANK_MSB,    // CC 0
+    SHADOW_BANK_LSB,    // CC 32
+    SHADOW_VOLUME,      // CC 7
+    SHADOW_PAN,         // CC 10
+    SHADOW_NRPN_LSB,    // CC 98
+    SHADOW_NRPN_MSB,    // CC 99
+    SHADOW_RPN_LSB,     // CC 100
+    SHADOW_RPN_MSB,     // CC 101
+    SHADOW_VALUES
+};
+
+#define SHADOW_UNKNOWN 0x80
+
+// Last sent values (7 bits) or SHADOW_UNKNOWN for each port and channel
+uint8_t channelShadow[USB_MIDI_IO_PORT_NUM][16][SHADOW_VALUES];
+
+// Number of bytes of dropped messages
+uint32_t shadowSuppressedBytes = 0;
+#endif
+
+#ifdef LATENCY_HISTOGRAM
+// Cycle counter at USB reception of the packet being accepted and of the packet being written
+// (0 = unknown, the latency of the packet isn't measured)
+uint32_t latencyArrival = 0;
+uint32_t latencyStart = 0;
+#endif
+
+#ifdef PACKET_TRACE
+// Packet which stalled last and its trace entry (a stalled packet is retried, but traced only once)
+bool traceStalled = false;
+uint32_t traceStallPacket = 0;
+uint32_t traceStallIndex = 0;
+#endif
+
+#ifdef DIAG_SYSEX
+// Diagnostic SysEx messages "F0 7D 57 cc ... F7"
+// Queries from the host are not sent to serial ports, replies are sent to the same USB MIDI port
+enum {
+    DIAG_LATENCY_DUMP = 0x01,   // Reply "F0 7D 57 01 pp cc <bucket 0-23> F7" for each port and message class,
+                                // each bucket is 32-bit value in 5 bytes (7 bits each, least significant first)
+    DIAG_LATENCY_RESET = 0x02,  // Reply "F0 7D 57 02 F7"
+    DIAG_COUNTERS = 0x03,       // Reply "F0 7D 57 03 nn <counter 1-nn> F7", each counter is 32-bit value in 5 bytes:
+                                // USB received packets, USB NAK periods, USB dropped packets, serial stalls,
+                                // Running Status saved bytes, Port Selection messages, Channel Shadow suppressed bytes,
+                                // Load Shedding dropped packets, serial port 1-n bytes
+    DIAG_PROFILER_DUMP = 0x04,  // Reply "F0 7D 57 04 ss <count> <min> <avg> <max> F7" for each profiled section,
+                                // each value is 32-bit value in 5 bytes (cycles)
+    DIAG_PROFILER_RESET = 0x05, // Reply "F0 7D 57 05 F7"
+    DIAG_TRACE_DUMP = 0x06,     // Reply "F0 7D 57 06 <entry> F7" for each trace entry (oldest first),
+                                // the 16 bytes of the entry are packed to 19 bytes (7 bits each)
+    DIAG_TRACE_RESET = 0x07,    // Reply "F0 7D 57 07 F7"
+    DIAG_UTILIZATION = 0x08,    // Reply "F0 7D 57 08 nn <serial port 1-nn> F7", utilization of each serial port (percent)
+                                // as 32-bit value in 5 bytes
+};
+
+uint8_t diagQueryPort = DIAG_NONE;  // USB MIDI port sending a query
+uint8_t diagQueryCmd;               // Command of the query (DIAG_NONE = not received yet)
+uint8_t diagReplyPort = DIAG_NONE;  // USB MIDI port receiving a reply
+uint8_t diagReplyCmd;
+uint32_t diagReplyIndex;            // Index of the next reply message
+uint8_t diagMessage[DIAG_MESSAGE_SIZE];
+uint8_t diagMessageLen = 0;
+uint8_t diagMessagePos = 0;         // Bytes of the reply message which were already sent
+#endif
+
+// Reset the state of the MIDI stream (when USB is disconnected)
+void SerialStateReset(serialState_t *state)
+{
+    state->runningStatus = 0;
+    state->lastPort = 0xFF;
+    state->sysEx = 0;
+}
+
+// Route USB MIDI ports to enabled serial ports
+void SerialRoutingInit(void)
+{
+#ifdef CFG_SERIAL_ROUTING
+    static const uint8_t routing[] = { CFG_SERIAL_ROUTING };
+#endif
+    uint8_t enabled = 0;
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( serialSpeed[s] != 0 ) enabled |= 1 << s;
+    }
+
+    for ( uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM ; port++ )
+    {
+#ifdef CFG_SERIAL_ROUTING
+        serialRouting[port] = ( port < sizeof(routing) ) ? (routing[port] & enabled) : 0;
+#else
+        serialRouting[port] = enabled;
+#endif
+    }
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        uint8_t ports = 0;
+#ifdef SERIAL_MIDI_IN
+        serialInputPort[s] = 0;
+#endif
+
+        for ( uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM ; port++ )
+        {
+            if ( serialRouting[port] & (1 << s) )
+            {
+#ifdef SERIAL_MIDI_IN
+                if ( ports == 0 ) serialInputPort[s] = port;
+#endif
+                ports++;
+            }
+        }
+
+        serialState[s].selectPort = ( ports >= 2 );
+        SerialStateReset(&serialState[s]);
+    }
+}
+
+// Get the serial ports receiving packets from the USB MIDI port (bit mask)
+static inline uint8_t SerialRoute(uint8_t port)
+{
+#if USB_MIDI_IO_PORT_NUM < 16
+    if ( port >= USB_MIDI_IO_PORT_NUM ) return 0;
+#endif
+
+    return serialRouting[port];
+}
+
+#ifdef CHANNEL_SPREAD
+// Forget the serial ports assigned to channels
+void SpreadInit(void)
+{
+    memset(spreadPort, CHANNEL_SPREAD_NONE, sizeof(spreadPort));
+    memset(spreadChannels, 0, sizeof(spreadChannels));
+}
+
+// Assign the least loaded of the serial ports to a channel
+uint8_t SpreadAssign(uint8_t route)
+{
+    uint8_t best = CHANNEL_SPREAD_NONE;
+    uint32_t bestQueued = 0;
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) ) continue;
+
+        // Prefer the serial port with the least bytes in flight, then the one with the least channels
+        uint32_t queued = serial_tx_queued(s);
+        if ( best == CHANNEL_SPREAD_NONE || queued < bestQueued ||
+             (queued == bestQueued && spreadChannels[s] < spreadChannels[best]) )
+        {
+            best = s;
+            bestQueued = queued;
+        }
+    }
+
+    spreadChannels[best]++;
+    return best;
+}
+#endif
+
+// Get the serial ports receiving the packet (bit mask)
+// With channel spread, the channel is assigned to a serial port when it's used for the first time
+uint8_t PacketRoute(uint32_t packet)
+{
+    uint8_t port = (packet & 0xF0) >> 4;
+    uint8_t route = SerialRoute(port);
+
+#ifdef CHANNEL_SPREAD
+    uint8_t status = (packet >> 8) & 0xFF;
+
+    // Channel messages are only sent to the serial port assigned to the channel
+    if ( route != 0 && status >= 0x80 && status < 0xF0 )
+    {
+        uint8_t *assigned = &spreadPort[port][status & 0x0F];
+
+        if ( *assigned == CHANNEL_SPREAD_NONE || !(route & (1 << *assigned)) )
+        {
+            *assigned = SpreadAssign(route);
+        }
+
+        return 1 << *assigned;
+    }
+#endif
+
+    return route;
+}
+
+// Check whether SysEx is being sent to any of the serial ports
+bool SerialSysExOpen(uint8_t route)
+{
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( (route & (1 << s)) && serialState[s].sysEx ) return true;
+    }
+
+    return false;
+}
+
+#ifdef REALTIME_EXPRESS
+// Check whether System RealTime message can be written ahead of other queued bytes
+// (with Port Selection messages, only when its port is selected on the wire already)
+bool SerialRealTimeExpress(midiPacket_t *pk)
+{
+#if USB_MIDI_IO_PORT_NUM >= 2
+    uint8_t port = pk->packet[0] >> 4;
+    uint8_t route = SerialRoute(port);
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) || !serialState[s].selectPort ) continue;
+
+        if ( serialState[s].lastPort != port ) return false;
+
+        // The Port Selection message must not wait in the transmit buffer
+        if ( serial_tx_dma(s) && serial_tx_queued(s) > serialSelectAge[s] ) return false;
+    }
+#else
+    (void)pk;
+#endif
+
+    return true;
+}
+
+// Write System RealTime message to the serial ports ahead of other queued bytes
+// (serial ports without DMA transmission send it after the queued bytes)
+// Returns false when a serial port without DMA transmission doesn't have free space
+bool SerialWriteRealTime(midiPacket_t *pk)
+{
+    uint8_t route = SerialRoute(pk->packet[0] >> 4);
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( (route & (1 << s)) && !serial_tx_dma(s) && serialCredit[s] == 0 ) return false;
+    }
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) ) continue;
+
+#ifdef PACKET_TRACE
+        trace_record(TRACE_SERIAL_REALTIME(s), pk->i, &pk->packet[1], 1);
+#endif
+#ifdef SERIAL_UTILIZATION
+        utilization_add(s, 1);
+#endif
+        if ( serial_tx_dma(s) )
+        {
+#ifdef LATENCY_HISTOGRAM
+            if ( latencyStart != 0 ) serial_tx_mark_realtime(s, latencyStart, latency_histogram(pk->i));
+#endif
+            serial_tx_write_realtime(s, pk->packet[1]);
+        }
+        else
+        {
+            serialCredit[s]--;
+#ifdef LATENCY_HISTOGRAM
+            if ( latencyStart != 0 ) serial_tx_mark(s, 1, latencyStart, latency_histogram(pk->i));
+#endif
+            serial_tx_write(s, &pk->packet[1], 1);
+        }
+    }
+
+    return true;
+}
+#endif
+
+// Get the number of bytes which can be written to each enabled serial port without blocking
+void SerialUpdateCredit(void)
+{
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( serialSpeed[s] == 0 ) continue;
+
+        serialCredit[s] = serial_tx_available_for_write(s);
+    }
+}
+
+#ifdef SERIAL_UTILIZATION
+// Check whether any serial port is saturated
+bool SerialSaturated(void)
+{
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( utilization_percent(s) >= CFG_SERIAL_UTILIZATION ) return true;
+    }
+
+    return false;
+}
+#endif
+
+#if defined(LOAD_SHEDDING) || defined(NOTE_PRIORITY)
+// Number of bytes waiting for transmission in the most congested serial port
+uint32_t SerialQueued(void)
+{
+    uint32_t maxQueued = 0;
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( serialSpeed[s] == 0 ) continue;
+
+        uint32_t queued = serial_tx_queued(s);
+        if ( queued > maxQueued ) maxQueued = queued;
+    }
+
+    return maxQueued;
+}
+#endif
+
+// --------------------------------------------------------------------------------------
+// Encoding actions
+// --------------------------------------------------------------------------------------
+// The action for each packet is looked up by its CIN and the high nibble of its first byte.
+// Bits 0-1 contain the length of MIDI message, bits 2-4 the kind of the message.
+
+#define ENCODE_LEN_MASK     0x03
+#define ENCODE_KIND_MASK    0x1C
+
+#define ENCODE_IGNORE       0x00 // Ignored packet
+#define ENCODE_DATA         0x04 // Message without status byte (i.e. SysEx data) or without Running Status
+#define ENCODE_SYSTEM       0x08 // System Common or RealTime message
+#define ENCODE_CHANNEL      0x0C // Channel message
+#define ENCODE_NOTE_OFF     0x10 // Note Off message (3 bytes)
+#define ENCODE_PORT_CHECK   0x14 // System message which can be Port Selection message or non-RealTime Single Byte
+
+#if USB_MIDI_IO_PORT_NUM >= 2
+  // Ignore Port Selection messages "F5 nn" or other non-standard "F5" messages (1-3 bytes)
+  // and only allow System RealTime messages in Single Byte packets
+  #define ENCODE_KIND_SYSTEM(cin) ( (cin) == 0x02 || (cin) == 0x03 || ((cin) >= 0x05 && (cin) <= 0x07) || (cin) == 0x0F ? ENCODE_PORT_CHECK : ENCODE_SYSTEM )
+  #define ENCODE_IGNORED(cin, hi) ( (cin) == 0x0F && (hi) != 0x0F )
+#else
+  #define ENCODE_KIND_SYSTEM(cin) ENCODE_SYSTEM
+  #define ENCODE_IGNORED(cin, hi) 0
+#endif
+
+#if defined(CFG_SERIAL_RUNNING_STATUS) && CFG_SERIAL_RUNNING_STATUS > 0
+  #define ENCODE_KIND_CHANNEL(cin, hi) ( (hi) == 0x08 && USB_MIDI_CIN_LEN(cin) >= 3 ? ENCODE_NOTE_OFF : ENCODE_CHANNEL )
+#else
+  #define ENCODE_KIND_CHANNEL(cin, hi) ENCODE_DATA
+#endif
+
+#define ENCODE_KIND(cin, hi) ( \
+    (hi) == 0x0F ? ENCODE_KIND_SYSTEM(cin) : \
+    (hi) >= 0x08 ? ENCODE_KIND_CHANNEL(cin, hi) : \
+    ENCODE_DATA )
+
+#define ENCODE_ACTION(cin, hi) ( USB_MIDI_CIN_LEN(cin) == 0 || ENCODE_IGNORED(cin, hi) ? ENCODE_IGNORE : (ENCODE_KIND(cin, hi) | USB_MIDI_CIN_LEN(cin)) )
+
+#define ENCODE_ACTION_ROW(cin) \
+    ENCODE_ACTION(cin, 0x0), ENCODE_ACTION(cin, 0x1), ENCODE_ACTION(cin, 0x2), ENCODE_ACTION(cin, 0x3), \
+    ENCODE_ACTION(cin, 0x4), ENCODE_ACTION(cin, 0x5), ENCODE_ACTION(cin, 0x6), ENCODE_ACTION(cin, 0x7), \
+    ENCODE_ACTION(cin, 0x8), ENCODE_ACTION(cin, 0x9), ENCODE_ACTION(cin, 0xA), ENCODE_ACTION(cin, 0xB), \
+    ENCODE_ACTION(cin, 0xC), ENCODE_ACTION(cin, 0xD), ENCODE_ACTION(cin, 0xE), ENCODE_ACTION(cin, 0xF)
+
+// Encoding actions indexed by CIN and the high nibble of the first byte of MIDI message
+static const uint8_t encodeActions[256] =
+{
+    ENCODE_ACTION_ROW(0x0), ENCODE_ACTION_ROW(0x1), ENCODE_ACTION_ROW(0x2), ENCODE_ACTION_ROW(0x3),
+    ENCODE_ACTION_ROW(0x4), ENCODE_ACTION_ROW(0x5), ENCODE_ACTION_ROW(0x6), ENCODE_ACTION_ROW(0x7),
+    ENCODE_ACTION_ROW(0x8), ENCODE_ACTION_ROW(0x9), ENCODE_ACTION_ROW(0xA), ENCODE_ACTION_ROW(0xB),
+    ENCODE_ACTION_ROW(0xC), ENCODE_ACTION_ROW(0xD), ENCODE_ACTION_ROW(0xE), ENCODE_ACTION_ROW(0xF)
+};
+
+// Encode MIDI 1.0 packet to bytes for serial ports and update the serial state
+// Returns number of bytes (up to 5), 0 when the packet is ignored
+uint8_t EncodePacket(midiPacket_t *pk, serialState_t *state, uint8_t *data)
+{
+    uint8_t port = pk->packet[0] >> 4;
+    uint8_t cin  = pk->packet[0] & 0x0F;
+
+#if USB_MIDI_IO_PORT_NUM < 16
+    if (port >= USB_MIDI_IO_PORT_NUM)
+    {
+        // Ignore packets from unused ports
+        return 0;
+    }
+#endif
+
+    uint8_t action = encodeActions[(cin << 4) | (pk->packet[1] >> 4)];
+    uint8_t kind   = action & ENCODE_KIND_MASK;
+
+    if ( kind == ENCODE_IGNORE ) return 0;
+
+#if USB_MIDI_IO_PORT_NUM >= 2
+    if ( kind == ENCODE_PORT_CHECK )
+    {
+        if ( pk->packet[1] == 0xF5 || (cin == 0x0F && pk->packet[1] < 0xF8) ) return 0;
+        kind = ENCODE_SYSTEM;
+    }
+#endif
+
+    // SysEx continues until the packet with its end (RealTime messages don't end it)
+    if ( cin == 0x04 || pk->packet[1] < 0xF8 ) state->sysEx = ( cin == 0x04 );
+
+    uint8_t len = 0;
+
+#if USB_MIDI_IO_PORT_NUM >= 2
+    // If last message came from different port, then send Port Selection message "F5 nn"
+    if ( state->selectPort && port != state->lastPort )
+    {
+        state->runningStatus = 0;
+        state->lastPort = port;
+        data[len++] = 0xF5;
+        data[len++] = port + 1;
+    }
+#endif
+
+    uint8_t first = 1;
+
+    // Implement Running Status when sending data to maximize available bandwidth
+    switch ( kind )
+    {
+        case ENCODE_SYSTEM:
+            // System Common messages cancel Running Status, RealTime messages don't change it
+            if ( pk->packet[1] < 0xF8 ) state->runningStatus = 0;
+            break;
+
+        case ENCODE_NOTE_OFF:
+            if ( pk->packet[1] != state->runningStatus )
+            {
+                // Send note off event as note on with zero velocity to increase the chance of using running status
+                pk->packet[1] |= 0x10;
+                pk->packet[3] = 0;
+            }
+            // fall through
+
+        case ENCODE_CHANNEL:
+            if ( pk->packet[1] == state->runningStatus )
+            {
+                // Don't send Running Status byte
+                first = 2;
+            }
+            else
+            {
+                // Update Running Status
+                state->runningStatus = pk->packet[1];
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    uint8_t msgLen = action & ENCODE_LEN_MASK;
+
+    for ( uint8_t i = first; i <= msgLen; i++ )
+    {
+        data[len++] = pk->packet[i];
+    }
+
+    return len;
+}
+
+// Write MIDI 1.0 packet to the serial ports routed from its USB MIDI port
+// Returns false (and leaves the serial state unchanged) when the serial ports don't have enough free space
+bool WritePacket(midiPacket_t *pk)
+{
+    uint8_t route = PacketRoute(pk->i);
+    serialState_t state[SERIAL_INTERFACE_MAX];
+    uint8_t data[SERIAL_INTERFACE_MAX][5];
+    uint8_t len[SERIAL_INTERFACE_MAX] = { 0 };
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) ) continue;
+
+        // Each serial port has its own Running Status and Port Selection
+        midiPacket_t encoded = *pk;
+        state[s] = serialState[s];
+
+        len[s] = EncodePacket(&encoded, &state[s], data[s]);
+
+        // Manage Serial contention vs USB
+        // Only write the packet when all serial ports can take the encoded bytes without blocking.
+        if ( len[s] > serialCredit[s] ) return false;
+    }
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) ) continue;
+
+        serialCredit[s] -= len[s];
+        serialState[s] = state[s];
+#ifdef PACKET_TRACE
+        trace_record(TRACE_SERIAL(s), pk->i, data[s], len[s]);
+#endif
+
+        if ( len[s] > 0 )
+        {
+            PERF_COUNT(serialBytes[s], len[s]);
+#ifdef SERIAL_UTILIZATION
+            utilization_add(s, len[s]);
+#endif
+#if defined(REALTIME_EXPRESS) && USB_MIDI_IO_PORT_NUM >= 2
+            serialSelectAge[s] = ( data[s][0] == 0xF5 ) ? len[s] - 2 : serialSelectAge[s] + len[s];
+#endif
+#if USB_MIDI_IO_PORT_NUM >= 2
+            PERF_COUNT(portSelections, data[s][0] == 0xF5);
+            PERF_COUNT(runningStatusSavedBytes, USBMidi::CINToLenTable[pk->packet[0] & 0x0F] + 2 * (data[s][0] == 0xF5) - len[s]);
+#else
+            PERF_COUNT(runningStatusSavedBytes, USBMidi::CINToLenTable[pk->packet[0] & 0x0F] - len[s]);
+#endif
+#ifdef LATENCY_HISTOGRAM
+            if ( latencyStart != 0 ) serial_tx_mark(s, len[s], latencyStart, latency_histogram(pk->i));
+#endif
+            serial_tx_write(s, data[s], len[s]);
+        }
+    }
+
+    return true;
+}
+
+#ifdef SYSEX_STAGING
+// Release all staged packets
+void StagingInit(void)
+{
+    for ( uint8_t b = 0; b < SYSEX_STAGING_BLOCKS; b++ )
+    {
+        stagingPool[b].next = b + 1;
+    }
+    stagingPool[SYSEX_STAGING_BLOCKS - 1].next = SYSEX_STAGING_NONE;
+    stagingFree = 0;
+
+    for ( uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM; port++ )
+    {
+        stagingChains[port].head = SYSEX_STAGING_NONE;
+    }
+}
+
+// Append packet to the staged packets of the port
+// Returns false when there are no free blocks
+bool StagingPush(uint8_t port, uint32_t packet)
+{
+    stagingChain_t *chain = &stagingChains[port];
+
+    if ( chain->head == SYSEX_STAGING_NONE || chain->write == SYSEX_STAGING_PACKETS )
+    {
+        uint8_t block = stagingFree;
+        if ( block == SYSEX_STAGING_NONE ) return false;
+
+        stagingFree = stagingPool[block].next;
+        stagingPool[block].next = SYSEX_STAGING_NONE;
+
+        if ( chain->head == SYSEX_STAGING_NONE )
+        {
+            chain->head = block;
+            chain->read = 0;
+        }
+        else
+        {
+            stagingPool[chain->tail].next = block;
+        }
+
+        chain->tail = block;
+        chain->write = 0;
+    }
+
+    stagingPool[chain->tail].packets[chain->write++] = packet;
+    return true;
+}
+
+// Remove the first staged packet of the port
+void StagingPop(stagingChain_t *chain)
+{
+    chain->read++;
+
+    bool last = ( chain->head == chain->tail );
+    if ( last ? (chain->read != chain->write) : (chain->read != SYSEX_STAGING_PACKETS) ) return;
+
+    // Return the first block to the list of free blocks
+    uint8_t block = chain->head;
+    chain->head = last ? SYSEX_STAGING_NONE : stagingPool[block].next;
+    chain->read = 0;
+
+    stagingPool[block].next = stagingFree;
+    stagingFree = block;
+}
+
+// Check whether SysEx from other port is being sent to any of the serial ports routed from the port
+bool StagingBlocked(uint8_t port)
+{
+    uint8_t route = serialRouting[port];
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) ) continue;
+
+        if ( serialState[s].sysEx && serialState[s].selectPort && serialState[s].lastPort != port ) return true;
+    }
+
+    return false;
+}
+
+// Write staged packet to serial ports
+bool StagingWrite(midiPacket_t *pk)
+{
+#ifdef LATENCY_HISTOGRAM
+    // The latency of staged packets isn't measured
+    uint32_t start = latencyStart;
+    latencyStart = 0;
+    bool written = WritePacket(pk);
+    latencyStart = start;
+    return written;
+#else
+    return WritePacket(pk);
+#endif
+}
+
+// Get the USB MIDI port currently selected on the serial ports receiving Port Selection messages
+uint8_t StagingSelectedPort(void)
+{
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( serialSpeed[s] != 0 && serialState[s].selectPort && serialState[s].lastPort < USB_MIDI_IO_PORT_NUM ) return serialState[s].lastPort;
+    }
+
+    return 0;
+}
+
+// Write staged packets to serial ports while there is enough space
+// The packets of the currently selected port are written first, so they don't need Port Selection message
+// Unless force is true, staged packets are not written in the middle of SysEx from other port
+// Returns false when the serial ports don't have enough free space
+bool StagingFlush(bool force)
+{
+    uint8_t first = StagingSelectedPort();
+
+    for ( uint8_t i = 0; i < USB_MIDI_IO_PORT_NUM; i++ )
+    {
+        uint8_t port = ( first + i ) % USB_MIDI_IO_PORT_NUM;
+        stagingChain_t *chain = &stagingChains[port];
+
+        while ( chain->head != SYSEX_STAGING_NONE )
+        {
+            if ( !force && StagingBlocked(port) ) break;
+
+            midiPacket_t pk;
+            pk.i = stagingPool[chain->head].packets[chain->read];
+            if ( !StagingWrite(&pk) ) return false;
+
+            StagingPop(chain);
+        }
+    }
+
+    return true;
+}
+#endif
+
+// Process MIDI 1.0 packet
+// Returns false when the packet can't be written (or staged) yet
+bool ProcessPacket(midiPacket_t *pk)
+{
+    PROFILER_SCOPE(PROFILER_PROCESS_PACKET);
+
+#ifdef SYSEX_STAGING
+    uint8_t port = pk->packet[0] >> 4;
+
+    // Don't interrupt SysEx from other port, and keep order of the packets from the port
+    if ( port < USB_MIDI_IO_PORT_NUM &&
+         ( stagingChains[port].head != SYSEX_STAGING_NONE || StagingBlocked(port) ) )
+    {
+        if ( StagingPush(port, pk->i) ) return true;
+
+        // No free blocks, so interleave the ports like without staging
+        if ( !StagingFlush(true) ) return false;
+    }
+
+    if ( !WritePacket(pk) ) return false;
+
+    // Write packets held during SysEx which ended
+    if ( !SerialSysExOpen(SerialRoute(port)) ) StagingFlush(false);
+
+    return true;
+#else
+    return WritePacket(pk);
+#endif
+}
+
+// Check whether the packet contains a System RealTime message
+static inline bool IsRealTimePacket(midiPacket_t *pk)
+{
+    return ( (pk->packet[0] & 0x0F) == 0x0F && pk->packet[1] >= 0xF8 );
+}
+
+#ifdef PENDING_WINDOW
+#ifdef NOTE_PRIORITY
+// Select the oldest pending Note On/Off message which isn't preceded by other pending messages
+// from the same port and channel (or by pending System messages from the same port)
+// Returns pendingCount when there is no such message
+uint32_t PendingSelectNote(void)
+{
+    uint16_t blocked[16]; // Channels of each port with older pending messages
+
+    memset(blocked, 0, sizeof(blocked));
+
+    for ( uint32_t i = 0; i < pendingCount; i++ )
+    {
+        uint32_t packet = pendingPackets[i].packet;
+        uint8_t port   = (packet >> 4) & 0x0F;
+        uint8_t cin    = packet & 0x0F;
+        uint8_t status = (packet >> 8) & 0xFF;
+
+        if ( cin >= 0x08 && cin <= 0x0E && (status >> 4) == cin )
+        {
+            uint16_t channel = 1 << (status & 0x0F);
+
+            if ( cin <= 0x09 && !(blocked[port] & channel) ) return i;
+
+            blocked[port] |= channel;
+        }
+        else
+        {
+            blocked[port] = 0xFFFF;
+        }
+    }
+
+    return pendingCount;
+}
+#endif
+
+#ifdef PORT_COALESCE_WINDOW
+// Check whether packets from the port can be written without Port Selection message
+bool PortSelected(uint8_t port)
+{
+    uint8_t route = SerialRoute(port);
+
+    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    {
+        if ( !(route & (1 << s)) ) continue;
+
+        if ( serialState[s].selectPort && serialState[s].lastPort != port ) return false;
+    }
+
+    return true;
+}
+#endif
+
+// Select the next pending packet to write to serial ports
+// Returns pendingCount when no packet should be written yet
+uint32_t PendingSelect(bool force)
+{
+#ifdef NOTE_PRIORITY
+    // Never insert notes in the middle of SysEx
+    if ( priorityActive && !SerialSysExOpen(0xFF) )
+    {
+        uint32_t index = PendingSelectNote();
+        if ( index < pendingCount ) return index;
+    }
+#endif
+
+#ifdef PORT_COALESCE_WINDOW
+    // Packets from the currently selected port don't need Port Selection message, so write them without delay
+    for ( uint32_t i = 0; i < pendingCount; i++ )
+    {
+        if ( PortSelected((pendingPackets[i].packet & 0xF0) >> 4) ) return i;
+    }
+
+    // Switch to the port of the oldest packet when it exhausted the latency budget
+    if ( !force && (uint32_t)(pendingNow - pendingPackets[0].time) < CFG_PORT_COALESCE_WINDOW_US ) return pendingCount;
+#else
+    (void)force;
+#endif
+
+    return 0;
+}
+
+// Remove pending packet, preserving order of the remaining packets
+void PendingRemove(uint32_t index)
+{
+    pendingCount--;
+    for ( uint32_t i = index; i < pendingCount; i++ )
+    {
+        pendingPackets[i] = pendingPackets[i + 1];
+    }
+}
+
+#ifdef LOAD_SHEDDING
+// Get the mask of packet bits identifying the value changed by the packet
+// Returns 0 when the packet can't be merged with older packets
+static inline uint32_t SheddingMask(midiPacket_t *pk)
+{
+    uint8_t cin = pk->packet[0] & 0x0F;
+
+    if ( (pk->packet[1] & 0xF0) != (cin << 4) ) return 0;
+
+    switch ( cin )
+    {
+        case 0x0A: // Poly-KeyPress
+            return 0x00FFFFFF;
+        case 0x0B: // Control Change
+            switch ( pk->packet[2] )
+            {
+                case 1:  // Modulation
+                case 2:  // Breath Controller
+                case 4:  // Foot Controller
+                case 7:  // Volume
+                case 8:  // Balance
+                case 10: // Pan
+                case 11: // Expression
+                    return 0x00FFFFFF;
+                default:
+                    return 0;
+            }
+        case 0x0D: // Channel Pressure
+        case 0x0E: // PitchBend Change
+            return 0x0000FFFF;
+        default:
+            return 0;
+    }
+}
+
+// Drop pending packet which is superseded by the packet
+void PendingShed(midiPacket_t *pk)
+{
+    uint32_t mask = SheddingMask(pk);
+    if ( mask == 0 ) return;
+
+    for ( uint32_t i = pendingCount; i-- > 0; )
+    {
+        midiPacket_t pending;
+        pending.i = pendingPackets[i].packet;
+
+        if ( ((pending.i ^ pk->i) & mask) == 0 )
+        {
+            PendingRemove(i);
+            sheddingDroppedPackets++;
+            return;
+        }
+
+        // The older value must still be sent before other messages of the same port and channel
+        // (i.e. before Note On or Data Entry)
+        if ( (pending.packet[0] >> 4) == (pk->packet[0] >> 4) &&
+             pending.packet[1] >= 0x80 && pending.packet[1] < 0xF0 &&
+             (pending.packet[1] & 0x0F) == (pk->packet[1] & 0x0F) &&
+             SheddingMask(&pending) == 0 ) return;
+    }
+}
+#endif
+
+// Write pending packets to serial ports while there is enough space
+// When force is true, at least one packet is written (if possible) even if it's not due yet
+void PendingFlush(bool force)
+{
+    while ( pendingCount )
+    {
+        uint32_t index = PendingSelect(force);
+        if ( index >= pendingCount ) break;
+
+        midiPacket_t pk;
+        pk.i = pendingPackets[index].packet;
+#ifdef LATENCY_HISTOGRAM
+        latencyStart = pendingPackets[index].start;
+#endif
+
+        if ( !ProcessPacket(&pk) ) break;
+
+        PendingRemove(index);
+        force = false;
+    }
+}
+#endif
+
+#ifdef CHANNEL_SHADOW
+// Forget all values in the channel state shadow
+void ShadowInvalidate(void)
+{
+    memset(channelShadow, SHADOW_UNKNOWN, sizeof(channelShadow));
+}
+
+// Get the channel state shadow value changed by the packet
+// Returns NULL when the packet doesn't change any value in the shadow
+uint8_t *ShadowSlot(midiPacket_t *pk, uint8_t *value)
+{
+    uint8_t port = pk->packet[0] >> 4;
+    uint8_t cin  = pk->packet[0] & 0x0F;
+
+    if ( port >= USB_MIDI_IO_PORT_NUM ) return NULL;
+    if ( (pk->packet[1] & 0xF0) != (cin << 4) ) return NULL;
+
+    uint8_t *values = channelShadow[port][pk->packet[1] & 0x0F];
 
-// Write data to all enabled serial ports
-void SerialWrite(uint8_t *data, uint8_t len)
-{
-    for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
+    switch ( cin )
     {
-        if ( serialSpeed[s] == 0 ) continue;
+        case 0x0B: // Control Change
+            if ( pk->packet[3] >= 0x80 ) return NULL;
+            *value = pk->packet[3];
+
+            switch ( pk->packet[2] )
+            {
+                case 0:   return &values[SHADOW_BANK_MSB];
+                case 32:  return &values[SHADOW_BANK_LSB];
+                case 7:   return &values[SHADOW_VOLUME];
+                case 10:  return &values[SHADOW_PAN];
+                case 98:  return &values[SHADOW_NRPN_LSB];
+                case 99:  return &values[SHADOW_NRPN_MSB];
+                case 100: return &values[SHADOW_RPN_LSB];
+                case 101: return &values[SHADOW_RPN_MSB];
+                default:  return NULL;
+            }
+
+        case 0x0C: // Program Change
+            if ( pk->packet[2] >= 0x80 ) return NULL;
+            *value = pk->packet[2];
+            return &values[SHADOW_PROGRAM];
 
-        serialHw[s]->write(data, len);
+        default:
+            return NULL;
     }
 }
 
-// Process MIDI 1.0 packet
-void ProcessPacket(midiPacket_t *pk)
+// Update the channel state shadow after the packet was accepted
+void ShadowUpdate(midiPacket_t *pk, uint8_t *slot, uint8_t value)
 {
     uint8_t port = pk->packet[0] >> 4;
-    uint8_t cin  = pk->packet[0] & 0x0F;
+    if ( port >= USB_MIDI_IO_PORT_NUM ) return;
 
-#if USB_MIDI_IO_PORT_NUM < 16
-    if (port >= USB_MIDI_IO_PORT_NUM)
+    // SysEx (i.e. GM/GS/XG reset) or System Reset can change anything
+    if ( pk->packet[1] == 0xF0 || pk->packet[1] == 0xFF )
     {
-        // Ignore packets from unused ports
+        memset(channelShadow[port], SHADOW_UNKNOWN, sizeof(channelShadow[port]));
         return;
     }
+
+    uint8_t *values = channelShadow[port][pk->packet[1] & 0x0F];
+
+    if ( slot != NULL )
+    {
+        *slot = value;
+
+        // Selecting RPN deselects NRPN and vice versa
+        if ( slot == &values[SHADOW_RPN_LSB] || slot == &values[SHADOW_RPN_MSB] )
+        {
+            values[SHADOW_NRPN_LSB] = SHADOW_UNKNOWN;
+            values[SHADOW_NRPN_MSB] = SHADOW_UNKNOWN;
+        }
+        else if ( slot == &values[SHADOW_NRPN_LSB] || slot == &values[SHADOW_NRPN_MSB] )
+        {
+            values[SHADOW_RPN_LSB] = SHADOW_UNKNOWN;
+            values[SHADOW_RPN_MSB] = SHADOW_UNKNOWN;
+        }
+        // Bank Select only takes effect with the next Program Change, which must be sent even with the same program
+        else if ( slot == &values[SHADOW_BANK_MSB] || slot == &values[SHADOW_BANK_LSB] )
+        {
+            values[SHADOW_PROGRAM] = SHADOW_UNKNOWN;
+        }
+    }
+    else if ( (pk->packet[0] & 0x0F) == 0x0B && (pk->packet[1] & 0xF0) == 0xB0 && pk->packet[2] == 121 )
+    {
+        // Reset All Controllers deselects RPN and NRPN
+        values[SHADOW_NRPN_LSB] = SHADOW_UNKNOWN;
+        values[SHADOW_NRPN_MSB] = SHADOW_UNKNOWN;
+        values[SHADOW_RPN_LSB] = SHADOW_UNKNOWN;
+        values[SHADOW_RPN_MSB] = SHADOW_UNKNOWN;
+    }
+}
 #endif
 
-    uint8_t msgLen = USBMidi::CINToLenTable[cin];
+#ifdef DIAG_SYSEX
+// Execute diagnostic query and start the reply
+void DiagQuery(uint8_t port, uint8_t cmd)
+{
+    // Only one reply at a time
+    if ( diagReplyPort != DIAG_NONE ) return;
 
-#if USB_MIDI_IO_PORT_NUM >= 2
-    switch ( cin )
+    switch ( cmd )
     {
-        case 0x02: // Two-byte System Common messages like MTC, SongSelect, etc.
-        case 0x03: // Three-byte System Common messages like SPP, etc.
-        case 0x05: // Single-byte System Common Message or SysEx ends with following single byte.
-        case 0x06: // SysEx ends with following two bytes.
-        case 0x07: // SysEx ends with following three bytes.
-            // Ignore Port Selection messages "F5 nn" or other non-standard "F5" messages (1-3 bytes)
-            if ( pk->packet[1] == 0xF5 ) msgLen = 0;
+#ifdef LATENCY_HISTOGRAM
+        case DIAG_LATENCY_DUMP:
             break;
-        case 0x0F: // Single Byte
-            // Only allow System RealTime messages
-            if ( pk->packet[1] < 0xF8 ) msgLen = 0;
+        case DIAG_LATENCY_RESET:
+            latency_reset();
             break;
-        default:
+#endif
+#ifdef PERF_COUNTERS
+        case DIAG_COUNTERS:
+            break;
+#endif
+#ifdef PROFILER
+        case DIAG_PROFILER_DUMP:
+            break;
+        case DIAG_PROFILER_RESET:
+            profiler_reset();
+            break;
+#endif
+#ifdef SERIAL_UTILIZATION
+        case DIAG_UTILIZATION:
+            break;
+#endif
+#ifdef PACKET_TRACE
+        case DIAG_TRACE_DUMP:
+            // Keep the trace unchanged until it's sent
+            trace_pause(true);
             break;
+        case DIAG_TRACE_RESET:
+            trace_reset();
+            break;
+#endif
+        default:
+            return;
+    }
+
+    diagReplyPort = port;
+    diagReplyCmd = cmd;
+    diagReplyIndex = 0;
+    diagMessageLen = 0;
+    diagMessagePos = 0;
+}
+
+// Intercept diagnostic queries from the host
+// Returns true when the packet is part of a query
+bool DiagFilter(midiPacket_t *pk)
+{
+    uint8_t port = pk->packet[0] >> 4;
+    uint8_t cin  = pk->packet[0] & 0x0F;
+
+    if ( port != diagQueryPort )
+    {
+        if ( diagQueryPort != DIAG_NONE || port >= USB_MIDI_IO_PORT_NUM || cin != 0x04 ||
+             pk->packet[1] != 0xF0 || pk->packet[2] != DIAG_ID_0 || pk->packet[3] != DIAG_ID_1 ) return false;
+
+        diagQueryPort = port;
+        diagQueryCmd = DIAG_NONE;
+        return true;
+    }
+
+    if ( IsRealTimePacket(pk) ) return false;
+
+    // Query was interrupted by other message
+    if ( cin < 0x04 || cin > 0x07 )
+    {
+        diagQueryPort = DIAG_NONE;
+        return false;
+    }
+
+    if ( diagQueryCmd == DIAG_NONE && pk->packet[1] != 0xF7 ) diagQueryCmd = pk->packet[1];
+
+    // End of query
+    if ( cin != 0x04 )
+    {
+        diagQueryPort = DIAG_NONE;
+        if ( diagQueryCmd != DIAG_NONE ) DiagQuery(port, diagQueryCmd);
+    }
+
+    return true;
+}
+#endif
+
+// Write MIDI 1.0 packet to serial ports or hold it in the pending window
+// Returns false when the packet can't be accepted yet
+bool AcceptPacket(midiPacket_t *pk)
+{
+#ifdef LATENCY_HISTOGRAM
+    latencyStart = latencyArrival;
+#endif
+
+#ifdef REALTIME_EXPRESS
+    // RealTime messages can be inserted anywhere in the serial stream where their port is selected,
+    // so they don't wait for the queued bytes (otherwise they are written in order with Port Selection message)
+    if ( IsRealTimePacket(pk) && SerialRealTimeExpress(pk) )
+    {
+        return SerialWriteRealTime(pk);
     }
 #endif
 
-    if ( msgLen > 0 )
+#ifdef PENDING_WINDOW
+    // Never delay RealTime messages
+    if ( !IsRealTimePacket(pk) )
     {
-#if USB_MIDI_IO_PORT_NUM >= 2
-        // If last message came from different port, then send Port Selection message "F5 nn"
-        if ( port != lastPort )
-        {
-            runningStatus = 0;
-            lastPort = port;
-            portSelection[1] = port + 1;
-            SerialWrite(portSelection, 2);
-        }
+#ifdef LOAD_SHEDDING
+        // Only the newest value is sent, when the serial ports can't keep up
+        if ( sheddingActive ) PendingShed(pk);
 #endif
 
-#if defined(CFG_SERIAL_RUNNING_STATUS) && CFG_SERIAL_RUNNING_STATUS > 0
-        // Implement Running Status when sending data to maximize available bandwidth
-        if (pk->packet[1] >= 0xF8)
-        {
-            // RealTime messages
-            SerialWrite(&pk->packet[1], msgLen);
-        }
-        else if (pk->packet[1] >= 0xF0)
+        if ( pendingCount == PENDING_WINDOW_SIZE )
         {
-            // System Common messages
-            runningStatus = 0;
-            SerialWrite(&pk->packet[1], msgLen);
-        }
-        else if (pk->packet[1] >= 0x80)
-        {
-            if (pk->packet[1] <= 0x8F && msgLen >= 3 && pk->packet[1] != runningStatus)
-            {
-                // Send note off event as note on with zero velocity to increase the chance of using running status
-                pk->packet[1] |= 0x10;
-                pk->packet[3] = 0;
-            }
+            PendingFlush(true);
 
-            if (pk->packet[1] == runningStatus)
-            {
-                // Don't send Running Status byte
-                if (msgLen > 1)
-                {
-                    SerialWrite(&pk->packet[2], msgLen - 1);
-                }
-            }
-            else
-            {
-                // Update Running Status
-                runningStatus = pk->packet[1];
-                SerialWrite(&pk->packet[1], msgLen);
-            }
+            if ( pendingCount == PENDING_WINDOW_SIZE ) return false;
         }
-        else
+
+        pendingPackets[pendingCount].packet = pk->i;
+        pendingPackets[pendingCount].time = pendingNow;
+#ifdef LATENCY_HISTOGRAM
+        pendingPackets[pendingCount].start = latencyArrival;
 #endif
-        {
-            SerialWrite(&pk->packet[1], msgLen);
-        }
+        pendingCount++;
+        return true;
+    }
+#endif
+
+    return ProcessPacket(pk);
+}
+
+// Process MIDI 1.0 packet straight from the USB receive buffer
+uint8_t ProcessUSBPacket(uint32_t packet)
+{
+    midiPacket_t pk;
+    pk.i = packet;
+
+#ifdef DIAG_SYSEX
+    if ( DiagFilter(&pk) ) return 1;
+#endif
+#ifdef LATENCY_HISTOGRAM
+    // One cycle later when the cycle counter was 0 (0 means unknown)
+    latencyArrival = MidiUSB.packetTime() | 1;
+#endif
+#ifdef PACKET_TRACE
+    uint32_t traceIndex = ( traceStalled && traceStallPacket == packet ) ? traceStallIndex : trace_record(TRACE_RX, packet, NULL, 0);
+    traceStalled = false;
+#endif
+
+#ifdef CHANNEL_SHADOW
+    uint8_t value = 0;
+    uint8_t *slot = ShadowSlot(&pk, &value);
+
+    if ( slot != NULL && *slot == value )
+    {
+        // Drop message which doesn't change anything
+        shadowSuppressedBytes += USBMidi::CINToLenTable[pk.packet[0] & 0x0F];
+        return 1;
+    }
+#endif
+
+    // When the packet can't be accepted, it stays in the USB receive buffer
+    if ( !AcceptPacket(&pk) )
+    {
+        PERF_COUNT(serialStalls, 1);
+#ifdef PACKET_TRACE
+        trace_set_event(traceIndex, TRACE_STALL);
+        traceStalled = true;
+        traceStallPacket = packet;
+        traceStallIndex = traceIndex;
+#endif
+        return 0;
     }
+
+    // Counted once, when the packet is removed from the USB receive buffer
+    PERF_COUNT(usbDroppedPackets, ((packet >> 4) & 0x0F) >= USB_MIDI_IO_PORT_NUM || USBMidi::CINToLenTable[packet & 0x0F] == 0);
+
+#ifdef CHANNEL_SHADOW
+    pk.i = packet;
+    ShadowUpdate(&pk, slot, value);
+#endif
+
+    return 1;
 }
 
 // Turn LED on
@@ -179,6 +1406,225 @@ void LED_TurnOff(void)
     }
 }
 
+#ifdef SERIAL_MIDI_IN
+// Collect USB MIDI packet for the host
+void UsbInPush(uint32_t packet)
+{
+    if ( usbInCount == 0 ) usbInTime = micros();
+    usbInPackets[usbInCount++] = packet;
+}
+
+// Receive MIDI from the serial port and collect USB MIDI packets for the host
+void SerialReceive(uint8_t s)
+{
+    uint32_t packet;
+
+#ifdef DIAG_SYSEX
+    // Serial MIDI is held in the serial receive buffer while a reply is sent
+    if ( diagReplyPort != DIAG_NONE ) return;
+#endif
+
+    // Bytes are left in the serial receive buffer while the collected packets can't be sent
+    while ( usbInCount < USB_IN_BATCH_SIZE && serialHw[s]->available() )
+    {
+        uint8_t result = serial_rx_parse(s, serialHw[s]->peek(), &packet);
+
+        // The status byte which interrupted SysEx stays in the buffer until the end of SysEx is sent
+        if ( !(result & SERIAL_RX_AGAIN) ) serialHw[s]->read();
+        if ( result & SERIAL_RX_PACKET ) UsbInPush(packet | (serialInputPort[s] << 4));
+    }
+}
+
+// Send the collected packets to the host when the batch is full or the oldest packet waited long enough
+void UsbInFlush(void)
+{
+    if ( MidiUSB.isTransmitting() ) return;
+
+    if ( usbInCount == 0 )
+    {
+        // A zero length packet ends the transfer after a full transaction
+        if ( usbInZeroLength )
+        {
+            usbInZeroLength = false;
+            MidiUSB.tryWritePackets(NULL, 0);
+        }
+        return;
+    }
+
+    if ( usbInCount < USB_IN_BATCH_SIZE && (uint32_t)(micros() - usbInTime) < USB_IN_FLUSH_US ) return;
+
+    if ( MidiUSB.tryWritePackets(usbInPackets, usbInCount) == 0 ) return;
+
+    usbInZeroLength = ( usbInCount == USB_IN_BATCH_SIZE );
+    usbInCount = 0;
+}
+#endif
+
+#ifdef DIAG_SYSEX
+// Start reply message
+void DiagMessageBegin(uint8_t cmd)
+{
+    diagMessage[0] = 0xF0;
+    diagMessage[1] = DIAG_ID_0;
+    diagMessage[2] = DIAG_ID_1;
+    diagMessage[3] = cmd;
+    diagMessageLen = 4;
+    diagMessagePos = 0;
+}
+
+// Append 32-bit value to reply message (5 bytes with 7 bits, least significant first)
+void DiagMessageValue(uint32_t value)
+{
+    for ( uint8_t i = 0; i < 5; i++ )
+    {
+        diagMessage[diagMessageLen++] = value & 0x7F;
+        value >>= 7;
+    }
+}
+
+// Append bytes to reply message, packed in groups of up to 7 bytes
+// (first byte of the group contains the highest bits of the following bytes)
+void DiagMessageBytes(const uint8_t *data, uint8_t len)
+{
+    while ( len )
+    {
+        uint8_t group = ( len > 7 ) ? 7 : len;
+        uint8_t *msb = &diagMessage[diagMessageLen++];
+
+        *msb = 0;
+        for ( uint8_t i = 0; i < group; i++ )
+        {
+            *msb |= (data[i] >> 7) << i;
+            diagMessage[diagMessageLen++] = data[i] & 0x7F;
+        }
+
+        data += group;
+        len -= group;
+    }
+}
+
+// Prepare the next reply message
+// Returns false when the reply is complete
+bool DiagNextMessage(void)
+{
+    switch ( diagReplyCmd )
+    {
+#ifdef LATENCY_HISTOGRAM
+        case DIAG_LATENCY_DUMP:
+            if ( diagReplyIndex >= LATENCY_HISTOGRAMS ) return false;
+
+            DiagMessageBegin(diagReplyCmd);
+            diagMessage[diagMessageLen++] = diagReplyIndex / LATENCY_CLASSES;
+            diagMessage[diagMessageLen++] = diagReplyIndex % LATENCY_CLASSES;
+            for ( uint8_t b = 0; b < LATENCY_BUCKETS; b++ ) DiagMessageValue(latency_count(diagReplyIndex, b));
+            break;
+#endif
+
+#ifdef PERF_COUNTERS
+        case DIAG_COUNTERS:
+            if ( diagReplyIndex >= 1 ) return false;
+
+            DiagMessageBegin(diagReplyCmd);
+            diagMessage[diagMessageLen++] = 8 + SERIAL_INTERFACE_MAX;
+            DiagMessageValue(perfCounters.usbRxPackets);
+            DiagMessageValue(perfCounters.usbRxNakPeriods);
+            DiagMessageValue(perfCounters.usbDroppedPackets);
+            DiagMessageValue(perfCounters.serialStalls);
+            DiagMessageValue(perfCounters.runningStatusSavedBytes);
+            DiagMessageValue(perfCounters.portSelections);
+#ifdef CHANNEL_SHADOW
+            DiagMessageValue(shadowSuppressedBytes);
+#else
+            DiagMessageValue(0);
+#endif
+#ifdef LOAD_SHEDDING
+            DiagMessageValue(sheddingDroppedPackets);
+#else
+            DiagMessageValue(0);
+#endif
+            for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ ) DiagMessageValue(perfCounters.serialBytes[s]);
+            break;
+#endif
+
+#ifdef PROFILER
+        case DIAG_PROFILER_DUMP:
+        {
+            if ( diagReplyIndex >= PROFILER_SECTIONS ) return false;
+
+            volatile profiler_stat_t *stat = &profilerStats[diagReplyIndex];
+            uint32_t count = stat->count;
+
+            DiagMessageBegin(diagReplyCmd);
+            diagMessage[diagMessageLen++] = diagReplyIndex;
+            DiagMessageValue(count);
+            DiagMessageValue(stat->min);
+            DiagMessageValue(count ? (uint32_t)(stat->total / count) : 0);
+            DiagMessageValue(stat->max);
+            break;
+        }
+#endif
+
+#ifdef PACKET_TRACE
+        case DIAG_TRACE_DUMP:
+            if ( diagReplyIndex >= trace_count() )
+            {
+                trace_pause(false);
+                return false;
+            }
+
+            DiagMessageBegin(diagReplyCmd);
+            DiagMessageBytes((const uint8_t *)trace_entry(diagReplyIndex), sizeof(traceEntry_t));
+            break;
+#endif
+
+#ifdef SERIAL_UTILIZATION
+        case DIAG_UTILIZATION:
+            if ( diagReplyIndex >= 1 ) return false;
+
+            DiagMessageBegin(diagReplyCmd);
+            diagMessage[diagMessageLen++] = SERIAL_INTERFACE_MAX;
+            for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ ) DiagMessageValue(utilization_percent(s));
+            break;
+#endif
+
+        default:
+            if ( diagReplyIndex >= 1 ) return false;
+
+            DiagMessageBegin(diagReplyCmd);
+            break;
+    }
+
+    diagMessage[diagMessageLen++] = 0xF7;
+    diagReplyIndex++;
+    return true;
+}
+
+// Send the reply to the host while there is space in the batch of USB MIDI packets
+void DiagReply(void)
+{
+    while ( diagReplyPort != DIAG_NONE && usbInCount < USB_IN_BATCH_SIZE )
+    {
+        if ( diagMessagePos == diagMessageLen && !DiagNextMessage() )
+        {
+            diagReplyPort = DIAG_NONE;
+            break;
+        }
+
+        // SysEx starts or continues (3 bytes) or ends with following 1-3 bytes
+        uint8_t left = diagMessageLen - diagMessagePos;
+        uint8_t len = ( left > 3 ) ? 3 : left;
+        uint32_t packet = (diagReplyPort << 4) | (( left > 3 ) ? 0x04 : 0x04 + len);
+
+        for ( uint8_t i = 0; i < len; i++ )
+        {
+            packet |= ((uint32_t)diagMessage[diagMessagePos++]) << (8 * (i + 1));
+        }
+
+        UsbInPush(packet);
+    }
+}
+#endif
+
 void setup()
 {
     Serial.end();
@@ -188,6 +1634,16 @@ void setup()
     ledStatus = false;
     digitalWrite(LED_CONNECT, HIGH);
 
+#if defined(LATENCY_HISTOGRAM) || defined(PROFILER)
+    cycle_counter_begin();
+#endif
+#ifdef CHANNEL_SHADOW
+    ShadowInvalidate();
+#endif
+#ifdef SYSEX_STAGING
+    StagingInit();
+#endif
+
     // Prepare serial ports speed
     for ( uint8_t s=0; s != SERIAL_INTERFACE_MAX ; s++ ) serialSpeed[s] = 0;
 
@@ -212,8 +1668,17 @@ void setup()
         if ( serialSpeed[s] == 0 ) continue;
 
         serialHw[s]->begin(serialSpeed[s]);
+        serial_tx_begin(s, serialHw[s]);
+#ifdef SERIAL_UTILIZATION
+        utilization_begin(s, serialSpeed[s]);
+#endif
     }
 
+    SerialRoutingInit();
+#ifdef CHANNEL_SPREAD
+    SpreadInit();
+#endif
+
     // Configure USB MIDI parameters
 #if defined(CFG_USB_MIDI_VENDORID) && (CFG_USB_MIDI_PRODUCTID)
     usb_midi_set_vid_pid(CFG_USB_MIDI_VENDORID, CFG_USB_MIDI_PRODUCTID);
@@ -231,11 +1696,17 @@ void setup()
 
 void loop()
 {
+    PROFILER_SCOPE(PROFILER_LOOP);
+
     static unsigned long turnOnMillis = 0;
     static unsigned long turnOffMillis = 0;
     static bool turnOffEnabled = false;
     unsigned long currentMillis = millis();
 
+#ifdef SERIAL_UTILIZATION
+    utilization_update(currentMillis);
+#endif
+
     // Process incoming USB packets
     if ( MidiUSB.isConnected() )
     {
@@ -255,36 +1726,88 @@ void loop()
 
         midiUSBCx = true;
 
-        // Do we have a MIDI USB packet available ?
+        // Manage Serial contention vs USB
+        // Packets are processed only while the serial buffers can take their bytes without blocking.
+        // Unprocessed packets stay in the USB buffer (and the host is NAKed when it's full).
+        SerialUpdateCredit();
+
+#ifdef PENDING_WINDOW
+        pendingNow = micros();
+#endif
+#if defined(LOAD_SHEDDING) || defined(NOTE_PRIORITY)
+        uint32_t serialQueued = SerialQueued();
+#endif
+#ifdef LOAD_SHEDDING
+        sheddingActive = ( serialQueued > CFG_SERIAL_LOAD_SHEDDING );
+#endif
+#ifdef NOTE_PRIORITY
+        priorityActive = ( serialQueued > CFG_SERIAL_NOTE_PRIORITY );
+#endif
+
+        // Do we have MIDI USB packets available ?
         if ( MidiUSB.available() )
         {
             // Set idle timeout
             turnOnMillis = currentMillis + LED_IDLE_TIME;
 
-            // Read a Midi USB packet .
-            if ( !isSerialBusy )
+            // Process a batch of Midi USB packets
+            if ( MidiUSB.forEachPacket(ProcessUSBPacket, USB_PACKET_BATCH_SIZE) )
             {
-                midiPacket_t pk;
-                pk.i = MidiUSB.readPacket();
-
                 // Turn LED on and set flash timeout
                 turnOffMillis = currentMillis + LED_FLASH_TIME;
                 turnOffEnabled = true;
                 LED_TurnOn();
-
-                ProcessPacket(&pk);
-            }
-            else
-            {
-                isSerialBusy = false;
             }
         }
+
+#ifdef SYSEX_STAGING
+        // Write staged packets, which are older than pending packets
+        StagingFlush(false);
+#endif
+
+#ifdef PENDING_WINDOW
+        // Write pending packets which are due
+        PendingFlush(false);
+#endif
+
+#ifdef SERIAL_UTILIZATION
+        // Blink LED while a serial port is saturated (instead of flashing on USB activity)
+        if ( SerialSaturated() )
+        {
+            if ( (currentMillis / LED_SATURATED_TIME) & 1 ) LED_TurnOff();
+            else LED_TurnOn();
+        }
+#endif
     }
     // Are we physically connected to USB
     else
     {
-        runningStatus = 0;
-        lastPort = 0xFF;
+        for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ ) SerialStateReset(&serialState[s]);
+
+#ifdef PENDING_WINDOW
+        pendingCount = 0;
+#endif
+#ifdef CHANNEL_SHADOW
+        ShadowInvalidate();
+#endif
+#ifdef SYSEX_STAGING
+        StagingInit();
+#endif
+#ifdef CHANNEL_SPREAD
+        SpreadInit();
+#endif
+#ifdef SERIAL_MIDI_IN
+        for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ ) serial_rx_reset(s);
+        usbInCount = 0;
+        usbInZeroLength = false;
+#endif
+#ifdef DIAG_SYSEX
+        diagQueryPort = DIAG_NONE;
+        diagReplyPort = DIAG_NONE;
+#endif
+#ifdef PACKET_TRACE
+        trace_pause(false);
+#endif
 
         // Turn LED off
         turnOffEnabled = false;
@@ -294,20 +1817,33 @@ void loop()
     }
 
 
+#ifdef DIAG_SYSEX
+    // Replies to diagnostic queries are sent before serial MIDI
+    if ( midiUSBCx ) DiagReply();
+#endif
+
     // Process Serial ports
     for ( uint8_t s = 0; s < SERIAL_INTERFACE_MAX ; s++ )
     {
         if ( serialSpeed[s] == 0 ) continue;
 
+#ifdef SERIAL_MIDI_IN
+        // Forward MIDI from Serial 1 to n to the host
+        if ( midiUSBCx )
+        {
+            SerialReceive(s);
+            continue;
+        }
+#endif
+
         // Do we have any MIDI msg on Serial 1 to n ?
         if ( serialHw[s]->available() )
         {
             serialHw[s]->read();
         }
-
-        // Manage Serial contention vs USB
-        // When one or more of the serial buffer is full, we block USB read one round.
-        // This implies to use non blocking Serial.write(buff,len).
-        if (  midiUSBCx &&  !serialHw[s]->availableForWrite() ) isSerialBusy = true; // 1 round without reading USB
     }
+
+#ifdef SERIAL_MIDI_IN
+    if ( midiUSBCx ) UsbInFlush();
+#endif
 }
@@ -39,13 +39,95 @@
 // Uncomment to change the USB device to low power (100 mA)
 //#define CFG_USB_MIDI_LOW_POWER           1
 
+// Comment to disable double buffering of the USB MIDI OUT endpoint
+#define CFG_USB_MIDI_RX_DOUBLE_BUFFER    1
+
+// Uncomment to change the size of the USB MIDI receive buffer (in packets, power of 2)
+//#define CFG_USB_MIDI_RX_RING_SIZE        256
+
 // Comment to disable Running Status on serial ports (i.e. always send complete MIDI message)
 #define CFG_SERIAL_RUNNING_STATUS        1
 
+// Uncomment to drop Program Change, Bank Select, Volume, Pan and RPN/NRPN selection messages
+// which don't change the last sent value
+//#define CFG_SERIAL_CHANNEL_SHADOW        1
+
+// Uncomment to merge pending Pitch Bend, Pressure and continuous Control Change messages (keeping the newest value)
+// when more than the given number of bytes is waiting in the transmit buffer of a serial port
+//#define CFG_SERIAL_LOAD_SHEDDING         64
+
+// Uncomment to send pending Note On/Off messages ahead of other messages from other ports or channels
+// when more than the given number of bytes is waiting in the transmit buffer of a serial port
+// (up to CFG_USB_MIDI_RX_RING_SIZE packets are pending, each uses 8 bytes of RAM)
+//#define CFG_SERIAL_NOTE_PRIORITY         64
+
+// Uncomment to hold packets from other ports while SysEx from one port is being sent (only with multiple USB MIDI ports)
+// The value is the number of 64-byte blocks for holding the packets
+//#define CFG_SERIAL_SYSEX_STAGING         16
+
+// Comment to disable DMA transmission on serial ports USART1-3 (i.e. use interrupt-driven HardwareSerial transmission)
+#define CFG_SERIAL_DMA_TX                1
+
+// Comment to disable sending System RealTime messages ahead of other queued bytes on serial ports USART1-3
+// (with multiple USB MIDI ports only while their port is selected, otherwise they are sent in order after Port Selection message)
+// The value is the maximum number of other bytes sent before a System RealTime message
+// (the bytes are handed to DMA in parts of this size, each part costs one interrupt)
+#define CFG_SERIAL_REALTIME_EXPRESS      4
+
+// Uncomment to change the size of the transmit buffer of serial ports (in bytes, power of 2)
+//#define CFG_SERIAL_TX_BUFFER_SIZE        256
+
+// Uncomment to hold USB MIDI packets for up to the given time (microseconds) and group them by port
+// to reduce the number of Port Selection messages "F5 nn" (only with multiple USB MIDI ports)
+//#define CFG_PORT_COALESCE_WINDOW_US      1000
+
+// Uncomment to route USB MIDI ports to serial ports instead of sending all ports to all serial ports
+// The values are bit masks of serial ports (bit 0 = serial port 1, etc.) for USB MIDI port 1, 2, etc.
+// Port Selection messages "F5 nn" are not sent to serial ports which receive only one USB MIDI port
+//#define CFG_SERIAL_ROUTING               0x01, 0x02, 0x04, 0x08
+
+// Uncomment to spread MIDI channels of each USB MIDI port across the serial ports routed from it
+// (each channel is assigned to the least loaded serial port when first used, System messages are sent to all serial ports)
+//#define CFG_SERIAL_CHANNEL_SPREAD        1
+
+// Uncomment to forward MIDI received on serial ports to the host (adds a USB MIDI IN endpoint)
+// Each serial port is forwarded to the first USB MIDI port routed to it
+//#define CFG_USB_MIDI_IN                  1
+
+// Uncomment to measure the latency from USB reception of each packet to serial transmission of its last byte
+// (only on serial ports with DMA transmission, uses 8 bytes of RAM for each byte of their transmit buffers).
+// The histograms for each USB MIDI port and message class can be read and reset with SysEx "F0 7D 57 01 F7"
+// and "F0 7D 57 02 F7" (requires CFG_USB_MIDI_IN)
+//#define CFG_LATENCY_HISTOGRAM            1
+
+// Uncomment to count USB and serial events (received, dropped and written packets and bytes, stalls, etc.)
+// The counters can be read with SysEx "F0 7D 57 03 F7" (requires CFG_USB_MIDI_IN)
+//#define CFG_PERF_COUNTERS                1
+
+// Uncomment to profile CPU cycles (minimum, average, maximum) of loop(), ProcessPacket() and USB interrupts
+// The values can be read and reset with SysEx "F0 7D 57 04 F7" and "F0 7D 57 05 F7" (requires CFG_USB_MIDI_IN)
+//#define CFG_PROFILER                     1
+
+// Uncomment to keep a trace of the last received USB MIDI packets and the bytes written to serial ports for them
+// The value is the number of entries (16 bytes each, power of 2). The trace can be read and reset with SysEx
+// "F0 7D 57 06 F7" and "F0 7D 57 07 F7" (requires CFG_USB_MIDI_IN), tools/trace_decode.py shows it as a timeline
+//#define CFG_PACKET_TRACE                 64
+
+// Uncomment to measure the utilization of serial ports (bytes written compared to the line speed, over 256 ms)
+// The LED blinks while the utilization of any serial port is at least the given value (percent)
+// The utilization can be read with SysEx "F0 7D 57 08 F7" (only with CFG_USB_MIDI_IN)
+//#define CFG_SERIAL_UTILIZATION           90
+
 // Uncomment/comment to enable/disable serial ports and change the speed (bauds)
 //#define CFG_SERIAL_PORT_1_SPEED 38400
 #define CFG_SERIAL_PORT_2_SPEED 31250
 //#define CFG_SERIAL_PORT_3_SPEED 115200
 //#define CFG_SERIAL_PORT_4_SPEED 57600
 
+// Host build (see "Host build" in README.md): the configuration of the simulated variant
+// changes the settings above
+#ifdef HOST_CONFIG
+ #include HOST_CONFIG
+#endif
+
 #endif
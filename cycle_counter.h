@@ -0,0 +1,59 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  CYCLE COUNTER
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _CYCLE_COUNTER_H_
+#define _CYCLE_COUNTER_H_
+#pragma once
+
+#include <stdint.h>
+
+// --------------------------------------------------------------------------------------
+// DWT cycle counter of the Cortex-M3
+// --------------------------------------------------------------------------------------
+// Counts CPU cycles, wraps around after 2^32 cycles (about 60 s at 72 MHz).
+// Differences of two values are valid across the wrap around.
+// Usable from C and C++ code, including interrupt handlers.
+
+// (the host build provides its own registers)
+#ifndef CYCLE_COUNTER_DWT_CNT
+ #define CYCLE_COUNTER_DEMCR     (*(volatile uint32_t *)0xE000EDFC)
+ #define CYCLE_COUNTER_DWT_CTRL  (*(volatile uint32_t *)0xE0001000)
+ #define CYCLE_COUNTER_DWT_CNT   (*(volatile uint32_t *)0xE0001004)
+#endif
+
+#define CYCLE_COUNTER_DEMCR_TRCENA   (1 << 24)
+#define CYCLE_COUNTER_CTRL_CYCCNTENA (1 << 0)
+
+// Enable the cycle counter
+static inline void cycle_counter_begin(void) {
+    CYCLE_COUNTER_DEMCR |= CYCLE_COUNTER_DEMCR_TRCENA;
+    CYCLE_COUNTER_DWT_CNT = 0;
+    CYCLE_COUNTER_DWT_CTRL |= CYCLE_COUNTER_CTRL_CYCCNTENA;
+}
+
+static inline uint32_t cycle_counter_now(void) {
+    return CYCLE_COUNTER_DWT_CNT;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - COMPARE TOOL
+  ----------------------------------------------------------------------
+
+*/
+
+// Compares a value reported by two programs (i.e. tests of two variants of the firmware)
+// compare KEY less|greater|equal PROGRAM_A PROGRAM_B [RATIO]
+// Succeeds when the value of the key reported by A is less than (greater than, equal to)
+// the value reported by B, multiplied by the ratio (1 by default).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static bool compare_run(const char *program, const char *key, double &value) {
+    FILE *p = popen(program, "r");
+    if (p == NULL) return false;
+
+    char line[256];
+    size_t len = strlen(key);
+    bool found = false;
+    while (fgets(line, sizeof(line), p)) {
+        if (strncmp(line, key, len) == 0 && line[len] == '=') {
+            value = strtod(line + len + 1, NULL);
+            found = true;
+        }
+    }
+
+    int status = pclose(p);
+    if (status != 0) fprintf(stderr, "%s failed\n", program);
+    return found && status == 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "usage: %s KEY less|greater|equal PROGRAM_A PROGRAM_B [RATIO]\n", argv[0]);
+        return 2;
+    }
+
+    const char *key = argv[1];
+    std::string relation = argv[2];
+    double ratio = (argc == 6) ? strtod(argv[5], NULL) : 1;
+    double a, b;
+
+    if (!compare_run(argv[3], key, a) || !compare_run(argv[4], key, b)) {
+        fprintf(stderr, "%s not reported\n", key);
+        return 1;
+    }
+
+    printf("%s: %g (%s) vs %g (%s)\n", key, a, argv[3], b, argv[4]);
+    b *= ratio;
+
+    bool ok = (relation == "less") ? (a < b) :
+              (relation == "greater") ? (a > b) :
+              (relation == "equal") ? (a == b) : false;
+    if (!ok) fprintf(stderr, "%s: expected %s than %g\n", key, relation.c_str(), b);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,2 @@
+// Host build: one USB packet processed in each iteration of loop() (like before batching)
+#define USB_PACKET_BATCH_SIZE 1
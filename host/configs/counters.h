@@ -0,0 +1,5 @@
+// Host build: two USB MIDI ports with port coalescing, performance counters read over the USB MIDI IN endpoint
+#define CFG_USB_MIDI_IO_PORT_NUM 2
+#define CFG_PORT_COALESCE_WINDOW_US 1000
+#define CFG_USB_MIDI_IN 1
+#define CFG_PERF_COUNTERS 1
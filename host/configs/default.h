@@ -0,0 +1 @@
+// Host build: the configuration in config.h as it is shipped
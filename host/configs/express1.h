@@ -0,0 +1,3 @@
+// Host build: System RealTime messages sent after at most one other queued byte
+#undef CFG_SERIAL_REALTIME_EXPRESS
+#define CFG_SERIAL_REALTIME_EXPRESS 1
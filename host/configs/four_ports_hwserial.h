@@ -0,0 +1,6 @@
+// Host build: four USB MIDI ports sent to four serial ports at MIDI speed, all transmitted by HardwareSerial
+#define CFG_USB_MIDI_IO_PORT_NUM 4
+#define CFG_SERIAL_PORT_1_SPEED 31250
+#define CFG_SERIAL_PORT_3_SPEED 31250
+#define CFG_SERIAL_PORT_4_SPEED 31250
+#undef CFG_SERIAL_DMA_TX
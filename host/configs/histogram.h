@@ -0,0 +1,3 @@
+// Host build: latency histograms, read over the USB MIDI IN endpoint
+#define CFG_USB_MIDI_IN 1
+#define CFG_LATENCY_HISTOGRAM 1
@@ -0,0 +1,2 @@
+// Host build: MIDI received on the serial ports forwarded to the host
+#define CFG_USB_MIDI_IN 1
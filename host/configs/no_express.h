@@ -0,0 +1,2 @@
+// Host build: System RealTime messages sent in order with the other bytes
+#undef CFG_SERIAL_REALTIME_EXPRESS
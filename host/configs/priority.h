@@ -0,0 +1,2 @@
+// Host build: pending Note On/Off messages sent first when more than 64 bytes wait for transmission
+#define CFG_SERIAL_NOTE_PRIORITY 64
@@ -0,0 +1,7 @@
+// Host build: four USB MIDI ports routed to four serial ports at MIDI speed, the last two ports share two serial ports with SysEx staging
+#define CFG_USB_MIDI_IO_PORT_NUM 4
+#define CFG_SERIAL_PORT_1_SPEED 31250
+#define CFG_SERIAL_PORT_3_SPEED 31250
+#define CFG_SERIAL_PORT_4_SPEED 31250
+#define CFG_SERIAL_ROUTING 0x01, 0x02, 0x0C, 0x0C
+#define CFG_SERIAL_SYSEX_STAGING 16
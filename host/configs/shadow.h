@@ -0,0 +1,2 @@
+// Host build: channel messages which don't change the last sent value are dropped
+#define CFG_SERIAL_CHANNEL_SHADOW 1
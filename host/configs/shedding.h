@@ -0,0 +1,2 @@
+// Host build: pending controller changes merged when more than 64 bytes wait for transmission
+#define CFG_SERIAL_LOAD_SHEDDING 64
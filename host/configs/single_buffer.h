@@ -0,0 +1,2 @@
+// Host build: the USB MIDI OUT endpoint without double buffering
+#undef CFG_USB_MIDI_RX_DOUBLE_BUFFER
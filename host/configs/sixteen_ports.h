@@ -0,0 +1,2 @@
+// Host build: sixteen USB MIDI ports
+#define CFG_USB_MIDI_IO_PORT_NUM 16
@@ -0,0 +1,5 @@
+// Host build: one USB MIDI port sent to four serial ports at MIDI speed, each channel sent to one of them
+#define CFG_SERIAL_PORT_1_SPEED 31250
+#define CFG_SERIAL_PORT_3_SPEED 31250
+#define CFG_SERIAL_PORT_4_SPEED 31250
+#define CFG_SERIAL_CHANNEL_SPREAD 1
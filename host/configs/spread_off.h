@@ -0,0 +1,4 @@
+// Host build: one USB MIDI port sent to four serial ports at MIDI speed
+#define CFG_SERIAL_PORT_1_SPEED 31250
+#define CFG_SERIAL_PORT_3_SPEED 31250
+#define CFG_SERIAL_PORT_4_SPEED 31250
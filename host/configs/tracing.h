@@ -0,0 +1,3 @@
+// Host build: packet trace of 1024 entries read over the USB MIDI IN endpoint
+#define CFG_USB_MIDI_IN 1
+#define CFG_PACKET_TRACE 1024
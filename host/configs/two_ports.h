@@ -0,0 +1,2 @@
+// Host build: two USB MIDI ports sent to one serial port with Port Selection messages
+#define CFG_USB_MIDI_IO_PORT_NUM 2
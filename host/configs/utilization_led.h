@@ -0,0 +1,2 @@
+// Host build: utilization of serial ports shown only by the LED
+#define CFG_SERIAL_UTILIZATION 90
@@ -0,0 +1,203 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - TEST CORPUS
+  ----------------------------------------------------------------------
+
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+#include "corpus.h"
+
+#define CORPUS_MS 1000000ULL
+
+#define CH_MELODY 0
+#define CH_BASS   1
+#define CH_CHORDS 2
+#define CH_DRUMS  9
+
+class CorpusSong {
+public:
+    CorpusSong(const CorpusOptions &o) : o(o), rng(o.seed) {}
+
+    void add(uint64_t timeNs, uint8_t port, std::initializer_list<uint8_t> bytes) {
+        messages.push_back(MidiMessage{timeNs, port, std::vector<uint8_t>(bytes)});
+    }
+
+    void note(uint64_t timeNs, uint64_t durationNs, uint8_t port, uint8_t channel, uint8_t key, uint8_t velocity) {
+        add(timeNs, port, { (uint8_t)(0x90 | channel), key, velocity });
+        if (o.runningNotes) add(timeNs + durationNs, port, { (uint8_t)(0x90 | channel), key, 0 });
+        else add(timeNs + durationNs, port, { (uint8_t)(0x80 | channel), key, 0x40 });
+    }
+
+    uint32_t random(uint32_t n) {
+        return std::uniform_int_distribution<uint32_t>(0, n - 1)(rng);
+    }
+
+    const CorpusOptions &o;
+    std::mt19937 rng;
+    std::vector<MidiMessage> messages;
+};
+
+std::vector<MidiMessage> corpus_song(const CorpusOptions &o) {
+    CorpusSong song(o);
+    const uint64_t beatNs = 60000000000ULL / o.bpm;
+    const uint64_t endNs = (uint64_t)o.seconds * 1000 * CORPUS_MS;
+    static const uint8_t roots[4] = { 0, 5, 7, 3 };
+    static const uint8_t scale[7] = { 0, 2, 4, 5, 7, 9, 11 };
+    static const uint8_t chord[8] = { 0, 4, 7, 11, 14, 17, 21, 24 };
+
+    for (uint8_t port = 0; port < o.ports; port++) {
+        // GM System On, then bank, program, volume and pan of each used channel
+        song.add(0, port, { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 });
+
+        uint8_t channels[20];
+        uint8_t count = 0;
+        channels[count++] = CH_MELODY;
+        channels[count++] = CH_BASS;
+        for (uint8_t c = 0; c < o.chordChannels && CH_CHORDS + c < CH_DRUMS; c++) channels[count++] = CH_CHORDS + c;
+        channels[count++] = CH_DRUMS;
+
+        for (uint8_t i = 0; i < count; i++) {
+            uint8_t ch = channels[i];
+            uint64_t t = 100 * CORPUS_MS + i * CORPUS_MS;
+            song.add(t, port, { (uint8_t)(0xB0 | ch), 0x00, 0x00 });
+            song.add(t, port, { (uint8_t)(0xB0 | ch), 0x20, 0x00 });
+            song.add(t, port, { (uint8_t)(0xC0 | ch), (uint8_t)(ch == CH_DRUMS ? 0 : (ch * 8 + port) & 0x7F) });
+            song.add(t, port, { (uint8_t)(0xB0 | ch), 0x07, 100 });
+            song.add(t, port, { (uint8_t)(0xB0 | ch), 0x0A, (uint8_t)(16 + (ch * 7) % 96) });
+        }
+
+        // Each port starts slightly later, like tracks which aren't quantized together
+        uint64_t offset = (uint64_t)port * o.portOffsetUs * 1000;
+        uint32_t beat = 0;
+        for (uint64_t t = beatNs; t + beatNs <= endNs; t += beatNs, beat++) {
+            uint64_t b = t + offset;
+            uint8_t root = 36 + roots[(beat / 2) % 4] + port;
+
+            // Drums
+            song.note(b, beatNs / 4, port, CH_DRUMS, (beat % 2) ? 38 : 36, 100 + song.random(27));
+            song.note(b, beatNs / 8, port, CH_DRUMS, 42, 60 + song.random(40));
+            song.note(b + beatNs / 2, beatNs / 8, port, CH_DRUMS, 42, 50 + song.random(40));
+
+            // Bass
+            song.note(b, beatNs / 2, port, CH_BASS, root, 90 + song.random(30));
+
+            // Chords every two beats
+            if (beat % 2 == 0) {
+                for (uint8_t c = 0; c < o.chordChannels && CH_CHORDS + c < CH_DRUMS; c++) {
+                    for (uint8_t n = 0; n < o.chordNotes && n < 8; n++) {
+                        uint8_t key = root + 12 * (c + 1) + chord[n];
+                        song.note(b, 2 * beatNs - beatNs / 8, port, CH_CHORDS + c, key & 0x7F, 70 + song.random(30));
+                    }
+                }
+            }
+
+            // Melody in eighth notes
+            for (uint8_t e = 0; e < 2; e++) {
+                uint8_t key = 60 + root % 12 + scale[song.random(7)] + 12 * song.random(2);
+                song.note(b + e * beatNs / 2, beatNs / 3, port, CH_MELODY, key, 64 + song.random(63));
+            }
+
+            // Controller automation (modulation and expression)
+            for (uint32_t i = 0; i < o.ccPerBeat; i++) {
+                uint64_t ct = b + beatNs * i / o.ccPerBeat;
+                uint8_t value = (uint8_t)((beat * o.ccPerBeat + i) & 0x7F);
+                for (uint8_t c = 0; c < count; c++) {
+                    if (channels[c] == CH_DRUMS) continue;
+                    song.add(ct, port, { (uint8_t)(0xB0 | channels[c]), (uint8_t)((i & 1) ? 0x0B : 0x01), value });
+                }
+            }
+
+            for (uint32_t i = 0; i < o.pitchBendPerBeat; i++) {
+                uint64_t pt = b + beatNs * i / o.pitchBendPerBeat;
+                uint16_t bend = 8192 + (int16_t)((int)((beat * o.pitchBendPerBeat + i) % 64) * 64 - 2048);
+                song.add(pt, port, { (uint8_t)(0xE0 | CH_MELODY), (uint8_t)(bend & 0x7F), (uint8_t)(bend >> 7) });
+            }
+
+            // SysEx dumps (Roland DT1 style: header, address, data, checksum)
+            if (o.sysexBytes >= 12 && beat % o.sysexEveryBeats == o.sysexEveryBeats - 1) {
+                MidiMessage dump{b + beatNs / 4, port, { 0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x00 }};
+                uint32_t sum = 0x40;
+                while (dump.bytes.size() < o.sysexBytes - 2) {
+                    uint8_t v = song.random(128);
+                    dump.bytes.push_back(v);
+                    sum += v;
+                }
+                dump.bytes.push_back((128 - (sum & 0x7F)) & 0x7F);
+                dump.bytes.push_back(0xF7);
+                song.messages.push_back(dump);
+            }
+        }
+    }
+
+    if (o.clock) {
+        song.add(beatNs - beatNs / 24, 0, { 0xFA });
+        for (uint64_t t = beatNs; t + beatNs <= endNs; t += beatNs / 24) song.add(t, 0, { 0xF8 });
+        song.add(endNs - beatNs / 2, 0, { 0xFC });
+    }
+
+    std::stable_sort(song.messages.begin(), song.messages.end(), [](const MidiMessage &a, const MidiMessage &b) {
+        return a.timeNs < b.timeNs;
+    });
+    return song.messages;
+}
+
+bool corpus_preset(const char *name, uint8_t ports, uint32_t seconds, CorpusOptions &o) {
+    o = CorpusOptions();
+    o.ports = ports;
+    o.seconds = seconds;
+
+    if (strcmp(name, "gm") == 0) {
+        o.chordChannels = 1;
+        o.chordNotes = 4;
+        o.ccPerBeat = 2;
+        o.pitchBendPerBeat = 2;
+        return true;
+    }
+    if (strcmp(name, "dense") == 0) {
+        o.chordChannels = 3;
+        o.chordNotes = 6;
+        o.bpm = 150;
+        return true;
+    }
+    if (strcmp(name, "automation") == 0) {
+        o.chordChannels = 2;
+        o.chordNotes = 4;
+        o.ccPerBeat = 16;
+        o.pitchBendPerBeat = 32;
+        return true;
+    }
+    if (strcmp(name, "sysex") == 0) {
+        o.chordNotes = 3;
+        o.sysexBytes = 256;
+        o.sysexEveryBeats = 2;
+        return true;
+    }
+    if (strcmp(name, "clock") == 0) {
+        o.chordNotes = 4;
+        o.chordChannels = 2;
+        o.clock = true;
+        return true;
+    }
+    return false;
+}
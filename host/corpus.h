@@ -0,0 +1,64 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - TEST CORPUS
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_CORPUS_H_
+#define _HOST_CORPUS_H_
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "midi.h"
+
+// --------------------------------------------------------------------------------------
+// Generated General MIDI songs
+// --------------------------------------------------------------------------------------
+// Deterministic (for a given seed) songs used by the tests and benchmarks instead of
+// MIDI files: a GM reset, bank and program selection, then drums, bass, chords and a
+// melody on each USB MIDI port, with optional controller automation, SysEx dumps and
+// MIDI clock.
+
+struct CorpusOptions {
+    uint32_t seed = 1;
+    uint8_t ports = 1;
+    uint32_t seconds = 10;
+    uint32_t bpm = 120;
+    uint8_t chordNotes = 3;         // Notes of each chord
+    uint8_t chordChannels = 1;      // Channels playing chords (from channel 3)
+    uint32_t ccPerBeat = 0;         // Controller changes per beat on each melodic channel
+    uint32_t pitchBendPerBeat = 0;  // Pitch Bend changes per beat on the melody channel
+    uint32_t sysexBytes = 0;        // Size of the SysEx dumps (0 = no dumps)
+    uint32_t sysexEveryBeats = 4;   // Beats between SysEx dumps
+    bool clock = false;             // MIDI clock (24 per quarter note) on port 0
+    bool runningNotes = true;       // Note Off as Note On with zero velocity (as many files do)
+    uint32_t portOffsetUs = 1500;   // Delay of each port after the previous one (0 = ports quantized together)
+};
+
+std::vector<MidiMessage> corpus_song(const CorpusOptions &options);
+
+// Song of the named preset: "gm", "dense" (dense chords), "automation" (heavy controller
+// automation), "sysex" (large SysEx dumps), "clock" (MIDI clock with notes)
+bool corpus_preset(const char *name, uint8_t ports, uint32_t seconds, CorpusOptions &options);
+
+#endif
@@ -0,0 +1,53 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - DIAGNOSTIC SYSEX
+  ----------------------------------------------------------------------
+
+*/
+
+
+#include "diag.h"
+
+#define DIAG_ID_0 0x7D
+#define DIAG_ID_1 0x57
+
+MidiMessage diag_query(uint64_t timeNs, uint8_t port, uint8_t cmd) {
+    return MidiMessage{timeNs, port, { 0xF0, DIAG_ID_0, DIAG_ID_1, cmd, 0xF7 }};
+}
+
+std::vector<std::vector<uint8_t>> diag_replies(const std::vector<uint32_t> &packets, uint8_t cmd) {
+    std::vector<std::vector<uint8_t>> replies;
+
+    for (const MidiMessage &m : midi_from_packets(packets)) {
+        const std::vector<uint8_t> &b = m.bytes;
+        if (b.size() >= 5 && b[0] == 0xF0 && b[1] == DIAG_ID_0 && b[2] == DIAG_ID_1 && b[3] == cmd && b.back() == 0xF7) {
+            replies.push_back(b);
+        }
+    }
+
+    return replies;
+}
+
+uint32_t diag_value(const std::vector<uint8_t> &reply, size_t offset) {
+    uint32_t value = 0;
+
+    for (size_t i = 0; i < 5 && offset + i < reply.size(); i++) value |= (uint32_t)(reply[offset + i] & 0x7F) << (7 * i);
+    return value;
+}
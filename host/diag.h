@@ -0,0 +1,49 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - DIAGNOSTIC SYSEX
+  ----------------------------------------------------------------------
+
+*/
+
+
+#ifndef _HOST_DIAG_H_
+#define _HOST_DIAG_H_
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "midi.h"
+
+// --------------------------------------------------------------------------------------
+// Diagnostic SysEx queries "F0 7D 57 cc F7" and their replies "F0 7D 57 cc ... F7"
+// --------------------------------------------------------------------------------------
+
+// Query message of the command
+MidiMessage diag_query(uint64_t timeNs, uint8_t port, uint8_t cmd);
+
+// Replies of the command among the USB MIDI packets received by the host
+std::vector<std::vector<uint8_t>> diag_replies(const std::vector<uint32_t> &packets, uint8_t cmd);
+
+// 32-bit value encoded in 5 bytes (7 bits each, least significant first) at the offset
+uint32_t diag_value(const std::vector<uint8_t> &reply, size_t offset);
+
+#endif
@@ -0,0 +1,203 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MIDI MESSAGES
+  ----------------------------------------------------------------------
+
+*/
+
+#include <stddef.h>
+
+#include "midi.h"
+
+int midi_data_len(uint8_t status) {
+    if (status < 0x80) return 0;
+    if (status < 0xF0) return ((status & 0xE0) == 0xC0) ? 1 : 2;
+
+    switch (status) {
+        case 0xF0: return -1;
+        case 0xF1: return 1;
+        case 0xF2: return 2;
+        case 0xF3: return 1;
+        case 0xF5: return 1;
+        default:   return 0;
+    }
+}
+
+uint32_t midi_packet(uint8_t port, uint8_t cin, uint8_t b1, uint8_t b2, uint8_t b3) {
+    return (uint32_t)((port << 4) | cin) | ((uint32_t)b1 << 8) | ((uint32_t)b2 << 16) | ((uint32_t)b3 << 24);
+}
+
+void midi_to_packets(const MidiMessage &msg, std::vector<uint32_t> &packets) {
+    const std::vector<uint8_t> &b = msg.bytes;
+    if (b.empty()) return;
+
+    uint8_t status = b[0];
+
+    if (status == 0xF0) {
+        size_t i = 0;
+        while (b.size() - i > 3) {
+            packets.push_back(midi_packet(msg.port, 0x04, b[i], b[i + 1], b[i + 2]));
+            i += 3;
+        }
+        size_t left = b.size() - i;
+        packets.push_back(midi_packet(msg.port, 0x04 + left, b[i], left > 1 ? b[i + 1] : 0, left > 2 ? b[i + 2] : 0));
+        return;
+    }
+
+    if (status < 0xF0) {
+        packets.push_back(midi_packet(msg.port, status >> 4, b[0], b.size() > 1 ? b[1] : 0, b.size() > 2 ? b[2] : 0));
+        return;
+    }
+
+    if (status >= 0xF8) {
+        packets.push_back(midi_packet(msg.port, 0x0F, status));
+        return;
+    }
+
+    // System Common
+    int len = midi_data_len(status);
+    uint8_t cin = (len == 0) ? 0x05 : (len == 1) ? 0x02 : 0x03;
+    packets.push_back(midi_packet(msg.port, cin, b[0], b.size() > 1 ? b[1] : 0, b.size() > 2 ? b[2] : 0));
+}
+
+std::vector<MidiMessage> midi_from_packets(const std::vector<uint32_t> &packets) {
+    static const uint8_t cinLen[16] = { 0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1 };
+    std::vector<MidiMessage> messages;
+    std::vector<uint8_t> sysEx[16];
+
+    for (uint32_t packet : packets) {
+        uint8_t port = (packet >> 4) & 0x0F;
+        uint8_t cin = packet & 0x0F;
+        std::vector<uint8_t> bytes;
+        for (uint8_t i = 0; i < cinLen[cin]; i++) bytes.push_back((packet >> (8 * (i + 1))) & 0xFF);
+
+        if (cin == 0x04 || ((cin >= 0x05 && cin <= 0x07) && (bytes[0] == 0xF0 || !sysEx[port].empty()))) {
+            sysEx[port].insert(sysEx[port].end(), bytes.begin(), bytes.end());
+            if (cin == 0x04) continue;
+
+            messages.push_back(MidiMessage{0, port, sysEx[port]});
+            sysEx[port].clear();
+        } else if (!bytes.empty()) {
+            messages.push_back(MidiMessage{0, port, bytes});
+        }
+    }
+
+    return messages;
+}
+
+bool midi_is_note_off(const std::vector<uint8_t> &bytes) {
+    if (bytes.size() != 3) return false;
+    return (bytes[0] & 0xF0) == 0x80 || ((bytes[0] & 0xF0) == 0x90 && bytes[2] == 0);
+}
+
+bool midi_is_note_on(const std::vector<uint8_t> &bytes) {
+    if (bytes.size() != 3) return false;
+    return (bytes[0] & 0xF0) == 0x90 && bytes[2] != 0;
+}
+
+// --------------------------------------------------------------------------------------
+// WIRE DECODER
+// --------------------------------------------------------------------------------------
+
+WireDecoder::WireDecoder(bool portSelection) {
+    this->portSelection = portSelection;
+    port = 0;
+    runningStatus = 0;
+    selectingPort = false;
+    sysEx = false;
+    dataLen = 0;
+    bytes = 0;
+    portSelections = 0;
+    runningStatusMessages = 0;
+    strayBytes = 0;
+}
+
+void WireDecoder::feed(uint8_t data, uint64_t timeNs) {
+    bytes++;
+
+    // RealTime messages may appear anywhere
+    if (data >= 0xF8) {
+        messages.push_back(WireMessage{timeNs, port, std::vector<uint8_t>(1, data)});
+        return;
+    }
+
+    if (data & 0x80) {
+        if (sysEx && data == 0xF7) {
+            current.push_back(data);
+            messages.push_back(WireMessage{timeNs, port, current});
+            current.clear();
+            sysEx = false;
+            return;
+        }
+
+        // A status byte ends an unterminated SysEx
+        sysEx = false;
+        selectingPort = false;
+        current.clear();
+
+        if (data == 0xF5 && portSelection) {
+            selectingPort = true;
+            runningStatus = 0;
+            return;
+        }
+
+        if (data >= 0xF0) runningStatus = 0;
+        else runningStatus = data;
+
+        current.push_back(data);
+        dataLen = midi_data_len(data);
+        if (dataLen < 0) {
+            sysEx = true;
+        } else if (dataLen == 0) {
+            messages.push_back(WireMessage{timeNs, port, current});
+            current.clear();
+        }
+        return;
+    }
+
+    // Data byte
+    if (selectingPort) {
+        selectingPort = false;
+        port = data - 1;
+        portSelections++;
+        return;
+    }
+
+    if (sysEx) {
+        current.push_back(data);
+        return;
+    }
+
+    if (current.empty()) {
+        if (runningStatus == 0) {
+            strayBytes++;
+            return;
+        }
+        current.push_back(runningStatus);
+        dataLen = midi_data_len(runningStatus);
+        runningStatusMessages++;
+    }
+
+    current.push_back(data);
+    if ((int)current.size() == dataLen + 1) {
+        messages.push_back(WireMessage{timeNs, port, current});
+        current.clear();
+    }
+}
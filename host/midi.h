@@ -0,0 +1,94 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MIDI MESSAGES
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_MIDI_H_
+#define _HOST_MIDI_H_
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// --------------------------------------------------------------------------------------
+// MIDI messages of the host and their USB MIDI packets
+// --------------------------------------------------------------------------------------
+
+// Complete MIDI message (SysEx includes F0 and F7) of a USB MIDI port
+struct MidiMessage {
+    uint64_t timeNs;
+    uint8_t port;
+    std::vector<uint8_t> bytes;
+};
+
+// Number of data bytes following the status byte (-1 for SysEx, 0 for unknown status)
+int midi_data_len(uint8_t status);
+
+// Append the USB MIDI packets of the message (SysEx is split in 3-byte packets)
+void midi_to_packets(const MidiMessage &msg, std::vector<uint32_t> &packets);
+
+// Messages of the USB MIDI packets (SysEx of each port assembled from its packets,
+// messages get time 0)
+std::vector<MidiMessage> midi_from_packets(const std::vector<uint32_t> &packets);
+
+// USB MIDI packet with the given cable number and MIDI bytes
+uint32_t midi_packet(uint8_t port, uint8_t cin, uint8_t b1, uint8_t b2 = 0, uint8_t b3 = 0);
+
+// Note On with zero velocity and Note Off are the same event
+bool midi_is_note_off(const std::vector<uint8_t> &bytes);
+bool midi_is_note_on(const std::vector<uint8_t> &bytes);
+
+// --------------------------------------------------------------------------------------
+// Decoder of the byte stream of a serial MIDI output
+// --------------------------------------------------------------------------------------
+// Restores Running Status and follows Port Selection messages "F5 nn" (when there are
+// multiple USB MIDI ports), messages are completed at the time of their last byte.
+
+struct WireMessage {
+    uint64_t timeNs;            // Time of the last byte
+    uint8_t port;               // USB MIDI port selected when the message was sent
+    std::vector<uint8_t> bytes; // Complete message with status byte
+};
+
+class WireDecoder {
+public:
+    explicit WireDecoder(bool portSelection);
+
+    void feed(uint8_t data, uint64_t timeNs);
+
+    std::vector<WireMessage> messages;
+    uint64_t bytes;
+    uint64_t portSelections;
+    uint64_t runningStatusMessages;     // Channel messages without status byte
+    uint64_t strayBytes;                // Data bytes without status
+
+private:
+    bool portSelection;
+    uint8_t port;
+    uint8_t runningStatus;
+    bool selectingPort;
+    bool sysEx;
+    int dataLen;
+    std::vector<uint8_t> current;
+};
+
+#endif
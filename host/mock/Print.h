@@ -0,0 +1,39 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK WIRISH
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _PRINT_H_
+#define _PRINT_H_
+#pragma once
+
+#include <stddef.h>
+#include <libmaple/libmaple_types.h>
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8 ch) = 0;
+    virtual size_t write(const uint8 *buffer, size_t size);
+};
+
+#endif
@@ -0,0 +1,48 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK WIRISH
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _BOARDS_H_
+#define _BOARDS_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+#include <libmaple/gpio.h>
+
+// Pins are numbered 16 per GPIO port (PA0 = 0, PB0 = 16, PC0 = 32, PD0 = 48)
+#define BOARD_NR_GPIO_PINS 64
+
+enum {
+    PA8  = 8,
+    PC9  = 32 + 9,
+    PC13 = 32 + 13
+};
+
+typedef struct stm32_pin_info {
+    gpio_dev *gpio_device;
+    uint8 gpio_bit;
+} stm32_pin_info;
+
+extern const stm32_pin_info PIN_MAP[BOARD_NR_GPIO_PINS];
+
+#endif
@@ -0,0 +1,43 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - FORCED INCLUDE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_BUILD_H_
+#define _HOST_BUILD_H_
+#pragma once
+
+// --------------------------------------------------------------------------------------
+// Included before every firmware source file of the host build
+// --------------------------------------------------------------------------------------
+
+#include "mock.h"
+
+// Cycle counter registers follow the virtual clock
+#define CYCLE_COUNTER_DEMCR     mock_demcr
+#define CYCLE_COUNTER_DWT_CTRL  mock_dwt_ctrl
+#define CYCLE_COUNTER_DWT_CNT   mock_dwt_cnt
+
+// Busy waits for the serial DMA interrupt advance the virtual clock
+#define SERIAL_TX_WAIT()        mock_wait()
+
+#endif
@@ -0,0 +1,83 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK LIBMAPLE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _LIBMAPLE_DMA_H_
+#define _LIBMAPLE_DMA_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// DMA controllers are only modeled for USART transmission: a channel whose peripheral
+// address is the data register of a mocked USART feeds one byte into the USART each
+// time its data register is empty (see mock_serial.cpp).
+
+typedef struct dma_dev dma_dev;
+
+extern dma_dev *DMA1;
+extern dma_dev *DMA2;
+
+typedef enum dma_channel {
+    DMA_CH1 = 1,
+    DMA_CH2,
+    DMA_CH3,
+    DMA_CH4,
+    DMA_CH5,
+    DMA_CH6,
+    DMA_CH7
+} dma_channel;
+
+typedef enum dma_xfer_size {
+    DMA_SIZE_8BITS,
+    DMA_SIZE_16BITS,
+    DMA_SIZE_32BITS
+} dma_xfer_size;
+
+#define DMA_MINC_MODE  (1U << 7)
+#define DMA_PINC_MODE  (1U << 6)
+#define DMA_CIRC_MODE  (1U << 5)
+#define DMA_FROM_MEM   (1U << 4)
+#define DMA_TRNS_ERR   (1U << 3)
+#define DMA_HALF_TRNS  (1U << 2)
+#define DMA_TRNS_CMPLT (1U << 1)
+
+void dma_init(dma_dev *dev);
+int  dma_setup_transfer(dma_dev *dev, dma_channel channel,
+                        __io void *peripheral_address, dma_xfer_size peripheral_size,
+                        __io void *memory_address, dma_xfer_size memory_size, uint32 mode);
+void dma_set_num_transfers(dma_dev *dev, dma_channel channel, uint16 num_transfers);
+void dma_set_mem_addr(dma_dev *dev, dma_channel channel, __io void *address);
+void dma_attach_interrupt(dma_dev *dev, dma_channel channel, void (*handler)(void));
+void dma_detach_interrupt(dma_dev *dev, dma_channel channel);
+void dma_enable(dma_dev *dev, dma_channel channel);
+void dma_disable(dma_dev *dev, dma_channel channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK LIBMAPLE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _LIBMAPLE_GPIO_H_
+#define _LIBMAPLE_GPIO_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gpio_dev {
+    uint32 odr;     // Output data register (only the mocked pins)
+} gpio_dev;
+
+typedef enum {
+    GPIO_OUTPUT_PP,
+    GPIO_INPUT_FLOATING
+} gpio_pin_mode;
+
+extern gpio_dev *GPIOA;
+extern gpio_dev *GPIOB;
+extern gpio_dev *GPIOC;
+extern gpio_dev *GPIOD;
+
+void gpio_set_mode(gpio_dev *dev, uint8 bit, gpio_pin_mode mode);
+void gpio_write_bit(gpio_dev *dev, uint8 bit, uint8 val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
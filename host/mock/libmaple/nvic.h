@@ -0,0 +1,54 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK LIBMAPLE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _LIBMAPLE_NVIC_H_
+#define _LIBMAPLE_NVIC_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    NVIC_USB_LP_CAN_RX0 = 20,
+    NVIC_USART1 = 37,
+    NVIC_USART2 = 38,
+    NVIC_USART3 = 39,
+    NVIC_UART4 = 52
+} nvic_irq_num;
+
+// Disabling the USB interrupt excludes the mocked USB interrupt handler
+// (which may run on another thread, see mock_usb_host_out())
+void nvic_irq_enable(nvic_irq_num irq_num);
+void nvic_irq_disable(nvic_irq_num irq_num);
+void nvic_globalirq_enable(void);
+void nvic_globalirq_disable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK LIBMAPLE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _LIBMAPLE_USART_H_
+#define _LIBMAPLE_USART_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct usart_reg_map {
+    __io uint32 SR;
+    __io uint32 DR;
+    __io uint32 BRR;
+    __io uint32 CR1;
+    __io uint32 CR2;
+    __io uint32 CR3;
+    __io uint32 GTPR;
+} usart_reg_map;
+
+#define USART_SR_TXE   (1U << 7)
+#define USART_SR_TC    (1U << 6)
+#define USART_SR_RXNE  (1U << 5)
+#define USART_CR3_DMAT (1U << 7)
+#define USART_CR3_DMAR (1U << 6)
+
+// Same layout and semantics as the libmaple ring buffer: bytes are inserted at tail
+// and removed at head, size is the capacity minus one.
+typedef struct ring_buffer {
+    volatile uint8 *buf;
+    volatile uint16 head;
+    volatile uint16 tail;
+    uint16 size;
+} ring_buffer;
+
+static inline uint16 rb_full_count(ring_buffer *rb) {
+    int32 size = rb->tail - rb->head;
+    if (rb->tail < rb->head) {
+        size += rb->size + 1;
+    }
+    return (uint16)size;
+}
+
+static inline int rb_is_full(ring_buffer *rb) {
+    return (rb->tail + 1 == rb->head) || (rb->tail == rb->size && rb->head == 0);
+}
+
+static inline int rb_is_empty(ring_buffer *rb) {
+    return rb->head == rb->tail;
+}
+
+static inline void rb_insert(ring_buffer *rb, uint8 element) {
+    rb->buf[rb->tail] = element;
+    rb->tail = (rb->tail == rb->size) ? 0 : rb->tail + 1;
+}
+
+static inline uint8 rb_remove(ring_buffer *rb) {
+    uint8 ch = rb->buf[rb->head];
+    rb->head = (rb->head == rb->size) ? 0 : rb->head + 1;
+    return ch;
+}
+
+typedef struct usart_dev {
+    usart_reg_map *regs;
+    ring_buffer *rb;
+    ring_buffer *wb;
+    uint32 max_baud;
+    uint8 index;            // Host build: index into the mocked USARTs
+} usart_dev;
+
+extern usart_dev *USART1;
+extern usart_dev *USART2;
+extern usart_dev *USART3;
+extern usart_dev *UART4;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK LIBMAPLE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _LIBMAPLE_USB_H_
+#define _LIBMAPLE_USB_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum usb_dev_state {
+    USB_UNCONNECTED,
+    USB_ATTACHED,
+    USB_POWERED,
+    USB_SUSPENDED,
+    USB_ADDRESSED,
+    USB_CONFIGURED
+} usb_dev_state;
+
+typedef enum usb_ep {
+    USB_EP0,
+    USB_EP1,
+    USB_EP2,
+    USB_EP3,
+    USB_EP4,
+    USB_EP5,
+    USB_EP6,
+    USB_EP7
+} usb_ep;
+
+typedef struct usblib_dev {
+    uint32 irq_mask;
+    void (**ep_int_in)(void);
+    void (**ep_int_out)(void);
+    usb_dev_state state;
+    usb_dev_state prevState;
+} usblib_dev;
+
+extern usblib_dev *USBLIB;
+
+// Initializes the USB device and enumerates it with the mocked host at once
+void usb_init_usblib(usblib_dev *dev, void (**ep_int_in)(void), void (**ep_int_out)(void));
+void usb_power_off(void);
+
+static inline uint8 usb_is_connected(usblib_dev *dev) {
+    return dev->state != USB_UNCONNECTED;
+}
+
+static inline uint8 usb_is_configured(usblib_dev *dev) {
+    return dev->state == USB_CONFIGURED;
+}
+
+// Descriptors
+#define USB_DESCRIPTOR_TYPE_DEVICE        0x01
+#define USB_DESCRIPTOR_TYPE_CONFIGURATION 0x02
+#define USB_DESCRIPTOR_TYPE_STRING        0x03
+#define USB_DESCRIPTOR_TYPE_INTERFACE     0x04
+#define USB_DESCRIPTOR_TYPE_ENDPOINT      0x05
+
+#define USB_DESCRIPTOR_ENDPOINT_IN        0x80
+#define USB_DESCRIPTOR_ENDPOINT_OUT       0x00
+
+#define USB_EP_TYPE_CONTROL               0x00
+#define USB_EP_TYPE_ISO                   0x01
+#define USB_EP_TYPE_BULK                  0x02
+#define USB_EP_TYPE_INTERRUPT             0x03
+
+#define USB_CONFIG_ATTR_BUSPOWERED        0x80
+#define USB_CONFIG_ATTR_SELF_POWERED      0xC0
+
+#define USB_DESCRIPTOR_STRING_LEN(x)      (2 + ((x) << 1))
+
+typedef struct usb_descriptor_device {
+    uint8  bLength;
+    uint8  bDescriptorType;
+    uint16 bcdUSB;
+    uint8  bDeviceClass;
+    uint8  bDeviceSubClass;
+    uint8  bDeviceProtocol;
+    uint8  bMaxPacketSize0;
+    uint16 idVendor;
+    uint16 idProduct;
+    uint16 bcdDevice;
+    uint8  iManufacturer;
+    uint8  iProduct;
+    uint8  iSerialNumber;
+    uint8  bNumConfigurations;
+} __packed usb_descriptor_device;
+
+typedef struct usb_descriptor_config_header {
+    uint8  bLength;
+    uint8  bDescriptorType;
+    uint16 wTotalLength;
+    uint8  bNumInterfaces;
+    uint8  bConfigurationValue;
+    uint8  iConfiguration;
+    uint8  bmAttributes;
+    uint8  bMaxPower;
+} __packed usb_descriptor_config_header;
+
+typedef struct usb_descriptor_interface {
+    uint8 bLength;
+    uint8 bDescriptorType;
+    uint8 bInterfaceNumber;
+    uint8 bAlternateSetting;
+    uint8 bNumEndpoints;
+    uint8 bInterfaceClass;
+    uint8 bInterfaceSubClass;
+    uint8 bInterfaceProtocol;
+    uint8 iInterface;
+} __packed usb_descriptor_interface;
+
+typedef struct usb_descriptor_string {
+    uint8 bLength;
+    uint8 bDescriptorType;
+    uint8 bString[];
+} usb_descriptor_string;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
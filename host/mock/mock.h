@@ -0,0 +1,135 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCKED HARDWARE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _MOCK_H_
+#define _MOCK_H_
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// --------------------------------------------------------------------------------------
+// MOCKED HARDWARE CONTROL
+// --------------------------------------------------------------------------------------
+// The firmware runs against mocked libmaple/wirish APIs driven by a virtual clock.
+// Time only advances when mock_advance() is called (by the simulator between calls to
+// loop(), or by the mocks while the firmware waits), events (bytes leaving a USART,
+// DMA transfer complete interrupts, scheduled host activity) run in time order.
+
+// --------------------------------------------------------------------------------------
+// Virtual time
+// --------------------------------------------------------------------------------------
+typedef void (*mock_event_fn)(void *ctx);
+
+uint64_t mock_now_ns(void);
+uint64_t mock_next_event_ns(void);          // UINT64_MAX when no event is scheduled
+void     mock_schedule(uint64_t time_ns, mock_event_fn fn, void *ctx);
+void     mock_advance(uint64_t ns);
+void     mock_advance_to(uint64_t time_ns);
+
+// Called by the firmware while it waits for an interrupt (serial transmit buffer full),
+// advances time to the next event
+void     mock_wait(void);
+uint64_t mock_wait_count(void);
+
+// Resets time, events and all mocked devices (call before setup())
+void     mock_reset(void);
+
+// Cycle counter registers (CPU clock 72 MHz, the counter follows virtual time)
+extern volatile uint32_t mock_demcr;
+extern volatile uint32_t mock_dwt_ctrl;
+extern volatile uint32_t mock_dwt_cnt;
+
+// Number of calls of the Arduino timing functions (millis(), micros()) and of digitalWrite()
+typedef struct {
+    uint64_t millis;
+    uint64_t micros;
+    uint64_t digitalWrite;
+} mock_arduino_calls;
+
+extern mock_arduino_calls mockArduinoCalls;
+
+// Level and number of changes of a digital output pin
+uint8_t  mock_pin_level(uint8_t pin);
+uint32_t mock_pin_changes(uint8_t pin);
+
+// --------------------------------------------------------------------------------------
+// Serial ports (0 = USART1, 1 = USART2, 2 = USART3, 3 = UART4)
+// --------------------------------------------------------------------------------------
+#define MOCK_SERIAL_PORTS 4
+
+// Called when the stop bit of a byte has been transmitted
+typedef void (*mock_serial_tx_fn)(uint8_t port, uint8_t data, uint64_t time_ns, void *ctx);
+
+typedef struct {
+    uint64_t txBytes;           // Bytes transmitted on the line
+    uint64_t txInterrupts;      // TXE interrupts (HardwareSerial transmission)
+    uint64_t dmaInterrupts;     // DMA transfer complete interrupts
+    uint64_t blockedWrites;     // HardwareSerial writes which waited for buffer space
+    uint64_t rxBytes;           // Bytes received from the line
+    uint64_t rxOverruns;        // Received bytes dropped because the receive buffer was full
+    uint64_t busyNs;            // Time spent transmitting
+} mock_serial_stats;
+
+void     mock_serial_set_tx_callback(mock_serial_tx_fn fn, void *ctx);
+const mock_serial_stats *mock_serial_get_stats(uint8_t port);
+uint32_t mock_serial_baud(uint8_t port);
+int      mock_serial_tx_idle(uint8_t port);
+
+// Bytes arriving on the receive line of the port, back to back starting now
+// (after the bytes which are still arriving)
+void     mock_serial_rx(uint8_t port, const uint8_t *data, uint32_t len);
+
+// --------------------------------------------------------------------------------------
+// USB (the host side of the MIDI endpoints)
+// --------------------------------------------------------------------------------------
+typedef struct {
+    uint64_t outTransactions;   // OUT transactions acknowledged by the device
+    uint64_t outNaks;           // OUT transactions NAKed by the device
+    uint64_t inTransactions;    // IN transactions with data (or zero length)
+    uint64_t inNaks;            // IN transactions NAKed by the device
+} mock_usb_stats;
+
+// OUT transaction of up to 16 packets on the MIDI OUT endpoint, the USB interrupt runs
+// before returning. Returns 1 when the device acknowledged the packets, 0 when it NAKed.
+int      mock_usb_host_out(const uint32_t *packets, uint32_t count);
+
+// IN transaction on the MIDI IN endpoint. Returns the number of packets received
+// (0 for a zero length packet), -1 when the device NAKed.
+int      mock_usb_host_in(uint32_t *packets, uint32_t max);
+
+const mock_usb_stats *mock_usb_get_stats(void);
+
+// Contents of the packet memory at the offset (for the tests of the copy routines)
+uint16_t mock_usb_pma_read(uint16_t offset);
+void     mock_usb_pma_write(uint16_t offset, uint16_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
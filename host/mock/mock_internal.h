@@ -0,0 +1,40 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCKED HARDWARE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _MOCK_INTERNAL_H_
+#define _MOCK_INTERNAL_H_
+#pragma once
+
+// Reset of each mocked device (see mock_reset())
+void mock_gpio_reset(void);
+void mock_serial_reset(void);
+void mock_usb_reset(void);
+
+// Are interrupts enabled (not disabled by noInterrupts())?
+bool mock_irq_enabled(void);
+
+// Run the DMA interrupts which were pending while interrupts were disabled
+void mock_serial_irqs(void);
+
+#endif
@@ -0,0 +1,409 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK SERIAL PORTS AND DMA
+  ----------------------------------------------------------------------
+
+*/
+
+#include <deque>
+
+#include <wirish.h>
+#include <libmaple/dma.h>
+#include <libmaple/usart.h>
+#include "mock.h"
+#include "mock_internal.h"
+
+// --------------------------------------------------------------------------------------
+// MOCKED USARTS
+// --------------------------------------------------------------------------------------
+// Each USART has a transmit data register and a shift register. When the data register
+// is empty, it's filled by the DMA channel attached to the USART (if the USART requests
+// DMA transfers), otherwise by the TXE interrupt from the transmit ring buffer. A byte
+// spends 10 bit times (start bit, 8 data bits, stop bit) in the shift register.
+
+// Size of the libmaple USART ring buffers
+#define MOCK_USART_RX_BUF_SIZE 64
+#define MOCK_USART_TX_BUF_SIZE 64
+
+struct MockUsart;
+
+struct MockDmaChannel {
+    bool enabled;
+    volatile void *peripheral;
+    volatile uint8 *memory;
+    uint32 count;
+    uint32 mode;
+    void (*handler)(void);
+    bool irqPending;
+    MockUsart *usart;
+};
+
+struct dma_dev {
+    MockDmaChannel channel[DMA_CH7 + 1];
+};
+
+struct MockUsart {
+    usart_reg_map regs;
+    ring_buffer rb;
+    ring_buffer wb;
+    uint8 rbBuffer[MOCK_USART_RX_BUF_SIZE];
+    uint8 wbBuffer[MOCK_USART_TX_BUF_SIZE];
+    usart_dev dev;
+
+    uint32 baud;
+    bool tdrFull;
+    uint8 tdr;
+    bool shifting;
+    uint8 shift;
+    bool pumping;
+    bool pumpAgain;
+    MockDmaChannel *dma;
+
+    std::deque<uint8> rxLine;           // Bytes arriving on the receive line
+    uint64_t rxEnd;                     // Arrival time of the last byte on the receive line
+
+    mock_serial_stats stats;
+};
+
+static MockUsart mockUsarts[MOCK_SERIAL_PORTS];
+static dma_dev dma1, dma2;
+static bool mockInDmaIrq = false;
+
+static mock_serial_tx_fn mockTxCallback = NULL;
+static void *mockTxContext = NULL;
+
+usart_dev *USART1 = &mockUsarts[0].dev;
+usart_dev *USART2 = &mockUsarts[1].dev;
+usart_dev *USART3 = &mockUsarts[2].dev;
+usart_dev *UART4 = &mockUsarts[3].dev;
+
+dma_dev *DMA1 = &dma1;
+dma_dev *DMA2 = &dma2;
+
+HardwareSerial Serial1(USART1);
+HardwareSerial Serial2(USART2);
+HardwareSerial Serial3(USART3);
+HardwareSerial Serial4(UART4);
+
+USBSerial Serial;
+
+static void mock_rb_init(ring_buffer *rb, uint8 *buffer, uint16 size) {
+    rb->buf = buffer;
+    rb->head = 0;
+    rb->tail = 0;
+    rb->size = size - 1;
+}
+
+void mock_serial_reset(void) {
+    for (uint8 i = 0; i < MOCK_SERIAL_PORTS; i++) {
+        MockUsart *u = &mockUsarts[i];
+
+        memset(&u->regs, 0, sizeof(u->regs));
+        mock_rb_init(&u->rb, u->rbBuffer, MOCK_USART_RX_BUF_SIZE);
+        mock_rb_init(&u->wb, u->wbBuffer, MOCK_USART_TX_BUF_SIZE);
+        u->dev.regs = &u->regs;
+        u->dev.rb = &u->rb;
+        u->dev.wb = &u->wb;
+        u->dev.max_baud = 2250000;
+        u->dev.index = i;
+
+        u->baud = 0;
+        u->tdrFull = false;
+        u->shifting = false;
+        u->pumping = false;
+        u->pumpAgain = false;
+        u->dma = NULL;
+        u->rxLine.clear();
+        u->rxEnd = 0;
+        memset(&u->stats, 0, sizeof(u->stats));
+    }
+
+    memset(&dma1, 0, sizeof(dma1));
+    memset(&dma2, 0, sizeof(dma2));
+    mockInDmaIrq = false;
+    mockTxCallback = NULL;
+    mockTxContext = NULL;
+}
+
+static MockUsart *mock_usart(usart_dev *dev) {
+    return &mockUsarts[dev->index];
+}
+
+// Duration of one byte on the line
+static uint64_t mock_byte_ns(MockUsart *u) {
+    return u->baud ? 10000000000ULL / u->baud : 0;
+}
+
+// Run the pending DMA transfer complete interrupts (unless interrupts are masked)
+static void mock_serial_dma_irqs(void) {
+    if (mockInDmaIrq || !mock_irq_enabled()) return;
+
+    mockInDmaIrq = true;
+    for (uint8 i = 0; i < MOCK_SERIAL_PORTS; i++) {
+        MockDmaChannel *ch = mockUsarts[i].dma;
+        if (ch == NULL || !ch->irqPending) continue;
+
+        ch->irqPending = false;
+        mockUsarts[i].stats.dmaInterrupts++;
+        ch->handler();
+    }
+    mockInDmaIrq = false;
+}
+
+void mock_serial_irqs(void) {
+    mock_serial_dma_irqs();
+}
+
+static void mock_usart_pump(MockUsart *u);
+
+// The byte in the shift register has been transmitted
+static void mock_usart_shift_done(void *ctx) {
+    MockUsart *u = (MockUsart *)ctx;
+
+    u->shifting = false;
+    u->stats.txBytes++;
+    u->stats.busyNs += mock_byte_ns(u);
+    if (mockTxCallback != NULL) mockTxCallback(u->dev.index, u->shift, mock_now_ns(), mockTxContext);
+
+    mock_usart_pump(u);
+}
+
+// Move bytes through the data register and the shift register
+static void mock_usart_pump(MockUsart *u) {
+    if (u->pumping) {
+        u->pumpAgain = true;
+        return;
+    }
+
+    u->pumping = true;
+    do {
+        u->pumpAgain = false;
+
+        if (!u->shifting && u->tdrFull && u->baud != 0) {
+            u->shifting = true;
+            u->shift = u->tdr;
+            u->tdrFull = false;
+            mock_schedule(mock_now_ns() + mock_byte_ns(u), mock_usart_shift_done, u);
+        }
+
+        if (u->tdrFull) break;
+
+        MockDmaChannel *ch = u->dma;
+        if (ch != NULL && ch->enabled && ch->count != 0 && (u->regs.CR3 & USART_CR3_DMAT)) {
+            u->tdr = *ch->memory;
+            u->tdrFull = true;
+            if (ch->mode & DMA_MINC_MODE) ch->memory++;
+            if (--ch->count == 0 && (ch->mode & DMA_TRNS_CMPLT) && ch->handler != NULL) ch->irqPending = true;
+            u->pumpAgain = true;
+        } else if (!rb_is_empty(&u->wb)) {
+            u->stats.txInterrupts++;
+            u->tdr = rb_remove(&u->wb);
+            u->tdrFull = true;
+            u->pumpAgain = true;
+        }
+    } while (u->pumpAgain);
+    u->pumping = false;
+
+    mock_serial_dma_irqs();
+}
+
+// A byte arrived on the receive line
+static void mock_usart_rx_done(void *ctx) {
+    MockUsart *u = (MockUsart *)ctx;
+
+    uint8 data = u->rxLine.front();
+    u->rxLine.pop_front();
+
+    u->stats.rxBytes++;
+    if (rb_is_full(&u->rb)) {
+        u->stats.rxOverruns++;
+        return;
+    }
+    rb_insert(&u->rb, data);
+}
+
+// --------------------------------------------------------------------------------------
+// MOCK CONTROL
+// --------------------------------------------------------------------------------------
+
+void mock_serial_set_tx_callback(mock_serial_tx_fn fn, void *ctx) {
+    mockTxCallback = fn;
+    mockTxContext = ctx;
+}
+
+const mock_serial_stats *mock_serial_get_stats(uint8_t port) {
+    return &mockUsarts[port].stats;
+}
+
+uint32_t mock_serial_baud(uint8_t port) {
+    return mockUsarts[port].baud;
+}
+
+int mock_serial_tx_idle(uint8_t port) {
+    MockUsart *u = &mockUsarts[port];
+
+    if (u->shifting || u->tdrFull || !rb_is_empty(&u->wb)) return 0;
+    if (u->dma != NULL && u->dma->enabled && u->dma->count != 0) return 0;
+    return 1;
+}
+
+void mock_serial_rx(uint8_t port, const uint8_t *data, uint32_t len) {
+    MockUsart *u = &mockUsarts[port];
+    uint64_t byteNs = mock_byte_ns(u);
+
+    if (u->rxEnd < mock_now_ns()) u->rxEnd = mock_now_ns();
+    for (uint32_t i = 0; i < len; i++) {
+        u->rxEnd += byteNs;
+        u->rxLine.push_back(data[i]);
+        mock_schedule(u->rxEnd, mock_usart_rx_done, u);
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// HARDWARESERIAL
+// --------------------------------------------------------------------------------------
+
+HardwareSerial::HardwareSerial(usart_dev *usart_device) {
+    this->usart_device = usart_device;
+}
+
+void HardwareSerial::begin(uint32 baud) {
+    MockUsart *u = mock_usart(this->usart_device);
+
+    u->baud = baud;
+    u->regs.CR1 = 1;
+}
+
+void HardwareSerial::end(void) {
+    MockUsart *u = mock_usart(this->usart_device);
+
+    u->regs.CR1 = 0;
+}
+
+int HardwareSerial::available(void) {
+    return rb_full_count(this->usart_device->rb);
+}
+
+int HardwareSerial::peek(void) {
+    ring_buffer *rb = this->usart_device->rb;
+
+    if (rb_is_empty(rb)) return -1;
+    return rb->buf[rb->head];
+}
+
+int HardwareSerial::read(void) {
+    ring_buffer *rb = this->usart_device->rb;
+
+    if (rb_is_empty(rb)) return -1;
+    return rb_remove(rb);
+}
+
+int HardwareSerial::availableForWrite(void) {
+    ring_buffer *wb = this->usart_device->wb;
+
+    return wb->size - rb_full_count(wb);
+}
+
+void HardwareSerial::flush(void) {
+    while (!mock_serial_tx_idle(this->usart_device->index)) mock_wait();
+}
+
+// The data register is written directly when it's empty, otherwise the byte is queued
+// for the TXE interrupt (waiting while the transmit ring buffer is full)
+size_t HardwareSerial::write(uint8 ch) {
+    MockUsart *u = mock_usart(this->usart_device);
+
+    if (!u->tdrFull && rb_is_empty(&u->wb)) {
+        u->tdr = ch;
+        u->tdrFull = true;
+        mock_usart_pump(u);
+        return 1;
+    }
+
+    if (rb_is_full(&u->wb)) {
+        u->stats.blockedWrites++;
+        while (rb_is_full(&u->wb)) mock_wait();
+    }
+
+    rb_insert(&u->wb, ch);
+    mock_usart_pump(u);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8 *buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) write(buffer[i]);
+    return size;
+}
+
+// --------------------------------------------------------------------------------------
+// DMA
+// --------------------------------------------------------------------------------------
+
+extern "C" void dma_init(dma_dev *dev) {
+}
+
+extern "C" int dma_setup_transfer(dma_dev *dev, dma_channel channel,
+                                  __io void *peripheral_address, dma_xfer_size peripheral_size,
+                                  __io void *memory_address, dma_xfer_size memory_size, uint32 mode) {
+    MockDmaChannel *ch = &dev->channel[channel];
+
+    ch->enabled = false;
+    ch->peripheral = peripheral_address;
+    ch->memory = (volatile uint8 *)memory_address;
+    ch->count = 0;
+    ch->mode = mode;
+    ch->usart = NULL;
+
+    // Only transfers of bytes to the data register of a USART are modeled
+    for (uint8 i = 0; i < MOCK_SERIAL_PORTS; i++) {
+        if (peripheral_address == &mockUsarts[i].regs.DR) {
+            ch->usart = &mockUsarts[i];
+            mockUsarts[i].dma = ch;
+        }
+    }
+    return 0;
+}
+
+extern "C" void dma_set_num_transfers(dma_dev *dev, dma_channel channel, uint16 num_transfers) {
+    dev->channel[channel].count = num_transfers;
+}
+
+extern "C" void dma_set_mem_addr(dma_dev *dev, dma_channel channel, __io void *address) {
+    dev->channel[channel].memory = (volatile uint8 *)address;
+}
+
+extern "C" void dma_attach_interrupt(dma_dev *dev, dma_channel channel, void (*handler)(void)) {
+    dev->channel[channel].handler = handler;
+}
+
+extern "C" void dma_detach_interrupt(dma_dev *dev, dma_channel channel) {
+    dev->channel[channel].handler = NULL;
+}
+
+extern "C" void dma_enable(dma_dev *dev, dma_channel channel) {
+    MockDmaChannel *ch = &dev->channel[channel];
+
+    ch->enabled = true;
+    if (ch->usart != NULL) mock_usart_pump(ch->usart);
+}
+
+extern "C" void dma_disable(dma_dev *dev, dma_channel channel) {
+    dev->channel[channel].enabled = false;
+}
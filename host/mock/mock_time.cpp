@@ -0,0 +1,235 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK TIME AND GPIO
+  ----------------------------------------------------------------------
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+
+#include <wirish.h>
+#include "mock.h"
+#include "mock_internal.h"
+
+// --------------------------------------------------------------------------------------
+// VIRTUAL CLOCK
+// --------------------------------------------------------------------------------------
+// Events scheduled for the same time run in the order they were scheduled.
+
+struct MockEvent {
+    mock_event_fn fn;
+    void *ctx;
+};
+
+static uint64_t mockNow = 0;
+static std::multimap<uint64_t, MockEvent> mockEvents;
+static uint64_t mockWaits = 0;
+static uint64_t mockWaitStart = 0;
+static uint64_t mockLastWait = UINT64_MAX;
+
+// Step of mock_wait() when no event is scheduled (so an idle wait can't hang forever)
+#define MOCK_WAIT_IDLE_NS 1000000
+
+// Waits longer than this are considered as a hang of the firmware
+#define MOCK_WAIT_LIMIT_NS 10000000000ULL
+
+volatile uint32_t mock_demcr = 0;
+volatile uint32_t mock_dwt_ctrl = 0;
+volatile uint32_t mock_dwt_cnt = 0;
+
+mock_arduino_calls mockArduinoCalls;
+
+// CPU cycles at 72 MHz since the start of the virtual clock
+static uint64_t mock_cycles(uint64_t ns) {
+    return ns * CYCLES_PER_MICROSECOND / 1000;
+}
+
+// Move the clock forward, the cycle counter counts the elapsed cycles
+static void mock_set_now(uint64_t time_ns) {
+    if (time_ns <= mockNow) return;
+
+    mock_dwt_cnt += (uint32_t)(mock_cycles(time_ns) - mock_cycles(mockNow));
+    mockNow = time_ns;
+}
+
+uint64_t mock_now_ns(void) {
+    return mockNow;
+}
+
+uint64_t mock_next_event_ns(void) {
+    if (mockEvents.empty()) return UINT64_MAX;
+    return mockEvents.begin()->first;
+}
+
+void mock_schedule(uint64_t time_ns, mock_event_fn fn, void *ctx) {
+    if (time_ns < mockNow) time_ns = mockNow;
+    mockEvents.insert(std::make_pair(time_ns, MockEvent{fn, ctx}));
+}
+
+void mock_advance_to(uint64_t time_ns) {
+    while (!mockEvents.empty() && mockEvents.begin()->first <= time_ns) {
+        std::multimap<uint64_t, MockEvent>::iterator it = mockEvents.begin();
+        MockEvent event = it->second;
+        mock_set_now(it->first);
+        mockEvents.erase(it);
+        event.fn(event.ctx);
+    }
+    mock_set_now(time_ns);
+}
+
+void mock_advance(uint64_t ns) {
+    mock_advance_to(mockNow + ns);
+}
+
+void mock_wait(void) {
+    // Consecutive waits without progress of the firmware in between
+    if (mockLastWait != mockNow) mockWaitStart = mockNow;
+    if (mockNow - mockWaitStart > MOCK_WAIT_LIMIT_NS) {
+        fprintf(stderr, "mock: firmware waits forever\n");
+        abort();
+    }
+
+    mockWaits++;
+    uint64_t next = mock_next_event_ns();
+    if (next == UINT64_MAX || next - mockNow > MOCK_WAIT_IDLE_NS) next = mockNow + MOCK_WAIT_IDLE_NS;
+    mock_advance_to(next);
+    mockLastWait = mockNow;
+}
+
+uint64_t mock_wait_count(void) {
+    return mockWaits;
+}
+
+void mock_reset(void) {
+    mockNow = 0;
+    mockEvents.clear();
+    mockWaits = 0;
+    mockWaitStart = 0;
+    mockLastWait = UINT64_MAX;
+    mock_demcr = 0;
+    mock_dwt_ctrl = 0;
+    mock_dwt_cnt = 0;
+    memset(&mockArduinoCalls, 0, sizeof(mockArduinoCalls));
+
+    mock_gpio_reset();
+    mock_serial_reset();
+    mock_usb_reset();
+}
+
+// --------------------------------------------------------------------------------------
+// ARDUINO TIMING
+// --------------------------------------------------------------------------------------
+
+uint32 millis(void) {
+    mockArduinoCalls.millis++;
+    return (uint32)(mockNow / 1000000);
+}
+
+uint32 micros(void) {
+    mockArduinoCalls.micros++;
+    return (uint32)(mockNow / 1000);
+}
+
+void delay(uint32 ms) {
+    mock_advance((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(uint32 us) {
+    mock_advance((uint64_t)us * 1000);
+}
+
+extern "C" void delay_us(uint32 us) {
+    mock_advance((uint64_t)us * 1000);
+}
+
+// --------------------------------------------------------------------------------------
+// GPIO
+// --------------------------------------------------------------------------------------
+
+static gpio_dev gpioa, gpiob, gpioc, gpiod;
+gpio_dev *GPIOA = &gpioa;
+gpio_dev *GPIOB = &gpiob;
+gpio_dev *GPIOC = &gpioc;
+gpio_dev *GPIOD = &gpiod;
+
+static uint32_t mockPinChanges[BOARD_NR_GPIO_PINS];
+
+#define PIN(dev, bit) { dev, bit }
+const stm32_pin_info PIN_MAP[BOARD_NR_GPIO_PINS] = {
+    PIN(&gpioa, 0), PIN(&gpioa, 1), PIN(&gpioa, 2), PIN(&gpioa, 3), PIN(&gpioa, 4), PIN(&gpioa, 5), PIN(&gpioa, 6), PIN(&gpioa, 7),
+    PIN(&gpioa, 8), PIN(&gpioa, 9), PIN(&gpioa, 10), PIN(&gpioa, 11), PIN(&gpioa, 12), PIN(&gpioa, 13), PIN(&gpioa, 14), PIN(&gpioa, 15),
+    PIN(&gpiob, 0), PIN(&gpiob, 1), PIN(&gpiob, 2), PIN(&gpiob, 3), PIN(&gpiob, 4), PIN(&gpiob, 5), PIN(&gpiob, 6), PIN(&gpiob, 7),
+    PIN(&gpiob, 8), PIN(&gpiob, 9), PIN(&gpiob, 10), PIN(&gpiob, 11), PIN(&gpiob, 12), PIN(&gpiob, 13), PIN(&gpiob, 14), PIN(&gpiob, 15),
+    PIN(&gpioc, 0), PIN(&gpioc, 1), PIN(&gpioc, 2), PIN(&gpioc, 3), PIN(&gpioc, 4), PIN(&gpioc, 5), PIN(&gpioc, 6), PIN(&gpioc, 7),
+    PIN(&gpioc, 8), PIN(&gpioc, 9), PIN(&gpioc, 10), PIN(&gpioc, 11), PIN(&gpioc, 12), PIN(&gpioc, 13), PIN(&gpioc, 14), PIN(&gpioc, 15),
+    PIN(&gpiod, 0), PIN(&gpiod, 1), PIN(&gpiod, 2), PIN(&gpiod, 3), PIN(&gpiod, 4), PIN(&gpiod, 5), PIN(&gpiod, 6), PIN(&gpiod, 7),
+    PIN(&gpiod, 8), PIN(&gpiod, 9), PIN(&gpiod, 10), PIN(&gpiod, 11), PIN(&gpiod, 12), PIN(&gpiod, 13), PIN(&gpiod, 14), PIN(&gpiod, 15),
+};
+#undef PIN
+
+void mock_gpio_reset(void) {
+    gpioa.odr = gpiob.odr = gpioc.odr = gpiod.odr = 0;
+    memset(mockPinChanges, 0, sizeof(mockPinChanges));
+}
+
+extern "C" void gpio_set_mode(gpio_dev *dev, uint8 bit, gpio_pin_mode mode) {
+}
+
+extern "C" void gpio_write_bit(gpio_dev *dev, uint8 bit, uint8 val) {
+    if (val) dev->odr |= 1U << bit;
+    else dev->odr &= ~(1U << bit);
+}
+
+void pinMode(uint8 pin, WiringPinMode mode) {
+}
+
+void digitalWrite(uint8 pin, uint8 val) {
+    mockArduinoCalls.digitalWrite++;
+    if (pin >= BOARD_NR_GPIO_PINS) return;
+
+    if (mock_pin_level(pin) != (val ? 1 : 0)) mockPinChanges[pin]++;
+    gpio_write_bit(PIN_MAP[pin].gpio_device, PIN_MAP[pin].gpio_bit, val);
+}
+
+uint32 digitalRead(uint8 pin) {
+    return mock_pin_level(pin);
+}
+
+uint8_t mock_pin_level(uint8_t pin) {
+    if (pin >= BOARD_NR_GPIO_PINS) return 0;
+    return (PIN_MAP[pin].gpio_device->odr >> PIN_MAP[pin].gpio_bit) & 1;
+}
+
+uint32_t mock_pin_changes(uint8_t pin) {
+    if (pin >= BOARD_NR_GPIO_PINS) return 0;
+    return mockPinChanges[pin];
+}
+
+// --------------------------------------------------------------------------------------
+// PRINT
+// --------------------------------------------------------------------------------------
+
+size_t Print::write(const uint8 *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
@@ -0,0 +1,440 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK USB PERIPHERAL
+  ----------------------------------------------------------------------
+
+*/
+
+#include <mutex>
+
+#include <wirish.h>
+#include <libmaple/usb.h>
+#include <libmaple/nvic.h>
+#include "usb_reg_map.h"
+#include "usb_lib_globals.h"
+#include "usb_core.h"
+#include "mock.h"
+#include "mock_internal.h"
+
+// --------------------------------------------------------------------------------------
+// MOCKED USB PERIPHERAL
+// --------------------------------------------------------------------------------------
+// The endpoint registers seen by the firmware hold the value of each register with
+// MOCK_USB_EPR_PUBLISHED set. A register without that bit was written by the firmware,
+// the write is applied with the hardware semantics before the next access.
+//
+// The host side of the MIDI endpoints (mock_usb_host_out(), mock_usb_host_in()) runs
+// the USB interrupt handler of the firmware right after the transaction, unless the
+// USB interrupt is disabled, in which case it runs when the interrupt is enabled again.
+// The host side may run on another thread than loop(): disabling the USB interrupt (or
+// all interrupts) takes a lock which is also held by the host side.
+
+#define MOCK_USB_EPR_PUBLISHED 0x80000000U
+#define MOCK_USB_EPR_BITS      0x0000FFFFU
+
+// Endpoints of the MIDI streaming interface (see usb_midi_device.h)
+#define MOCK_USB_IN_EP  1
+#define MOCK_USB_OUT_EP 2
+
+#define MOCK_USB_ENDPOINTS 8
+#define MOCK_USB_PMA_SIZE  0x200
+
+// Buffer table entry of an endpoint (a double-buffered OUT endpoint receives into
+// buffer 0 at the TX address and into buffer 1 at the RX address)
+struct MockUsbBtable {
+    uint16 txAddr;
+    uint16 txCount;
+    uint16 txSize;
+    uint16 rxAddr;
+    uint16 rxCount;
+    uint16 rxSize;
+};
+
+static usb_reg_map mockUsbRegs;
+static uint32 mockUsbEpr[MOCK_USB_ENDPOINTS];
+static MockUsbBtable mockUsbBtable[MOCK_USB_ENDPOINTS];
+static uint32 mockUsbPma[MOCK_USB_PMA_SIZE / 2];
+static mock_usb_stats mockUsbStats;
+
+static std::recursive_mutex mockIrqLock;
+static bool mockUsbIrqMasked = false;
+static bool mockGlobalIrqMasked = false;
+static bool mockUsbIrqPending = false;
+
+static usblib_dev usblib;
+usblib_dev *USBLIB = &usblib;
+
+DEVICE_INFO Device_Info;
+DEVICE_PROP Device_Property;
+USER_STANDARD_REQUESTS User_Standard_Requests;
+DEVICE Device_Table;
+
+DEVICE_INFO *pInformation = &Device_Info;
+DEVICE_PROP *pProperty = &Device_Property;
+USER_STANDARD_REQUESTS *pUser_Standard_Requests = &User_Standard_Requests;
+
+// --------------------------------------------------------------------------------------
+// ENDPOINT REGISTERS
+// --------------------------------------------------------------------------------------
+
+static void mock_usb_publish(uint8 ep) {
+    mockUsbRegs.EP[ep] = mockUsbEpr[ep] | MOCK_USB_EPR_PUBLISHED;
+}
+
+// Write to an endpoint register: CTR bits are cleared by writing 0, DTOG and STAT
+// bits are toggled by writing 1, SETUP is read only
+static void mock_usb_write_epr(uint8 ep, uint32 value) {
+    uint32 epr = mockUsbEpr[ep];
+    uint32 result = 0;
+
+    result |= epr & value & (USB_EP_CTR_RX | USB_EP_CTR_TX);
+    result |= (epr ^ value) & (USB_EP_DTOG_RX | USB_EP_STAT_RX | USB_EP_DTOG_TX | USB_EP_STAT_TX);
+    result |= value & (USB_EP_EP_TYPE | USB_EP_EP_KIND | USB_EP_EA);
+    result |= epr & USB_EP_SETUP;
+
+    mockUsbEpr[ep] = result;
+    mock_usb_publish(ep);
+}
+
+// Apply the endpoint register writes of the firmware
+static void mock_usb_sync(void) {
+    for (uint8 ep = 0; ep < MOCK_USB_ENDPOINTS; ep++) {
+        uint32 value = mockUsbRegs.EP[ep];
+        if (value != (mockUsbEpr[ep] | MOCK_USB_EPR_PUBLISHED)) {
+            mock_usb_write_epr(ep, value & MOCK_USB_EPR_BITS);
+        }
+    }
+}
+
+// Set the bits of an endpoint register directly (as the hardware does)
+static void mock_usb_set_epr(uint8 ep, uint32 mask, uint32 value) {
+    mock_usb_sync();
+    mockUsbEpr[ep] = (mockUsbEpr[ep] & ~mask) | (value & mask);
+    mock_usb_publish(ep);
+}
+
+extern "C" usb_reg_map *mock_usb_regs(void) {
+    mock_usb_sync();
+    return &mockUsbRegs;
+}
+
+extern "C" void usb_set_ep_type(uint8 ep, uint32 type) {
+    mock_usb_set_epr(ep, USB_EP_EP_TYPE, type);
+}
+
+extern "C" void usb_set_ep_kind(uint8 ep, uint32 kind) {
+    mock_usb_set_epr(ep, USB_EP_EP_KIND, kind);
+}
+
+extern "C" void usb_set_ep_rx_stat(uint8 ep, uint32 status) {
+    mock_usb_set_epr(ep, USB_EP_STAT_RX, status);
+}
+
+extern "C" void usb_set_ep_tx_stat(uint8 ep, uint32 status) {
+    mock_usb_set_epr(ep, USB_EP_STAT_TX, status);
+}
+
+extern "C" void usb_clear_status_out(uint8 ep) {
+    mock_usb_set_epr(ep, USB_EP_EP_KIND, 0);
+}
+
+// --------------------------------------------------------------------------------------
+// BUFFER TABLE AND PACKET MEMORY
+// --------------------------------------------------------------------------------------
+
+extern "C" void usb_set_ep_rx_addr(uint8 ep, uint16 addr) {
+    mockUsbBtable[ep].rxAddr = addr;
+}
+
+extern "C" void usb_set_ep_tx_addr(uint8 ep, uint16 addr) {
+    mockUsbBtable[ep].txAddr = addr;
+}
+
+// Sets the size of the receive buffer, the received count is cleared
+extern "C" void usb_set_ep_rx_count(uint8 ep, uint16 count) {
+    mockUsbBtable[ep].rxSize = count;
+    mockUsbBtable[ep].rxCount = 0;
+}
+
+extern "C" void usb_set_ep_tx_count(uint8 ep, uint16 count) {
+    mockUsbBtable[ep].txCount = count;
+}
+
+extern "C" uint16 usb_get_ep_rx_count(uint8 ep) {
+    return mockUsbBtable[ep].rxCount;
+}
+
+extern "C" uint16 usb_get_ep_tx_count(uint8 ep) {
+    return mockUsbBtable[ep].txCount;
+}
+
+extern "C" void usb_set_ep_rx_buf0_addr(uint8 ep, uint16 addr) {
+    mockUsbBtable[ep].txAddr = addr;
+}
+
+extern "C" void usb_set_ep_rx_buf1_addr(uint8 ep, uint16 addr) {
+    mockUsbBtable[ep].rxAddr = addr;
+}
+
+extern "C" void usb_set_ep_rx_buf0_count(uint8 ep, uint16 count) {
+    mockUsbBtable[ep].txSize = count;
+    mockUsbBtable[ep].txCount = 0;
+}
+
+extern "C" void usb_set_ep_rx_buf1_count(uint8 ep, uint16 count) {
+    usb_set_ep_rx_count(ep, count);
+}
+
+extern "C" uint16 usb_get_ep_rx_buf0_count(uint8 ep) {
+    return mockUsbBtable[ep].txCount;
+}
+
+extern "C" uint16 usb_get_ep_rx_buf1_count(uint8 ep) {
+    return mockUsbBtable[ep].rxCount;
+}
+
+extern "C" uint32 *usb_pma_ptr(uint32 offset) {
+    return &mockUsbPma[offset / 2];
+}
+
+uint16_t mock_usb_pma_read(uint16_t offset) {
+    return (uint16_t)mockUsbPma[offset / 2];
+}
+
+// The upper half of each PMA word isn't backed by packet memory, it's filled with
+// garbage so the copy routines must ignore it
+void mock_usb_pma_write(uint16_t offset, uint16_t value) {
+    mockUsbPma[offset / 2] = 0xA5A50000U | value;
+}
+
+// --------------------------------------------------------------------------------------
+// USB LIBRARY
+// --------------------------------------------------------------------------------------
+
+void mock_usb_reset(void) {
+    std::lock_guard<std::recursive_mutex> lock(mockIrqLock);
+
+    memset(&mockUsbRegs, 0, sizeof(mockUsbRegs));
+    memset(mockUsbEpr, 0, sizeof(mockUsbEpr));
+    memset(mockUsbBtable, 0, sizeof(mockUsbBtable));
+    memset(mockUsbPma, 0, sizeof(mockUsbPma));
+    memset(&mockUsbStats, 0, sizeof(mockUsbStats));
+    for (uint8 ep = 0; ep < MOCK_USB_ENDPOINTS; ep++) mock_usb_publish(ep);
+
+    if (mockUsbIrqMasked) mockIrqLock.unlock();
+    if (mockGlobalIrqMasked) mockIrqLock.unlock();
+    mockUsbIrqMasked = false;
+    mockGlobalIrqMasked = false;
+    mockUsbIrqPending = false;
+
+    memset(&usblib, 0, sizeof(usblib));
+}
+
+extern "C" void NOP_Process(void) {
+}
+
+extern "C" uint8 *Standard_GetDescriptorData(uint16 Length, ONE_DESCRIPTOR *pDesc) {
+    if (Length == 0) {
+        pInformation->Ctrl_Info.Usb_wLength = pDesc->Descriptor_Size - pInformation->Ctrl_Info.Usb_wOffset;
+        return NULL;
+    }
+    return pDesc->Descriptor + pInformation->Ctrl_Info.Usb_wOffset;
+}
+
+extern "C" void SetDeviceAddress(uint8 Val) {
+    for (uint8 ep = 0; ep < Device_Table.Total_Endpoint; ep++) {
+        mock_usb_set_epr(ep, USB_EP_EA, ep);
+    }
+    mockUsbRegs.DADDR = Val | 0x80;
+}
+
+// Initializes the device and enumerates it right away (bus reset, SET_ADDRESS and
+// SET_CONFIGURATION requests of the host)
+extern "C" void usb_init_usblib(usblib_dev *dev, void (**ep_int_in)(void), void (**ep_int_out)(void)) {
+    dev->ep_int_in = ep_int_in;
+    dev->ep_int_out = ep_int_out;
+
+    pInformation = &Device_Info;
+    pProperty = &Device_Property;
+    pUser_Standard_Requests = &User_Standard_Requests;
+    pInformation->ControlState = 2;
+    pProperty->Init();
+
+    pProperty->Reset();
+
+    pUser_Standard_Requests->User_SetDeviceAddress();
+    pInformation->Current_Configuration = 1;
+    pUser_Standard_Requests->User_SetConfiguration();
+}
+
+extern "C" void usb_power_off(void) {
+    USBLIB->state = USB_UNCONNECTED;
+}
+
+// --------------------------------------------------------------------------------------
+// INTERRUPTS
+// --------------------------------------------------------------------------------------
+
+// USB low priority interrupt: correct transfer on an endpoint
+static void mock_usb_isr(void) {
+    mock_usb_sync();
+    for (uint8 ep = 1; ep < MOCK_USB_ENDPOINTS; ep++) {
+        if (mockUsbEpr[ep] & USB_EP_CTR_RX) {
+            mock_usb_set_epr(ep, USB_EP_CTR_RX, 0);
+            usblib.ep_int_out[ep - 1]();
+            mock_usb_sync();
+        }
+        if (mockUsbEpr[ep] & USB_EP_CTR_TX) {
+            mock_usb_set_epr(ep, USB_EP_CTR_TX, 0);
+            usblib.ep_int_in[ep - 1]();
+            mock_usb_sync();
+        }
+    }
+}
+
+// Call with the lock held
+static void mock_usb_irq(void) {
+    if (mockUsbIrqMasked || mockGlobalIrqMasked) {
+        mockUsbIrqPending = true;
+        return;
+    }
+    mockUsbIrqPending = false;
+    mock_usb_isr();
+}
+
+bool mock_irq_enabled(void) {
+    return !mockGlobalIrqMasked;
+}
+
+extern "C" void nvic_irq_disable(nvic_irq_num irq_num) {
+    if (irq_num != NVIC_USB_LP_CAN_RX0) return;
+
+    mockIrqLock.lock();
+    if (mockUsbIrqMasked) {
+        mockIrqLock.unlock();
+        return;
+    }
+    mockUsbIrqMasked = true;
+}
+
+extern "C" void nvic_irq_enable(nvic_irq_num irq_num) {
+    if (irq_num != NVIC_USB_LP_CAN_RX0 || !mockUsbIrqMasked) return;
+
+    mockUsbIrqMasked = false;
+    if (mockUsbIrqPending) mock_usb_irq();
+    mockIrqLock.unlock();
+}
+
+extern "C" void nvic_globalirq_disable(void) {
+    mockIrqLock.lock();
+    if (mockGlobalIrqMasked) {
+        mockIrqLock.unlock();
+        return;
+    }
+    mockGlobalIrqMasked = true;
+}
+
+extern "C" void nvic_globalirq_enable(void) {
+    if (!mockGlobalIrqMasked) return;
+
+    mockGlobalIrqMasked = false;
+    if (mockUsbIrqPending) mock_usb_irq();
+    mock_serial_irqs();
+    mockIrqLock.unlock();
+}
+
+// --------------------------------------------------------------------------------------
+// HOST SIDE
+// --------------------------------------------------------------------------------------
+
+static void mock_usb_copy_to_pma(uint16 addr, const uint32_t *packets, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        mock_usb_pma_write(addr + i * 4, (uint16_t)packets[i]);
+        mock_usb_pma_write(addr + i * 4 + 2, (uint16_t)(packets[i] >> 16));
+    }
+}
+
+int mock_usb_host_out(const uint32_t *packets, uint32_t count) {
+    std::lock_guard<std::recursive_mutex> lock(mockIrqLock);
+    MockUsbBtable *bt = &mockUsbBtable[MOCK_USB_OUT_EP];
+
+    mock_usb_sync();
+    uint32 epr = mockUsbEpr[MOCK_USB_OUT_EP];
+
+    if ((epr & USB_EP_STAT_RX) != USB_EP_STAT_RX_VALID) {
+        mockUsbStats.outNaks++;
+        return 0;
+    }
+
+    if (epr & USB_EP_EP_KIND_DBL_BUF) {
+        // Both buffers are in use when DTOG_RX equals SW_BUF (DTOG_TX)
+        bool dtog = (epr & USB_EP_DTOG_RX) != 0;
+        if (dtog == ((epr & USB_EP_DTOG_TX) != 0)) {
+            mockUsbStats.outNaks++;
+            return 0;
+        }
+
+        if (!dtog) {
+            if (count * 4 > bt->txSize) abort();
+            mock_usb_copy_to_pma(bt->txAddr, packets, count);
+            bt->txCount = count * 4;
+        } else {
+            if (count * 4 > bt->rxSize) abort();
+            mock_usb_copy_to_pma(bt->rxAddr, packets, count);
+            bt->rxCount = count * 4;
+        }
+        mock_usb_set_epr(MOCK_USB_OUT_EP, USB_EP_DTOG_RX | USB_EP_CTR_RX, (epr ^ USB_EP_DTOG_RX) | USB_EP_CTR_RX);
+    } else {
+        if (count * 4 > bt->rxSize) abort();
+        mock_usb_copy_to_pma(bt->rxAddr, packets, count);
+        bt->rxCount = count * 4;
+        mock_usb_set_epr(MOCK_USB_OUT_EP, USB_EP_STAT_RX | USB_EP_CTR_RX, USB_EP_STAT_RX_NAK | USB_EP_CTR_RX);
+    }
+
+    mockUsbStats.outTransactions++;
+    mock_usb_irq();
+    return 1;
+}
+
+int mock_usb_host_in(uint32_t *packets, uint32_t max) {
+    std::lock_guard<std::recursive_mutex> lock(mockIrqLock);
+    MockUsbBtable *bt = &mockUsbBtable[MOCK_USB_IN_EP];
+
+    mock_usb_sync();
+    if ((mockUsbEpr[MOCK_USB_IN_EP] & USB_EP_STAT_TX) != USB_EP_STAT_TX_VALID) {
+        mockUsbStats.inNaks++;
+        return -1;
+    }
+
+    uint32_t count = bt->txCount / 4;
+    if (count > max) abort();
+    for (uint32_t i = 0; i < count; i++) {
+        packets[i] = mock_usb_pma_read(bt->txAddr + i * 4) | ((uint32_t)mock_usb_pma_read(bt->txAddr + i * 4 + 2) << 16);
+    }
+    mock_usb_set_epr(MOCK_USB_IN_EP, USB_EP_STAT_TX | USB_EP_CTR_TX, USB_EP_STAT_TX_NAK | USB_EP_CTR_TX);
+
+    mockUsbStats.inTransactions++;
+    mock_usb_irq();
+    return (int)count;
+}
+
+const mock_usb_stats *mock_usb_get_stats(void) {
+    return &mockUsbStats;
+}
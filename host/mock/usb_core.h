@@ -0,0 +1,107 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK USB LIBRARY
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _USB_CORE_H_
+#define _USB_CORE_H_
+#pragma once
+
+#include "usb_type.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct OneDescriptor {
+    uint8 *Descriptor;
+    uint16 Descriptor_Size;
+} ONE_DESCRIPTOR, *PONE_DESCRIPTOR;
+
+typedef struct _ENDPOINT_INFO {
+    uint16 Usb_wLength;
+    uint16 Usb_wOffset;
+    uint16 PacketSize;
+    uint8 *(*CopyData)(uint16 Length);
+} ENDPOINT_INFO;
+
+typedef struct _DEVICE {
+    uint8 Total_Endpoint;
+    uint8 Total_Configuration;
+} DEVICE;
+
+typedef struct _DEVICE_INFO {
+    uint8 USBbmRequestType;
+    uint8 USBbRequest;
+    uint8 USBwValue0;
+    uint8 USBwValue1;
+    uint16 USBwIndex;
+    uint16 USBwLength;
+    uint8 ControlState;
+    uint8 Current_Feature;
+    uint8 Current_Configuration;
+    uint8 Current_Interface;
+    uint8 Current_AlternateSetting;
+    ENDPOINT_INFO Ctrl_Info;
+} DEVICE_INFO;
+
+typedef struct _DEVICE_PROP {
+    void (*Init)(void);
+    void (*Reset)(void);
+    void (*Process_Status_IN)(void);
+    void (*Process_Status_OUT)(void);
+    RESULT (*Class_Data_Setup)(uint8 RequestNo);
+    RESULT (*Class_NoData_Setup)(uint8 RequestNo);
+    RESULT (*Class_Get_Interface_Setting)(uint8 Interface, uint8 AlternateSetting);
+    uint8 *(*GetDeviceDescriptor)(uint16 Length);
+    uint8 *(*GetConfigDescriptor)(uint16 Length);
+    uint8 *(*GetStringDescriptor)(uint16 Length);
+    void *RxEP_buffer;
+    uint8 MaxPacketSize;
+} DEVICE_PROP;
+
+typedef struct _USER_STANDARD_REQUESTS {
+    void (*User_GetConfiguration)(void);
+    void (*User_SetConfiguration)(void);
+    void (*User_GetInterface)(void);
+    void (*User_SetInterface)(void);
+    void (*User_GetStatus)(void);
+    void (*User_ClearFeature)(void);
+    void (*User_SetEndPointFeature)(void);
+    void (*User_SetDeviceFeature)(void);
+    void (*User_SetDeviceAddress)(void);
+} USER_STANDARD_REQUESTS;
+
+uint8 *Standard_GetDescriptorData(uint16 Length, ONE_DESCRIPTOR *pDesc);
+void SetDeviceAddress(uint8 Val);
+void NOP_Process(void);
+
+extern DEVICE_PROP Device_Property;
+extern USER_STANDARD_REQUESTS User_Standard_Requests;
+extern DEVICE Device_Table;
+extern DEVICE_INFO Device_Info;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK USB LIBRARY
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _USB_REG_MAP_H_
+#define _USB_REG_MAP_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// USB peripheral registers. Writes to the endpoint registers keep the hardware semantics
+// (write 0 to clear CTR bits, write 1 to toggle DTOG and STAT bits): a register written by
+// the firmware is applied by mock_usb_regs() on the next access to USB_BASE, see mock_usb.cpp.
+
+typedef struct usb_reg_map {
+    __io uint32 EP[8];
+    uint32 RESERVED[8];
+    __io uint32 CNTR;
+    __io uint32 ISTR;
+    __io uint32 FNR;
+    __io uint32 DADDR;
+    __io uint32 BTABLE;
+} usb_reg_map;
+
+usb_reg_map *mock_usb_regs(void);
+
+#define USB_BASE (mock_usb_regs())
+
+// Endpoint registers
+#define USB_EP_CTR_RX            (1U << 15)
+#define USB_EP_DTOG_RX           (1U << 14)
+#define USB_EP_STAT_RX           (3U << 12)
+#define USB_EP_SETUP             (1U << 11)
+#define USB_EP_EP_TYPE           (3U << 9)
+#define USB_EP_EP_KIND           (1U << 8)
+#define USB_EP_CTR_TX            (1U << 7)
+#define USB_EP_DTOG_TX           (1U << 6)
+#define USB_EP_STAT_TX           (3U << 4)
+#define USB_EP_EA                0xFU
+
+#define USB_EP_STAT_RX_DISABLED  (0U << 12)
+#define USB_EP_STAT_RX_STALL     (1U << 12)
+#define USB_EP_STAT_RX_NAK       (2U << 12)
+#define USB_EP_STAT_RX_VALID     (3U << 12)
+
+#define USB_EP_STAT_TX_DISABLED  (0U << 4)
+#define USB_EP_STAT_TX_STALL     (1U << 4)
+#define USB_EP_STAT_TX_NAK       (2U << 4)
+#define USB_EP_STAT_TX_VALID     (3U << 4)
+
+#define USB_EP_EP_TYPE_BULK      (0U << 9)
+#define USB_EP_EP_TYPE_CONTROL   (1U << 9)
+#define USB_EP_EP_TYPE_ISO       (2U << 9)
+#define USB_EP_EP_TYPE_INTERRUPT (3U << 9)
+
+#define USB_EP_EP_KIND_DBL_BUF   (1U << 8)
+
+// Control register
+#define USB_CNTR_CTRM            (1U << 15)
+#define USB_CNTR_PMAOVRM         (1U << 14)
+#define USB_CNTR_ERRM            (1U << 13)
+#define USB_CNTR_WKUPM           (1U << 12)
+#define USB_CNTR_SUSPM           (1U << 11)
+#define USB_CNTR_RESETM          (1U << 10)
+#define USB_CNTR_SOFM            (1U << 9)
+#define USB_CNTR_ESOFM           (1U << 8)
+#define USB_CNTR_FRES            (1U << 0)
+
+#define USB_ISR_MSK              (USB_CNTR_CTRM | USB_CNTR_WKUPM | USB_CNTR_SUSPM | \
+                                  USB_CNTR_RESETM | USB_CNTR_SOFM | USB_CNTR_ESOFM)
+
+// Endpoint configuration (the buffer table is modeled outside of the PMA)
+void   usb_set_ep_type(uint8 ep, uint32 type);
+void   usb_set_ep_kind(uint8 ep, uint32 kind);
+void   usb_set_ep_rx_stat(uint8 ep, uint32 status);
+void   usb_set_ep_tx_stat(uint8 ep, uint32 status);
+void   usb_clear_status_out(uint8 ep);
+void   usb_set_ep_rx_addr(uint8 ep, uint16 addr);
+void   usb_set_ep_tx_addr(uint8 ep, uint16 addr);
+void   usb_set_ep_rx_count(uint8 ep, uint16 count);
+void   usb_set_ep_tx_count(uint8 ep, uint16 count);
+uint16 usb_get_ep_rx_count(uint8 ep);
+uint16 usb_get_ep_tx_count(uint8 ep);
+void   usb_set_ep_rx_buf0_addr(uint8 ep, uint16 addr);
+void   usb_set_ep_rx_buf1_addr(uint8 ep, uint16 addr);
+void   usb_set_ep_rx_buf0_count(uint8 ep, uint16 count);
+void   usb_set_ep_rx_buf1_count(uint8 ep, uint16 count);
+uint16 usb_get_ep_rx_buf0_count(uint8 ep);
+uint16 usb_get_ep_rx_buf1_count(uint8 ep);
+
+// Packet memory: each 16-bit halfword occupies a 32-bit word of the CPU address space
+uint32 *usb_pma_ptr(uint32 offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,38 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK USB LIBRARY
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _USB_TYPE_H_
+#define _USB_TYPE_H_
+#pragma once
+
+#include <libmaple/libmaple_types.h>
+
+typedef enum _RESULT {
+    USB_SUCCESS = 0,
+    USB_ERROR,
+    USB_UNSUPPORT,
+    USB_NOT_READY
+} RESULT;
+
+#endif
@@ -0,0 +1,112 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - MOCK WIRISH
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _WIRISH_H_
+#define _WIRISH_H_
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <libmaple/libmaple_types.h>
+#include <libmaple/gpio.h>
+#include <libmaple/nvic.h>
+#include <libmaple/delay.h>
+#include <libmaple/usart.h>
+
+#include "mock.h"
+#include "Print.h"
+#include "boards.h"
+
+#define CYCLES_PER_MICROSECOND 72
+
+#define LOW  0x0
+#define HIGH 0x1
+
+typedef enum WiringPinMode {
+    OUTPUT,
+    OUTPUT_OPEN_DRAIN,
+    INPUT,
+    INPUT_PULLUP,
+    INPUT_PULLDOWN
+} WiringPinMode;
+
+uint32 millis(void);
+uint32 micros(void);
+void delay(uint32 ms);
+void delayMicroseconds(uint32 us);
+
+void pinMode(uint8 pin, WiringPinMode mode);
+void digitalWrite(uint8 pin, uint8 val);
+uint32 digitalRead(uint8 pin);
+
+static inline void noInterrupts(void) {
+    nvic_globalirq_disable();
+}
+
+static inline void interrupts(void) {
+    nvic_globalirq_enable();
+}
+
+// Interrupt-driven USART: written bytes go through the transmit ring buffer of the
+// usart_dev (64 bytes), the mock moves them to the line at the configured speed
+class HardwareSerial : public Print {
+public:
+    HardwareSerial(usart_dev *usart_device);
+
+    void begin(uint32 baud);
+    void end(void);
+
+    int available(void);
+    int peek(void);
+    int read(void);
+    int availableForWrite(void);
+    void flush(void);
+
+    size_t write(uint8 ch);
+    size_t write(const uint8 *buffer, size_t size);
+    using Print::write;
+
+    usart_dev *c_dev(void) { return this->usart_device; }
+
+private:
+    usart_dev *usart_device;
+};
+
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+extern HardwareSerial Serial4;
+
+// USB serial of the Arduino core (unused, the USB peripheral is taken by USB MIDI)
+class USBSerial {
+public:
+    void begin(void) {}
+    void end(void) {}
+};
+
+extern USBSerial Serial;
+
+#endif
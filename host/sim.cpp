@@ -0,0 +1,320 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SIMULATOR
+  ----------------------------------------------------------------------
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <algorithm>
+#include <deque>
+
+#include "sim.h"
+#include "usb_midi_device.h"
+
+// The sketch
+void setup(void);
+void loop(void);
+
+// Time of OUT transaction with the packets (full speed bulk transaction with its overhead)
+#define SIM_OUT_BASE_NS     8000
+#define SIM_OUT_PACKET_NS   2670
+
+Sim::Sim(const SimOptions &options) : options(options) {
+    loops = 0;
+    outTransactions = 0;
+    outNaks = 0;
+    nakNs = 0;
+    outNext = 0;
+    outScheduledNs = UINT64_MAX;
+    nakStartNs = UINT64_MAX;
+}
+
+Sim::~Sim() {
+    mock_serial_set_tx_callback(NULL, NULL);
+}
+
+void Sim::begin(void) {
+    mock_reset();
+    mock_serial_set_tx_callback(serialTx, this);
+    setup();
+
+    outScheduledNs = UINT64_MAX;
+    if (options.inPollNs) mock_schedule(mock_now_ns() + options.inPollNs, inEvent, this);
+    if (outNext < sent.size()) scheduleOut(sent[outNext].dueNs);
+}
+
+// --------------------------------------------------------------------------------------
+// HOST
+// --------------------------------------------------------------------------------------
+
+void Sim::send(const MidiMessage &message) {
+    std::vector<uint32_t> packets;
+    midi_to_packets(message, packets);
+
+    for (uint32_t packet : packets) sendPacket(message.timeNs, packet);
+    sentMessages.push_back(message);
+}
+
+void Sim::send(const std::vector<MidiMessage> &messages) {
+    for (const MidiMessage &m : messages) send(m);
+}
+
+void Sim::sendPacket(uint64_t timeNs, uint32_t packet) {
+    if (!sent.empty() && timeNs < sent.back().dueNs) {
+        fprintf(stderr, "sim: packets must be sent in the order of time\n");
+        abort();
+    }
+
+    sent.push_back(SimPacket{timeNs, 0, packet});
+    if (outNext == sent.size() - 1) scheduleOut(timeNs);
+}
+
+void Sim::scheduleOut(uint64_t timeNs) {
+    if (timeNs < mock_now_ns()) timeNs = mock_now_ns();
+
+    // One transaction at a time
+    if (outScheduledNs != UINT64_MAX) return;
+
+    outScheduledNs = timeNs;
+    mock_schedule(timeNs, outEvent, this);
+}
+
+void Sim::outEvent(void *ctx) {
+    Sim *sim = (Sim *)ctx;
+    uint64_t now = mock_now_ns();
+    uint32_t packets[16];
+    uint32_t count = 0;
+
+    sim->outScheduledNs = UINT64_MAX;
+
+    while (count < sim->options.transactionPackets && count < 16 &&
+           sim->outNext + count < sim->sent.size() && sim->sent[sim->outNext + count].dueNs <= now) {
+        packets[count] = sim->sent[sim->outNext + count].packet;
+        count++;
+    }
+    if (count == 0) return;
+
+    if (!mock_usb_host_out(packets, count)) {
+        sim->outNaks++;
+        if (sim->nakStartNs == UINT64_MAX) sim->nakStartNs = now;
+        sim->scheduleOut(now + sim->options.retryNs);
+        return;
+    }
+
+    sim->outTransactions++;
+    if (sim->nakStartNs != UINT64_MAX) {
+        sim->nakNs += now - sim->nakStartNs;
+        sim->nakStartNs = UINT64_MAX;
+    }
+
+    for (uint32_t i = 0; i < count; i++) sim->sent[sim->outNext++].ackNs = now;
+
+    if (sim->outNext < sim->sent.size()) {
+        uint64_t next = now + SIM_OUT_BASE_NS + count * SIM_OUT_PACKET_NS;
+        if (sim->sent[sim->outNext].dueNs > next) next = sim->sent[sim->outNext].dueNs;
+        sim->scheduleOut(next);
+    }
+}
+
+void Sim::inEvent(void *ctx) {
+    Sim *sim = (Sim *)ctx;
+    uint32_t packets[16];
+
+    int count = mock_usb_host_in(packets, 16);
+    for (int i = 0; i < count; i++) {
+        sim->inPackets.push_back(packets[i]);
+        sim->inTimes.push_back(mock_now_ns());
+    }
+
+    mock_schedule(mock_now_ns() + sim->options.inPollNs, inEvent, sim);
+}
+
+void Sim::serialTx(uint8_t port, uint8_t data, uint64_t timeNs, void *ctx) {
+    Sim *sim = (Sim *)ctx;
+    sim->serial[port].push_back(SimByte{timeNs, data});
+}
+
+// --------------------------------------------------------------------------------------
+// RUNNING
+// --------------------------------------------------------------------------------------
+
+bool Sim::usbIdle(void) const {
+    return usb_midi_data_available() == 0;
+}
+
+void Sim::runUntil(uint64_t timeNs) {
+    while (mock_now_ns() < timeNs) {
+        loop();
+        loops++;
+
+        uint64_t now = mock_now_ns();
+        uint64_t next = now + options.loopNs;
+
+        // Nothing to do until the next event (or until time based work is due)
+        if (usbIdle()) {
+            uint64_t event = mock_next_event_ns();
+            uint64_t limit = now + options.idleStepNs;
+            next = (event < limit) ? event : limit;
+            if (next < now + options.loopNs) next = now + options.loopNs;
+        }
+
+        mock_advance_to(next < timeNs ? next : timeNs);
+    }
+}
+
+bool Sim::runUntilIdle(uint64_t limitNs) {
+    // Time for the pending packets and collected IN packets to be flushed
+    const uint64_t settleNs = 5000000;
+    uint64_t idleSince = UINT64_MAX;
+
+    while (mock_now_ns() < limitNs) {
+        runUntil(mock_now_ns() + options.idleStepNs);
+
+        bool idle = (outNext == sent.size()) && usbIdle();
+        for (uint8_t s = 0; s < MOCK_SERIAL_PORTS && idle; s++) {
+            if (!mock_serial_tx_idle(s)) idle = false;
+        }
+
+        if (!idle) {
+            idleSince = UINT64_MAX;
+            continue;
+        }
+
+        if (idleSince == UINT64_MAX) idleSince = mock_now_ns();
+        if (mock_now_ns() - idleSince >= settleNs) {
+            // Bytes may still have been written in the last iteration
+            bool written = false;
+            for (uint8_t s = 0; s < MOCK_SERIAL_PORTS; s++) {
+                if (!serial[s].empty() && serial[s].back().timeNs > idleSince) written = true;
+            }
+            if (!written) return true;
+            idleSince = UINT64_MAX;
+        }
+    }
+
+    return false;
+}
+
+// --------------------------------------------------------------------------------------
+// RESULTS
+// --------------------------------------------------------------------------------------
+
+std::vector<WireMessage> Sim::wireMessages(uint8_t serialPort) const {
+    WireDecoder decoder(true);
+
+    for (const SimByte &b : serial[serialPort]) decoder.feed(b.data, b.timeNs);
+    return decoder.messages;
+}
+
+// Messages which are the same on the serial port
+static std::vector<uint8_t> sim_message_key(const std::vector<uint8_t> &bytes) {
+    if (midi_is_note_off(bytes)) return std::vector<uint8_t>{ (uint8_t)(0x80 | (bytes[0] & 0x0F)), bytes[1], 0 };
+    return bytes;
+}
+
+bool Sim::inOrder(uint8_t serialPort, uint16_t portMask) const {
+    WireDecoder decoder(true);
+    for (const SimByte &b : serial[serialPort]) decoder.feed(b.data, b.timeNs);
+    std::vector<WireMessage> &wire = decoder.messages;
+
+    // Without Port Selection messages, all messages come from the only port in the mask
+    if (decoder.portSelections == 0 && portMask != 0 && (portMask & (portMask - 1)) == 0) {
+        uint8_t only = 0;
+        while (!(portMask & (1 << only))) only++;
+        for (WireMessage &w : wire) w.port = only;
+    }
+
+    // Messages of each port, then RealTime messages of all ports
+    for (uint8_t port = 0; port <= 16; port++) {
+        if (port < 16 && !(portMask & (1 << port))) continue;
+
+        std::vector<const MidiMessage *> expected;
+        std::vector<const WireMessage *> received;
+        for (const MidiMessage &m : sentMessages) {
+            bool realTime = (m.bytes[0] >= 0xF8);
+            if (port == 16 ? (realTime && (portMask & (1 << m.port))) : (!realTime && m.port == port)) expected.push_back(&m);
+        }
+        for (const WireMessage &w : wire) {
+            bool realTime = (w.bytes[0] >= 0xF8);
+            if (port == 16 ? realTime : (!realTime && w.port == port)) received.push_back(&w);
+        }
+
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (i == received.size()) {
+                fprintf(stderr, "sim: serial port %u, port %u (16 = RealTime): %zu of %zu messages\n", serialPort, port, i, expected.size());
+                return false;
+            }
+            if (sim_message_key(received[i]->bytes) != sim_message_key(expected[i]->bytes)) {
+                fprintf(stderr, "sim: serial port %u, port %u (16 = RealTime): message %zu differs\n", serialPort, port, i);
+                return false;
+            }
+        }
+        if (received.size() != expected.size()) {
+            fprintf(stderr, "sim: serial port %u, port %u (16 = RealTime): %zu extra messages\n", serialPort, port, received.size() - expected.size());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::vector<SimLatency> Sim::latencies(uint8_t serialPort, uint16_t portMask) const {
+    std::vector<SimLatency> result;
+    std::map<std::vector<uint8_t>, std::deque<size_t>> expected;
+
+    for (size_t i = 0; i < sentMessages.size(); i++) {
+        if (portMask & (1 << sentMessages[i].port)) expected[sim_message_key(sentMessages[i].bytes)].push_back(i);
+    }
+
+    WireDecoder decoder(true);
+    for (const SimByte &b : serial[serialPort]) decoder.feed(b.data, b.timeNs);
+
+    // Ports are known when Port Selection messages are sent
+    bool portSelection = (decoder.portSelections != 0);
+
+    for (const WireMessage &w : decoder.messages) {
+        std::map<std::vector<uint8_t>, std::deque<size_t>>::iterator it = expected.find(sim_message_key(w.bytes));
+        if (it == expected.end()) continue;
+
+        std::deque<size_t> &candidates = it->second;
+        for (std::deque<size_t>::iterator c = candidates.begin(); c != candidates.end(); ++c) {
+            const MidiMessage &m = sentMessages[*c];
+            if (m.timeNs > w.timeNs) break;
+            if (portSelection && m.port != w.port) continue;
+
+            result.push_back(SimLatency{m.timeNs, w.timeNs, m.port, w.bytes});
+            candidates.erase(c);
+            break;
+        }
+    }
+
+    return result;
+}
+
+uint64_t sim_percentile(std::vector<uint64_t> values, double percentile) {
+    if (values.empty()) return 0;
+
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(percentile * (values.size() - 1) / 100 + 0.5);
+    return values[index < values.size() ? index : values.size() - 1];
+}
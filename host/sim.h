@@ -0,0 +1,137 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SIMULATOR
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_SIM_H_
+#define _HOST_SIM_H_
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "mock.h"
+#include "midi.h"
+
+// --------------------------------------------------------------------------------------
+// Simulator of the device connected to a USB host and to serial MIDI devices
+// --------------------------------------------------------------------------------------
+// The host sends the queued packets in OUT transactions (up to 16 packets each) as soon
+// as they are due, and retries NAKed transactions. It polls the IN endpoint. The bytes
+// transmitted on the serial ports are captured with their time.
+// The sketch (setup() and loop()) must be linked into the program, see sketch.h.
+
+struct SimOptions {
+    uint64_t loopNs = 4000;         // Duration of one iteration of loop()
+    uint64_t idleStepNs = 100000;   // Longest time step while there are no received USB packets
+    uint64_t retryNs = 10000;       // Delay before the host retries a NAKed OUT transaction
+    uint64_t inPollNs = 100000;     // Interval of IN transactions (0 = the host doesn't poll)
+    uint32_t transactionPackets = 16; // Maximum number of packets in one OUT transaction
+};
+
+// Byte transmitted on a serial port (time of its stop bit)
+struct SimByte {
+    uint64_t timeNs;
+    uint8_t data;
+};
+
+// Packet sent by the host
+struct SimPacket {
+    uint64_t dueNs;     // Time the host wanted to send it
+    uint64_t ackNs;     // Time it was acknowledged by the device
+    uint32_t packet;
+};
+
+// Latency of MIDI message from the host to the end of its transmission on a serial port
+struct SimLatency {
+    uint64_t dueNs;
+    uint64_t wireNs;
+    uint8_t port;       // USB MIDI port
+    std::vector<uint8_t> bytes;
+};
+
+class Sim {
+public:
+    Sim(const SimOptions &options = SimOptions());
+    ~Sim();
+
+    // Resets the mocked hardware and runs setup()
+    void begin(void);
+
+    // Queue message (or packet) to be sent by the host at its time
+    // (in the order of time, packets due at the same time are sent in the queued order)
+    void send(const MidiMessage &message);
+    void send(const std::vector<MidiMessage> &messages);
+    void sendPacket(uint64_t timeNs, uint32_t packet);
+
+    // Runs loop() until the time
+    void runUntil(uint64_t timeNs);
+
+    // Runs loop() until all queued packets were sent and the serial ports are idle
+    // Returns false when it doesn't happen until the time
+    bool runUntilIdle(uint64_t limitNs);
+
+    // Latencies of the messages transmitted on the serial port, matched to the sent
+    // messages by their bytes (Note Off as Note On with zero velocity is the same message).
+    // Only messages from the ports in the mask are expected on the serial port.
+    std::vector<SimLatency> latencies(uint8_t serialPort, uint16_t portMask = 0xFFFF) const;
+
+    // Messages decoded from the bytes transmitted on the serial port
+    std::vector<WireMessage> wireMessages(uint8_t serialPort) const;
+
+    // All messages of each port in the mask were transmitted on the serial port in the order
+    // they were sent (Note Off as Note On with zero velocity is the same message). System
+    // RealTime messages may overtake other messages (without Port Selection), they are only
+    // in order among themselves. A serial port without Port Selection messages receives only
+    // the port in the mask.
+    bool inOrder(uint8_t serialPort, uint16_t portMask = 0xFFFF) const;
+
+    SimOptions options;
+
+    std::vector<SimByte> serial[MOCK_SERIAL_PORTS];
+    std::vector<SimPacket> sent;            // Queued packets (ackNs is 0 until they are sent)
+    std::vector<MidiMessage> sentMessages;  // Queued messages
+    std::vector<uint32_t> inPackets;        // Packets received by the host
+    std::vector<uint64_t> inTimes;
+
+    uint64_t loops;
+    uint64_t outTransactions;
+    uint64_t outNaks;
+    uint64_t nakNs;         // Time the host spent retrying NAKed transactions
+
+private:
+    static void outEvent(void *ctx);
+    static void inEvent(void *ctx);
+    static void serialTx(uint8_t port, uint8_t data, uint64_t timeNs, void *ctx);
+
+    void scheduleOut(uint64_t timeNs);
+    bool usbIdle(void) const;
+
+    size_t outNext;         // Index in sent of the next packet to send
+    uint64_t outScheduledNs;
+    uint64_t nakStartNs;
+};
+
+// Percentile (0-100) of the values (0 when there are no values)
+uint64_t sim_percentile(std::vector<uint64_t> values, double percentile);
+
+#endif
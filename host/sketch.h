@@ -0,0 +1,38 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SKETCH
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_SKETCH_H_
+#define _HOST_SKETCH_H_
+#pragma once
+
+// --------------------------------------------------------------------------------------
+// The sketch compiled into a test, so that the test can reach its static functions
+// and variables (EncodePacket(), the serial state, ...)
+// --------------------------------------------------------------------------------------
+
+#include <wirish.h>
+
+#include "../USBMidiWaveblaster.ino"
+
+#endif
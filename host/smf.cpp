@@ -0,0 +1,293 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - STANDARD MIDI FILES
+  ----------------------------------------------------------------------
+
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "smf.h"
+
+#define SMF_WRITE_DIVISION 960
+#define SMF_WRITE_TEMPO    500000
+
+// --------------------------------------------------------------------------------------
+// READ
+// --------------------------------------------------------------------------------------
+
+struct SmfEvent {
+    uint64_t tick;
+    uint32_t order;             // Position in the file (keeps the order of simultaneous events)
+    uint32_t tempo;             // Tempo change (microseconds per quarter note), 0 for messages
+    uint8_t port;
+    std::vector<uint8_t> bytes;
+};
+
+class SmfReader {
+public:
+    SmfReader(const std::vector<uint8_t> &data) : data(data), pos(0), ok(true) {}
+
+    bool more(void) const { return ok && pos < data.size(); }
+    size_t position(void) const { return pos; }
+
+    uint8_t byte(void) {
+        if (pos >= data.size()) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint32_t be(int len) {
+        uint32_t value = 0;
+        while (len--) value = (value << 8) | byte();
+        return value;
+    }
+
+    uint32_t varlen(void) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            uint8_t b = byte();
+            value = (value << 7) | (b & 0x7F);
+            if (!(b & 0x80)) return value;
+        }
+        ok = false;
+        return value;
+    }
+
+    void skip(size_t len) {
+        if (len > data.size() - pos) {
+            ok = false;
+            pos = data.size();
+            return;
+        }
+        pos += len;
+    }
+
+    const std::vector<uint8_t> &data;
+    size_t pos;
+    bool ok;
+};
+
+static bool smf_read_track(SmfReader &r, size_t end, uint32_t &order, std::vector<SmfEvent> &events) {
+    uint64_t tick = 0;
+    uint8_t runningStatus = 0;
+    uint8_t port = 0;
+
+    while (r.ok && r.position() < end) {
+        tick += r.varlen();
+        uint8_t status = r.byte();
+
+        if (status == 0xFF) {
+            uint8_t type = r.byte();
+            uint32_t len = r.varlen();
+            size_t start = r.position();
+
+            if (type == 0x51 && len == 3) {
+                SmfEvent ev = { tick, order++, r.be(3), port, std::vector<uint8_t>() };
+                events.push_back(ev);
+            } else if (type == 0x21 && len == 1) {
+                port = r.byte();
+            } else if (type == 0x2F) {
+                r.skip(len);
+                return r.ok;
+            }
+            r.pos = start;
+            r.skip(len);
+            continue;
+        }
+
+        if (status == 0xF0 || status == 0xF7) {
+            uint32_t len = r.varlen();
+            SmfEvent ev = { tick, order++, 0, port, std::vector<uint8_t>() };
+            if (status == 0xF0) ev.bytes.push_back(0xF0);
+            for (uint32_t i = 0; i < len; i++) ev.bytes.push_back(r.byte());
+            // Escaped bytes (F7 events) are sent as they are
+            if (!ev.bytes.empty()) events.push_back(ev);
+            runningStatus = 0;
+            continue;
+        }
+
+        SmfEvent ev = { tick, order++, 0, port, std::vector<uint8_t>() };
+        if (status & 0x80) {
+            runningStatus = status;
+            ev.bytes.push_back(status);
+        } else {
+            if (runningStatus == 0) return false;
+            ev.bytes.push_back(runningStatus);
+            ev.bytes.push_back(status);
+        }
+
+        int len = midi_data_len(runningStatus);
+        while ((int)ev.bytes.size() < len + 1) ev.bytes.push_back(r.byte());
+        if (runningStatus >= 0xF0) runningStatus = 0;
+        events.push_back(ev);
+    }
+
+    return r.ok;
+}
+
+bool smf_read(const char *path, std::vector<MidiMessage> &messages, std::string &error) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        error = std::string("can't open ") + path;
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+
+    SmfReader r(data);
+    if (r.be(4) != 0x4D546864 || r.be(4) < 6) {
+        error = "not a Standard MIDI File";
+        return false;
+    }
+    r.be(2);
+    uint32_t tracks = r.be(2);
+    uint32_t division = r.be(2);
+    if (division & 0x8000 || division == 0) {
+        error = "SMPTE time division isn't supported";
+        return false;
+    }
+    r.pos = 8 + 6;
+
+    std::vector<SmfEvent> events;
+    uint32_t order = 0;
+    for (uint32_t t = 0; t < tracks && r.more(); ) {
+        uint32_t id = r.be(4);
+        uint32_t len = r.be(4);
+        size_t end = r.position() + len;
+        if (end > data.size()) {
+            error = "truncated track";
+            return false;
+        }
+        if (id == 0x4D54726B) {
+            if (!smf_read_track(r, end, order, events)) {
+                error = "invalid track";
+                return false;
+            }
+            t++;
+        }
+        r.pos = end;
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const SmfEvent &a, const SmfEvent &b) {
+        return a.tick < b.tick;
+    });
+
+    // Convert ticks to time with the tempo map
+    uint64_t tempo = 500000;
+    uint64_t lastTick = 0;
+    uint64_t timeNs = 0;
+    for (const SmfEvent &ev : events) {
+        timeNs += (ev.tick - lastTick) * tempo * 1000 / division;
+        lastTick = ev.tick;
+        if (ev.tempo) {
+            tempo = ev.tempo;
+            continue;
+        }
+        messages.push_back(MidiMessage{timeNs, ev.port, ev.bytes});
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------------------
+// WRITE
+// --------------------------------------------------------------------------------------
+
+static void smf_put_be(std::vector<uint8_t> &out, uint32_t value, int len) {
+    while (len--) out.push_back((uint8_t)(value >> (len * 8)));
+}
+
+static void smf_put_varlen(std::vector<uint8_t> &out, uint32_t value) {
+    uint8_t buf[5];
+    int n = 0;
+    buf[n++] = value & 0x7F;
+    while (value >>= 7) buf[n++] = 0x80 | (value & 0x7F);
+    while (n--) out.push_back(buf[n]);
+}
+
+bool smf_write(const char *path, const std::vector<MidiMessage> &messages, std::string &error) {
+    const uint64_t tickNs = (uint64_t)SMF_WRITE_TEMPO * 1000 / SMF_WRITE_DIVISION;
+    uint8_t ports = 0;
+    for (const MidiMessage &m : messages) ports = std::max<uint8_t>(ports, m.port + 1);
+
+    std::vector<uint8_t> out;
+    smf_put_be(out, 0x4D546864, 4);
+    smf_put_be(out, 6, 4);
+    smf_put_be(out, 1, 2);
+    smf_put_be(out, ports + 1, 2);
+    smf_put_be(out, SMF_WRITE_DIVISION, 2);
+
+    // Tempo track
+    std::vector<uint8_t> track = { 0x00, 0xFF, 0x51, 0x03 };
+    smf_put_be(track, SMF_WRITE_TEMPO, 3);
+    track.insert(track.end(), { 0x00, 0xFF, 0x2F, 0x00 });
+    smf_put_be(out, 0x4D54726B, 4);
+    smf_put_be(out, track.size(), 4);
+    out.insert(out.end(), track.begin(), track.end());
+
+    for (uint8_t port = 0; port < ports; port++) {
+        track = { 0x00, 0xFF, 0x21, 0x01, port };
+        uint64_t lastTick = 0;
+        for (const MidiMessage &m : messages) {
+            if (m.port != port || m.bytes.empty()) continue;
+
+            uint64_t tick = (m.timeNs + tickNs / 2) / tickNs;
+            if (tick < lastTick) tick = lastTick;
+            smf_put_varlen(track, (uint32_t)(tick - lastTick));
+            lastTick = tick;
+
+            if (m.bytes[0] == 0xF0) {
+                track.push_back(0xF0);
+                smf_put_varlen(track, m.bytes.size() - 1);
+                track.insert(track.end(), m.bytes.begin() + 1, m.bytes.end());
+            } else if (m.bytes[0] >= 0xF1 && m.bytes[0] != 0xFF) {
+                // System Common and RealTime messages are escaped
+                track.push_back(0xF7);
+                smf_put_varlen(track, m.bytes.size());
+                track.insert(track.end(), m.bytes.begin(), m.bytes.end());
+            } else {
+                track.insert(track.end(), m.bytes.begin(), m.bytes.end());
+            }
+        }
+        track.insert(track.end(), { 0x00, 0xFF, 0x2F, 0x00 });
+
+        smf_put_be(out, 0x4D54726B, 4);
+        smf_put_be(out, track.size(), 4);
+        out.insert(out.end(), track.begin(), track.end());
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL || fwrite(out.data(), 1, out.size(), f) != out.size()) {
+        if (f) fclose(f);
+        error = std::string("can't write ") + path;
+        return false;
+    }
+    fclose(f);
+    return true;
+}
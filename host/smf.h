@@ -0,0 +1,46 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - STANDARD MIDI FILES
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_SMF_H_
+#define _HOST_SMF_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "midi.h"
+
+// --------------------------------------------------------------------------------------
+// Standard MIDI Files (format 0 and 1, metrical time)
+// --------------------------------------------------------------------------------------
+// The messages of all tracks are merged in time order. The USB MIDI port of a track is
+// set by its MIDI Port meta event (FF 21 01 pp), port 0 by default.
+
+bool smf_read(const char *path, std::vector<MidiMessage> &messages, std::string &error);
+
+// Writes a format 1 file with one track per USB MIDI port (at 120 BPM, 960 ticks per
+// quarter note, i.e. times are rounded to about 0.5 ms)
+bool smf_write(const char *path, const std::vector<MidiMessage> &messages, std::string &error);
+
+#endif
@@ -0,0 +1,67 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - TESTS
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// --------------------------------------------------------------------------------------
+// Checks and results of the tests
+// --------------------------------------------------------------------------------------
+// A test is a program returning non-zero when a check failed. Measured values are
+// printed as "key=value" lines, which the compare tool uses to compare two variants.
+
+static int testFailures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        testFailures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long check_a = (long long)(a), check_b = (long long)(b); \
+    if (check_a != check_b) { \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+        testFailures++; \
+    } \
+} while (0)
+
+static inline void test_report(const char *key, double value) {
+    printf("%s=%.10g\n", key, value);
+}
+
+static inline int test_result(void) {
+    if (testFailures) {
+        fprintf(stderr, "%d check(s) failed\n", testFailures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
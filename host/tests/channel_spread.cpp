@@ -0,0 +1,108 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - CHANNEL SPREAD BENCHMARK
+  ----------------------------------------------------------------------
+
+*/
+
+
+// A dense song with MIDI clock on one USB MIDI port, sent to four serial ports faster than
+// one serial port can transmit it: utilization and latency percentiles of each serial port.
+// With channel spread, the messages of each channel must be sent to only one serial port
+// in order, and System messages to every serial port. Without it, every serial port
+// receives all messages.
+
+#include <map>
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#define SPREAD_SECONDS 10
+
+// Messages of each channel (Note Off as Note On with zero velocity), System messages as channel 16
+template <typename Message>
+static std::map<int, std::vector<std::vector<uint8_t>>> spread_channels(const std::vector<Message> &messages) {
+    std::map<int, std::vector<std::vector<uint8_t>>> channels;
+
+    for (const Message &m : messages) {
+        std::vector<uint8_t> bytes = m.bytes;
+        if (midi_is_note_off(bytes)) bytes = { (uint8_t)(0x80 | (bytes[0] & 0x0F)), bytes[1], 0 };
+        channels[bytes[0] >= 0xF0 ? 16 : (bytes[0] & 0x0F)].push_back(bytes);
+    }
+
+    return channels;
+}
+
+int main() {
+    CorpusOptions options;
+    corpus_preset("dense", 1, SPREAD_SECONDS, options);
+    options.bpm *= 14;
+    options.clock = true;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+    uint64_t endNs = mock_now_ns();
+
+    std::map<int, std::vector<std::vector<uint8_t>>> expected = spread_channels(song);
+    uint64_t worstP99 = 0;
+
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        std::map<int, std::vector<std::vector<uint8_t>>> received = spread_channels(sim.wireMessages(s));
+
+#ifdef CHANNEL_SPREAD
+        // Each channel complete on the serial port or not at all, System messages everywhere
+        for (const auto &channel : received) CHECK(channel.second == expected[channel.first]);
+        CHECK(received.count(16) != 0);
+#else
+        CHECK(received == expected);
+#endif
+
+        std::vector<uint64_t> latencies;
+        for (const SimLatency &l : sim.latencies(s)) latencies.push_back(l.wireNs - l.dueNs);
+        uint64_t p99 = sim_percentile(latencies, 99);
+        if (p99 > worstP99) worstP99 = p99;
+
+        std::string prefix = "serial" + std::to_string(s);
+        test_report((prefix + "_channels").c_str(), received.size() - received.count(16));
+        test_report((prefix + "_utilization").c_str(), (double)mock_serial_get_stats(s)->busyNs / endNs);
+        test_report((prefix + "_latency_p50_us").c_str(), sim_percentile(latencies, 50) / 1e3);
+        test_report((prefix + "_latency_p99_us").c_str(), p99 / 1e3);
+    }
+
+#ifdef CHANNEL_SPREAD
+    // Every channel was sent to one of the serial ports
+    uint32_t channels = 0;
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        std::map<int, std::vector<std::vector<uint8_t>>> received = spread_channels(sim.wireMessages(s));
+        channels += received.size() - received.count(16);
+    }
+    CHECK_EQ(channels, expected.size() - expected.count(16));
+#endif
+
+    test_report("latency_p99_us", worstP99 / 1e3);
+    test_report("seconds", endNs / 1e9);
+    return test_result();
+}
@@ -0,0 +1,130 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - CLOCK JITTER TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// MIDI clock with dense chords: latency of the clock messages and the deviation of the
+// intervals between them on the wire from the intervals the host sent them at, with
+// System RealTime messages sent ahead of the queued bytes (after at most
+// CFG_SERIAL_REALTIME_EXPRESS bytes) and in order. At the "burst" tempo the chords
+// saturate the serial port for a while, at the "saturated" tempo all the time. Then the
+// clock also waits in the USB receive buffer behind the packets which don't fit.
+// With multiple USB MIDI ports, the clock of another port than the chords must reach
+// the devices of its own port (after its Port Selection message).
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#include <string>
+
+#define CLOCK_SERIAL 1
+
+static void play(const char *name, uint32_t bpm) {
+    CorpusOptions options;
+    corpus_preset("clock", 1, 10, options);
+    options.chordChannels = 7;
+    options.chordNotes = 8;
+    options.ccPerBeat = 4;
+    options.bpm = bpm;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+    CHECK(sim.inOrder(CLOCK_SERIAL));
+
+    std::vector<uint64_t> latency, jitter;
+    uint64_t lastDue = 0, lastWire = 0;
+    for (const SimLatency &l : sim.latencies(CLOCK_SERIAL)) {
+        if (l.bytes[0] != 0xF8) continue;
+
+        latency.push_back(l.wireNs - l.dueNs);
+        if (lastWire != 0) {
+            int64_t deviation = (int64_t)(l.wireNs - lastWire) - (int64_t)(l.dueNs - lastDue);
+            jitter.push_back(deviation < 0 ? -deviation : deviation);
+        }
+        lastDue = l.dueNs;
+        lastWire = l.wireNs;
+    }
+
+    uint64_t clocks = 0;
+    for (const MidiMessage &m : song) clocks += (m.bytes[0] == 0xF8);
+    CHECK_EQ(latency.size(), clocks);
+
+    const mock_serial_stats *stats = mock_serial_get_stats(CLOCK_SERIAL);
+    std::string suffix = std::string("_") + name;
+    test_report(("utilization" + suffix).c_str(), (double)stats->busyNs / mock_now_ns());
+    test_report(("interrupts_per_byte" + suffix).c_str(), (double)(stats->txInterrupts + stats->dmaInterrupts) / stats->txBytes);
+    test_report(("clock_latency_p50_us" + suffix).c_str(), sim_percentile(latency, 50) / 1e3);
+    test_report(("clock_latency_p99_us" + suffix).c_str(), sim_percentile(latency, 99) / 1e3);
+    test_report(("clock_latency_max_us" + suffix).c_str(), sim_percentile(latency, 100) / 1e3);
+    test_report(("clock_jitter_p50_us" + suffix).c_str(), sim_percentile(jitter, 50) / 1e3);
+    test_report(("clock_jitter_p99_us" + suffix).c_str(), sim_percentile(jitter, 99) / 1e3);
+    test_report(("clock_jitter_max_us" + suffix).c_str(), sim_percentile(jitter, 100) / 1e3);
+}
+
+#if USB_MIDI_IO_PORT_NUM >= 2
+static void playPorts(uint32_t bpm) {
+    CorpusOptions options;
+    corpus_preset("clock", 1, 10, options);
+    options.chordChannels = 7;
+    options.chordNotes = 8;
+    options.bpm = bpm;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    // Clock and chords of the same port, then clock of the second port
+    uint64_t clocks = 0;
+    for (MidiMessage &m : song) {
+        if (m.bytes[0] >= 0xF8) {
+            if (clocks++ % 2) m.port = 1;
+        }
+    }
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+    CHECK(sim.inOrder(CLOCK_SERIAL));
+
+    std::vector<uint8_t> expected, received;
+    for (const MidiMessage &m : song) {
+        if (m.bytes[0] >= 0xF8) expected.push_back(m.port);
+    }
+    for (const WireMessage &w : sim.wireMessages(CLOCK_SERIAL)) {
+        if (w.bytes[0] >= 0xF8) received.push_back(w.port);
+    }
+    CHECK_EQ(received.size(), expected.size());
+    CHECK(received == expected);
+}
+#endif
+
+int main() {
+    play("burst", 300);
+    play("saturated", 700);
+#if USB_MIDI_IO_PORT_NUM >= 2
+    playPorts(300);
+#endif
+    return test_result();
+}
@@ -0,0 +1,231 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - ENCODE PACKET TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// EncodePacket() driven by the action table compared with the encoder it replaced (copied
+// below): every CIN and first byte from every port, starting from various serial states,
+// then long random packet streams. The bytes, the serial state and the packet (Note Off
+// may be changed to Note On) must be the same. Host time per packet of both encoders is
+// reported.
+
+#include <string.h>
+#include <chrono>
+#include <random>
+
+#include "sketch.h"
+#include "test.h"
+
+#define ENCODE_RANDOM_PACKETS 1000000
+#define ENCODE_BENCH_ROUNDS 20
+
+// EncodePacket() before the action table
+static uint8_t ReferenceEncodePacket(midiPacket_t *pk, serialState_t *state, uint8_t *data)
+{
+    uint8_t port = pk->packet[0] >> 4;
+    uint8_t cin  = pk->packet[0] & 0x0F;
+
+#if USB_MIDI_IO_PORT_NUM < 16
+    if (port >= USB_MIDI_IO_PORT_NUM)
+    {
+        // Ignore packets from unused ports
+        return 0;
+    }
+#endif
+
+    uint8_t msgLen = USBMidi::CINToLenTable[cin];
+
+#if USB_MIDI_IO_PORT_NUM >= 2
+    switch ( cin )
+    {
+        case 0x02: // Two-byte System Common messages like MTC, SongSelect, etc.
+        case 0x03: // Three-byte System Common messages like SPP, etc.
+        case 0x05: // Single-byte System Common Message or SysEx ends with following single byte.
+        case 0x06: // SysEx ends with following two bytes.
+        case 0x07: // SysEx ends with following three bytes.
+            // Ignore Port Selection messages "F5 nn" or other non-standard "F5" messages (1-3 bytes)
+            if ( pk->packet[1] == 0xF5 ) msgLen = 0;
+            break;
+        case 0x0F: // Single Byte
+            // Only allow System RealTime messages
+            if ( pk->packet[1] < 0xF8 ) msgLen = 0;
+            break;
+        default:
+            break;
+    }
+#endif
+
+    if ( msgLen == 0 ) return 0;
+
+    // SysEx continues until the packet with its end (RealTime messages don't end it)
+    if ( cin == 0x04 || pk->packet[1] < 0xF8 ) state->sysEx = ( cin == 0x04 );
+
+    uint8_t len = 0;
+
+#if USB_MIDI_IO_PORT_NUM >= 2
+    // If last message came from different port, then send Port Selection message "F5 nn"
+    if ( state->selectPort && port != state->lastPort )
+    {
+        state->runningStatus = 0;
+        state->lastPort = port;
+        data[len++] = 0xF5;
+        data[len++] = port + 1;
+    }
+#endif
+
+    uint8_t first = 1;
+
+#if defined(CFG_SERIAL_RUNNING_STATUS) && CFG_SERIAL_RUNNING_STATUS > 0
+    // Implement Running Status when sending data to maximize available bandwidth
+    if (pk->packet[1] >= 0xF8)
+    {
+        // RealTime messages
+    }
+    else if (pk->packet[1] >= 0xF0)
+    {
+        // System Common messages
+        state->runningStatus = 0;
+    }
+    else if (pk->packet[1] >= 0x80)
+    {
+        if (pk->packet[1] <= 0x8F && msgLen >= 3 && pk->packet[1] != state->runningStatus)
+        {
+            // Send note off event as note on with zero velocity to increase the chance of using running status
+            pk->packet[1] |= 0x10;
+            pk->packet[3] = 0;
+        }
+
+        if (pk->packet[1] == state->runningStatus)
+        {
+            // Don't send Running Status byte
+            first = 2;
+        }
+        else
+        {
+            // Update Running Status
+            state->runningStatus = pk->packet[1];
+        }
+    }
+#endif
+
+    for ( uint8_t i = first; i <= msgLen; i++ )
+    {
+        data[len++] = pk->packet[i];
+    }
+
+    return len;
+}
+
+static uint32_t mismatches = 0;
+
+// Encode the packet with both encoders from the same state, the states are updated
+static void encode_compare(uint32_t packet, serialState_t *state, serialState_t *reference) {
+    midiPacket_t pk, rpk;
+    uint8_t data[5], rdata[5];
+    pk.i = rpk.i = packet;
+
+    uint8_t len = EncodePacket(&pk, state, data);
+    uint8_t rlen = ReferenceEncodePacket(&rpk, reference, rdata);
+
+    if (len != rlen || memcmp(data, rdata, len) != 0 || pk.i != rpk.i || memcmp(state, reference, sizeof(serialState_t)) != 0) {
+        if (mismatches++ < 10) fprintf(stderr, "packet %08X: %u bytes vs %u\n", packet, len, rlen);
+    }
+}
+
+int main() {
+    const uint8_t selectPort = (USB_MIDI_IO_PORT_NUM >= 2);
+    static const uint8_t runningStatuses[] = { 0, 0x80, 0x90, 0x93, 0xB0, 0xE0 };
+    static const uint32_t payloads[] = { 0x000000, 0x7F407F, 0x00003C, 0x7F8001, 0xFFFFFF };
+
+    // Every CIN and first byte from every port
+    for (uint32_t port = 0; port < 16; port++) {
+        for (uint32_t cin = 0; cin < 16; cin++) {
+            for (uint32_t status = 0; status < 256; status++) {
+                for (uint8_t runningStatus : runningStatuses) {
+                    for (uint32_t payload : payloads) {
+                        for (uint32_t flags = 0; flags < 4; flags++) {
+                            uint32_t packet = (port << 4) | cin | (status << 8) | ((payload & 0xFFFF) << 16);
+                            serialState_t state = { runningStatus, (uint8_t)((flags & 1) ? port : 0), (uint8_t)((flags >> 1) & 1), selectPort };
+                            serialState_t reference = state;
+                            encode_compare(packet, &state, &reference);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Random packets, mostly well formed channel messages
+    std::mt19937 rng(1);
+    std::vector<uint32_t> packets;
+    for (uint32_t i = 0; i < ENCODE_RANDOM_PACKETS; i++) {
+        uint32_t r = rng();
+        uint32_t port = (r >> 28) % (USB_MIDI_IO_PORT_NUM < 4 ? USB_MIDI_IO_PORT_NUM + 1 : USB_MIDI_IO_PORT_NUM);
+        if ((r & 0x300) == 0) {
+            packets.push_back((rng() & 0xFFFFFF0F) | (port << 4));
+        } else {
+            uint32_t status = 0x80 | (r & 0x3F) | ((r >> 6) & 0x10);
+            packets.push_back((port << 4) | (status >> 4) | (status << 8) | ((rng() & 0x7F7F) << 16));
+        }
+    }
+
+    {
+        serialState_t state = { 0, 0, 0, selectPort };
+        serialState_t reference = state;
+        for (uint32_t packet : packets) encode_compare(packet, &state, &reference);
+    }
+
+    CHECK_EQ(mismatches, 0);
+
+    // Host time per packet
+    uint32_t total = 0;
+    serialState_t state = { 0, 0, 0, selectPort };
+    uint8_t data[5];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ENCODE_BENCH_ROUNDS; round++) {
+        for (uint32_t packet : packets) {
+            midiPacket_t pk;
+            pk.i = packet;
+            total += EncodePacket(&pk, &state, data);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ENCODE_BENCH_ROUNDS; round++) {
+        for (uint32_t packet : packets) {
+            midiPacket_t pk;
+            pk.i = packet;
+            total -= ReferenceEncodePacket(&pk, &state, data);
+        }
+    }
+    double referenceNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // Both encoded the same number of bytes (also keeps the loops from being optimized out)
+    CHECK_EQ(total, 0);
+
+    test_report("encode_ns_per_packet", ns / ((double)ENCODE_BENCH_ROUNDS * packets.size()));
+    test_report("reference_ns_per_packet", referenceNs / ((double)ENCODE_BENCH_ROUNDS * packets.size()));
+    return test_result();
+}
@@ -0,0 +1,204 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - LATENCY HISTOGRAM TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// Latency histograms with the cycle counter of the mock (which follows the virtual clock
+// and can be set by the test): message classes of packets, bucket boundaries, recording
+// and reset. A Note On sent alone must be counted in the bucket of its latency from USB
+// reception to its transmission, also when the cycle counter wraps around in between.
+// Every packet of a song must be counted in the histogram of its class, also while the
+// serial port is saturated (with latencies of hundreds of milliseconds), and the histograms are read with
+// the "F0 7D 57 01 F7" query.
+
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "diag.h"
+#include "sim.h"
+#include "test.h"
+
+#define HISTOGRAM_SERIAL 1
+#define HISTOGRAM_US (uint32_t)CYCLES_PER_MICROSECOND
+#define LATENCY_DUMP_CMD 0x01
+
+// Sum of the buckets of the histogram
+static uint32_t histogram_total(uint8_t histogram) {
+    uint32_t total = 0;
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) total += latency_count(histogram, b);
+    return total;
+}
+
+// Play the song, all of its packets must be counted in the histograms of their classes
+// and reported by the latency dump
+static void song_check(const std::vector<MidiMessage> &song, const std::string &prefix) {
+    uint32_t expected[LATENCY_HISTOGRAMS] = { 0 };
+    for (const MidiMessage &m : song) {
+        std::vector<uint32_t> packets;
+        midi_to_packets(m, packets);
+        for (uint32_t packet : packets) expected[latency_histogram(packet)]++;
+    }
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    latency_reset();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+
+    for (uint8_t h = 0; h < LATENCY_HISTOGRAMS; h++) CHECK_EQ(histogram_total(h), expected[h]);
+
+    // The reply of the latency dump has the buckets of each histogram
+    uint64_t endNs = mock_now_ns();
+    sim.send(diag_query(endNs, 0, LATENCY_DUMP_CMD));
+    sim.runUntil(endNs + 100000000);
+
+    std::vector<std::vector<uint8_t>> replies = diag_replies(sim.inPackets, LATENCY_DUMP_CMD);
+    CHECK_EQ(replies.size(), LATENCY_HISTOGRAMS);
+    for (size_t i = 0; i < replies.size() && i < LATENCY_HISTOGRAMS; i++) {
+        const std::vector<uint8_t> &reply = replies[i];
+        CHECK_EQ(reply.size(), 7 + 5 * LATENCY_BUCKETS);
+        if (reply.size() != 7 + 5 * LATENCY_BUCKETS) continue;
+
+        uint8_t h = reply[4] * LATENCY_CLASSES + reply[5];
+        CHECK_EQ(h, i);
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) CHECK_EQ(diag_value(reply, 6 + 5 * b), latency_count(h, b));
+    }
+
+    std::vector<uint64_t> notes;
+    for (const SimLatency &l : sim.latencies(HISTOGRAM_SERIAL)) {
+        if (midi_is_note_on(l.bytes) || midi_is_note_off(l.bytes)) notes.push_back(l.wireNs - l.dueNs);
+    }
+    test_report((prefix + "_note_latency_p50_us").c_str(), sim_percentile(notes, 50) / 1e3);
+    test_report((prefix + "_note_latency_max_us").c_str(), sim_percentile(notes, 100) / 1e3);
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+        test_report((prefix + "_note_bucket" + std::to_string(b)).c_str(), latency_count(LATENCY_CLASS_NOTE, b));
+    }
+}
+
+int main() {
+    // Classes
+    CHECK_EQ(latency_histogram(0x643C9009), LATENCY_CLASS_NOTE);
+    CHECK_EQ(latency_histogram(0x003C8008), LATENCY_CLASS_NOTE);
+    CHECK_EQ(latency_histogram(0x7F01B00B), LATENCY_CLASS_CHANNEL);
+    CHECK_EQ(latency_histogram(0x0010C50C), LATENCY_CLASS_CHANNEL);
+    CHECK_EQ(latency_histogram(0x40007E0E), LATENCY_CLASS_CHANNEL);
+    CHECK_EQ(latency_histogram(0x7F7EF004), LATENCY_CLASS_SYSEX);
+    CHECK_EQ(latency_histogram(0x0000F705), LATENCY_CLASS_SYSEX);
+    CHECK_EQ(latency_histogram(0x00F70106), LATENCY_CLASS_SYSEX);
+    CHECK_EQ(latency_histogram(0xF7020107), LATENCY_CLASS_SYSEX);
+    CHECK_EQ(latency_histogram(0x0000F605), LATENCY_CLASS_COMMON);
+    CHECK_EQ(latency_histogram(0x0020F102), LATENCY_CLASS_COMMON);
+    CHECK_EQ(latency_histogram(0x0201F203), LATENCY_CLASS_COMMON);
+    CHECK_EQ(latency_histogram(0x0000F80F), LATENCY_CLASS_REALTIME);
+    CHECK_EQ(latency_histogram(0x0000FC0F), LATENCY_CLASS_REALTIME);
+#if USB_MIDI_IO_PORT_NUM >= 2
+    CHECK_EQ(latency_histogram(0x643C9019), LATENCY_CLASSES + LATENCY_CLASS_NOTE);
+#endif
+
+    // Buckets
+    CHECK_EQ(latency_bucket(0), 0);
+    CHECK_EQ(latency_bucket(HISTOGRAM_US - 1), 0);
+    CHECK_EQ(latency_bucket(HISTOGRAM_US), 1);
+    CHECK_EQ(latency_bucket(2 * HISTOGRAM_US - 1), 1);
+    CHECK_EQ(latency_bucket(2 * HISTOGRAM_US), 2);
+    CHECK_EQ(latency_bucket(4 * HISTOGRAM_US - 1), 2);
+    CHECK_EQ(latency_bucket(4 * HISTOGRAM_US), 3);
+    CHECK_EQ(latency_bucket(1000 * HISTOGRAM_US), 10);
+    CHECK_EQ(latency_bucket((1 << (LATENCY_BUCKETS - 2)) * HISTOGRAM_US - 1), LATENCY_BUCKETS - 2);
+    CHECK_EQ(latency_bucket((1 << (LATENCY_BUCKETS - 2)) * HISTOGRAM_US), LATENCY_BUCKETS - 1);
+    CHECK_EQ(latency_bucket(0xFFFFFFFF), LATENCY_BUCKETS - 1);
+
+    // Recording and reset
+    latency_reset();
+    latency_record(LATENCY_CLASS_CHANNEL, 3 * HISTOGRAM_US);
+    latency_record(LATENCY_CLASS_CHANNEL, 3 * HISTOGRAM_US);
+    latency_record(LATENCY_CLASS_SYSEX, 0);
+    CHECK_EQ(latency_count(LATENCY_CLASS_CHANNEL, 2), 2);
+    CHECK_EQ(latency_count(LATENCY_CLASS_SYSEX, 0), 1);
+    CHECK_EQ(histogram_total(LATENCY_CLASS_NOTE), 0);
+    latency_reset();
+    CHECK_EQ(histogram_total(LATENCY_CLASS_CHANNEL), 0);
+    CHECK_EQ(histogram_total(LATENCY_CLASS_SYSEX), 0);
+
+    // Single Note On, the cycle counter wraps around 100 us after it's received
+    {
+        Sim sim;
+        sim.send(MidiMessage{10000000, 0, { 0x90, 0x3C, 0x64 }});
+        sim.begin();
+        sim.runUntil(10000000 - 1000000);
+        mock_dwt_cnt = (uint32_t)(0 - (1000 + 100) * HISTOGRAM_US);
+        latency_reset();
+        CHECK(sim.runUntilIdle(1000000000ULL));
+
+        std::vector<SimLatency> latencies = sim.latencies(HISTOGRAM_SERIAL);
+        CHECK_EQ(latencies.size(), 1);
+        CHECK(mock_dwt_cnt < 0x80000000);
+
+        // Recorded when DMA moved the last byte to the transmit data register, up to two bytes
+        // (the data register and the shift register) before its stop bit
+        uint64_t byteNs = 10 * 1000000000ULL / serialSpeed[HISTOGRAM_SERIAL];
+        uint64_t latestNs = latencies[0].wireNs - sim.sent[0].ackNs;
+        uint8_t earliest = latency_bucket((uint32_t)((latestNs - 2 * byteNs) / 1000 * HISTOGRAM_US));
+        uint8_t latest = latency_bucket((uint32_t)(latestNs / 1000 * HISTOGRAM_US));
+
+        uint32_t counted = 0;
+        for (uint8_t b = earliest; b <= latest; b++) counted += latency_count(LATENCY_CLASS_NOTE, b);
+        CHECK_EQ(counted, 1);
+        CHECK_EQ(histogram_total(LATENCY_CLASS_NOTE), 1);
+        CHECK_EQ(histogram_total(LATENCY_CLASS_REALTIME), 0);
+
+        test_report("note_latency_us", latestNs / 1e3);
+    }
+
+    // Song with MIDI clock and SysEx: packets counted in the histograms of their classes
+    {
+        CorpusOptions options;
+        corpus_preset("gm", USB_MIDI_IO_PORT_NUM, 2, options);
+        options.clock = true;
+        options.sysexBytes = 32;
+        options.sysexEveryBeats = 2;
+        std::vector<MidiMessage> song = corpus_song(options);
+        song_check(song, "song");
+    }
+
+    // Dense chords faster than the serial port can transmit them, the packets wait in the
+    // buffers for hundreds of milliseconds
+    {
+        CorpusOptions options;
+        corpus_preset("dense", USB_MIDI_IO_PORT_NUM, 4, options);
+        options.bpm *= 16;
+        options.clock = true;
+        options.sysexBytes = 32;
+        options.sysexEveryBeats = 2;
+        std::vector<MidiMessage> song = corpus_song(options);
+        song_check(song, "saturated");
+
+        // Told apart in the buckets from 65 ms (not all in the last bucket)
+        uint32_t saturated = 0;
+        for (uint8_t b = 17; b < LATENCY_BUCKETS - 1; b++) saturated += latency_count(LATENCY_CLASS_NOTE, b);
+        CHECK(saturated > 0);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,111 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - LOAD SHEDDING TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// A song with heavy controller automation sent faster than the serial port can transmit
+// it: note latency with and without merging the pending controller changes. Merged
+// values must never move across other messages of the channel, so when each Note On is
+// transmitted, the controllers of its channel have the values the host had sent before it.
+
+#include <map>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#define SHEDDING_SERIAL 1
+
+// Controller (or 0x100 + status for Pitch Bend and Channel Pressure) changed by a mergeable message
+static int mergeable_key(const std::vector<uint8_t> &bytes) {
+    switch (bytes[0] & 0xF0) {
+        case 0xB0:
+            switch (bytes[1]) {
+                case 1: case 2: case 4: case 7: case 8: case 10: case 11:
+                    return bytes[1];
+                default:
+                    return -1;
+            }
+        case 0xD0:
+        case 0xE0:
+            return 0x100 + (bytes[0] & 0xF0);
+        default:
+            return -1;
+    }
+}
+
+typedef std::map<int, std::vector<uint8_t>> ChannelValues;
+
+// Controller values of the channel at each Note On, in order
+template <typename Message>
+static std::vector<ChannelValues> values_at_notes(const std::vector<Message> &messages) {
+    std::map<int, ChannelValues> channels;
+    std::vector<ChannelValues> result;
+
+    for (const Message &m : messages) {
+        if (m.bytes[0] >= 0xF0) continue;
+        int channel = m.port * 16 + (m.bytes[0] & 0x0F);
+
+        int key = mergeable_key(m.bytes);
+        if (key >= 0) channels[channel][key] = m.bytes;
+        if (midi_is_note_on(m.bytes)) result.push_back(channels[channel]);
+    }
+
+    return result;
+}
+
+int main() {
+    CorpusOptions options;
+    corpus_preset("automation", 1, 10, options);
+    options.bpm *= 6;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+
+    std::vector<WireMessage> wire = sim.wireMessages(SHEDDING_SERIAL);
+    std::vector<ChannelValues> expected = values_at_notes(song);
+    std::vector<ChannelValues> received = values_at_notes(wire);
+    CHECK_EQ(received.size(), expected.size());
+    for (size_t i = 0; i < received.size() && i < expected.size(); i++) {
+        if (received[i] != expected[i]) {
+            fprintf(stderr, "shedding: controllers differ at Note On %zu\n", i);
+            testFailures++;
+            break;
+        }
+    }
+
+    std::vector<uint64_t> latency;
+    for (const SimLatency &l : sim.latencies(SHEDDING_SERIAL)) {
+        if (midi_is_note_on(l.bytes)) latency.push_back(l.wireNs - l.dueNs);
+    }
+    CHECK_EQ(latency.size(), expected.size());
+
+    test_report("note_latency_p50_us", sim_percentile(latency, 50) / 1e3);
+    test_report("note_latency_p99_us", sim_percentile(latency, 99) / 1e3);
+    test_report("note_latency_max_us", sim_percentile(latency, 100) / 1e3);
+    test_report("wire_messages", wire.size());
+    return test_result();
+}
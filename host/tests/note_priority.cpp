@@ -0,0 +1,90 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - NOTE PRIORITY BENCHMARK
+  ----------------------------------------------------------------------
+
+*/
+
+// A song with heavy controller automation on all melodic channels, sent slightly faster
+// than the serial port can transmit it (so most of the waiting is in the buffers of the
+// device, not in the host): percentiles of note latency (Note On and Note Off) with and
+// without sending pending notes ahead of the messages of other channels, also of the drum
+// notes alone (the drum channel has no automation, so its notes can overtake everything).
+// The order of the messages within each channel must be kept.
+
+#include <map>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#define PRIORITY_SERIAL 1
+#define DRUM_CHANNEL    9
+
+// Channel messages of each port and channel, in order
+template <typename Message>
+static std::map<int, std::vector<std::vector<uint8_t>>> channel_messages(const std::vector<Message> &messages) {
+    std::map<int, std::vector<std::vector<uint8_t>>> channels;
+
+    for (const Message &m : messages) {
+        if (m.bytes[0] >= 0xF0) continue;
+
+        std::vector<uint8_t> bytes = m.bytes;
+        if (midi_is_note_off(bytes)) bytes = { (uint8_t)(0x80 | (bytes[0] & 0x0F)), bytes[1], 0 };
+        channels[m.port * 16 + (m.bytes[0] & 0x0F)].push_back(bytes);
+    }
+
+    return channels;
+}
+
+int main() {
+    CorpusOptions options;
+    corpus_preset("automation", 1, 10, options);
+    options.bpm *= 5;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+
+    CHECK(channel_messages(sim.wireMessages(PRIORITY_SERIAL)) == channel_messages(song));
+
+    std::vector<uint64_t> notes, drums, others;
+    for (const SimLatency &l : sim.latencies(PRIORITY_SERIAL)) {
+        if (midi_is_note_on(l.bytes) || midi_is_note_off(l.bytes)) {
+            notes.push_back(l.wireNs - l.dueNs);
+            if ((l.bytes[0] & 0x0F) == DRUM_CHANNEL) drums.push_back(l.wireNs - l.dueNs);
+        } else {
+            others.push_back(l.wireNs - l.dueNs);
+        }
+    }
+
+    test_report("note_latency_p50_us", sim_percentile(notes, 50) / 1e3);
+    test_report("note_latency_p90_us", sim_percentile(notes, 90) / 1e3);
+    test_report("note_latency_p99_us", sim_percentile(notes, 99) / 1e3);
+    test_report("note_latency_max_us", sim_percentile(notes, 100) / 1e3);
+    test_report("drum_latency_p50_us", sim_percentile(drums, 50) / 1e3);
+    test_report("drum_latency_p99_us", sim_percentile(drums, 99) / 1e3);
+    test_report("other_latency_p50_us", sim_percentile(others, 50) / 1e3);
+    test_report("other_latency_p99_us", sim_percentile(others, 99) / 1e3);
+    return test_result();
+}
@@ -0,0 +1,69 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - PACKET OVERHEAD BENCHMARK
+  ----------------------------------------------------------------------
+
+*/
+
+// Overhead of loop() per received USB packet: the host sends full OUT transactions and
+// loop() runs until all packets are processed. The packets aren't routed to any serial
+// port, so only the work around the packets is measured: iterations of loop(), calls
+// of the Arduino functions (millis(), micros(), digitalWrite()) and the host CPU time.
+
+#include <chrono>
+
+#include "sketch.h"
+#include "test.h"
+
+#define OVERHEAD_ROUNDS 100000
+
+int main() {
+    mock_reset();
+    setup();
+
+    for (uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM; port++) serialRouting[port] = 0;
+
+    uint32_t packets[16];
+    for (uint32_t i = 0; i < 16; i++) packets[i] = 0x00403C99 + (i << 16); // Note On
+
+    mock_arduino_calls before = mockArduinoCalls;
+    uint64_t loops = 0;
+    uint64_t received = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < OVERHEAD_ROUNDS; round++) {
+        CHECK(mock_usb_host_out(packets, 16));
+        received += 16;
+
+        while (usb_midi_data_available()) {
+            loop();
+            loops++;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    test_report("loops_per_packet", (double)loops / received);
+    test_report("millis_per_packet", (double)(mockArduinoCalls.millis - before.millis) / received);
+    test_report("micros_per_packet", (double)(mockArduinoCalls.micros - before.micros) / received);
+    test_report("digital_write_per_packet", (double)(mockArduinoCalls.digitalWrite - before.digitalWrite) / received);
+    test_report("host_ns_per_packet", ns / received);
+
+    return test_result();
+}
@@ -0,0 +1,76 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - PACKET TRACE TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// A song is sent faster than the serial port can transmit it, so that packets stall and
+// are retried from the USB receive buffer. Each received packet must be traced once (as
+// a stalled packet, when it was retried), so the packets in the trace taken in the middle
+// of the song must be consecutive packets sent by the host, in order and without repeats.
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+int main() {
+    CorpusOptions options;
+    corpus_preset("dense", USB_MIDI_IO_PORT_NUM, 5, options);
+    options.bpm *= 30;
+
+    Sim sim;
+    sim.send(corpus_song(options));
+    sim.begin();
+    trace_reset();
+    sim.runUntil((uint64_t)options.seconds * 1000000000ULL / 2);
+
+    std::vector<uint32_t> packets;
+    uint32_t stalls = 0;
+    uint32_t serialBytes = 0;
+    for (uint32_t i = 0; i < trace_count(); i++) {
+        const traceEntry_t *entry = trace_entry(i);
+
+        if (entry->event == TRACE_RX || entry->event == TRACE_STALL) packets.push_back(entry->packet);
+        if (entry->event == TRACE_STALL) stalls++;
+        if (entry->event < TRACE_RX) serialBytes += entry->len;
+    }
+
+    CHECK_EQ(trace_count(), TRACE_SIZE);
+    CHECK(stalls > 0);
+    CHECK(serialBytes > 0);
+    CHECK(!packets.empty());
+
+    bool found = false;
+    for (size_t first = 0; !packets.empty() && first + packets.size() <= sim.sent.size() && !found; first++) {
+        found = true;
+        for (size_t i = 0; i < packets.size() && found; i++) {
+            if (packets[i] != sim.sent[first + i].packet) found = false;
+        }
+    }
+    CHECK(found);
+
+    test_report("traced_packets", packets.size());
+    test_report("traced_stalls", stalls);
+
+    return test_result();
+}
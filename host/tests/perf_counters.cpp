@@ -0,0 +1,144 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - PERFORMANCE COUNTERS TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// Reply to the performance counters query "F0 7D 57 03 F7": counters set by the test must
+// be decoded from the reply unchanged (all bits of the 32-bit values). Then a song on two
+// ports is sent faster than the serial port can transmit it, with packets from an unused
+// port and with invalid CIN in between: the dropped packets must be counted once, although
+// packets are retried after serial stalls, and the other counters must match the traffic.
+
+#include <string.h>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "diag.h"
+#include "sim.h"
+#include "test.h"
+
+#define COUNTERS_CMD 0x03
+#define COUNTERS_COUNT (8 + SERIAL_INTERFACE_MAX)
+#define COUNTERS_INVALID_EVERY 50
+
+// Counters in the reply
+static std::vector<uint32_t> counters_decode(const std::vector<uint8_t> &reply) {
+    std::vector<uint32_t> values;
+
+    if (reply.size() != 6 + 5 * (size_t)reply[4]) return values;
+    for (uint8_t i = 0; i < reply[4]; i++) values.push_back(diag_value(reply, 5 + 5 * i));
+    return values;
+}
+
+int main() {
+    // Encoding
+    {
+        static const uint32_t patterns[] = { 0xFFFFFFFF, 0x80000000, 0x12345678, 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000 };
+
+        Sim sim;
+        sim.send(diag_query(20000000, 0, COUNTERS_CMD));
+        sim.begin();
+        sim.runUntil(10000000);
+
+        perfCounters.usbRxPackets = patterns[0];
+        perfCounters.usbRxNakPeriods = patterns[1];
+        perfCounters.usbDroppedPackets = patterns[2];
+        perfCounters.serialStalls = patterns[3];
+        perfCounters.runningStatusSavedBytes = patterns[4];
+        perfCounters.portSelections = patterns[5];
+        for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) perfCounters.serialBytes[s] = patterns[6 + s % 3] + s;
+
+        sim.runUntil(100000000);
+
+        std::vector<std::vector<uint8_t>> replies = diag_replies(sim.inPackets, COUNTERS_CMD);
+        CHECK_EQ(replies.size(), 1);
+        if (replies.size() == 1) {
+            std::vector<uint32_t> values = counters_decode(replies[0]);
+            CHECK_EQ(values.size(), COUNTERS_COUNT);
+
+            if (values.size() == COUNTERS_COUNT) {
+                // The packets of the query were received meanwhile
+                CHECK_EQ(values[0], patterns[0] + 2);
+                for (uint8_t i = 1; i < 6; i++) CHECK_EQ(values[i], patterns[i]);
+                for (uint8_t i = 6; i < 8; i++) CHECK_EQ(values[i], 0);
+                for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) CHECK_EQ(values[8 + s], patterns[6 + s % 3] + s);
+            }
+        }
+    }
+
+    // Traffic
+    {
+        CorpusOptions options;
+        corpus_preset("dense", USB_MIDI_IO_PORT_NUM, 5, options);
+        options.bpm *= 10;
+        std::vector<MidiMessage> song = corpus_song(options);
+
+        Sim sim;
+        uint32_t invalid = 0;
+        for (size_t i = 0; i < song.size(); i++) {
+            sim.send(song[i]);
+
+            if (i % COUNTERS_INVALID_EVERY == COUNTERS_INVALID_EVERY - 1) {
+                // Note On from an unused port, or a packet with reserved CIN
+                if (invalid % 2 == 0) sim.sendPacket(song[i].timeNs, midi_packet(USB_MIDI_IO_PORT_NUM, 0x09, 0x90, 0x3C, 0x64));
+                else sim.sendPacket(song[i].timeNs, midi_packet(0, 0x00, 0x90, 0x3C, 0x64));
+                invalid++;
+            }
+        }
+
+        sim.begin();
+        memset((void *)&perfCounters, 0, sizeof(perfCounters));
+        CHECK(sim.runUntilIdle(600000000000ULL));
+        uint64_t endNs = mock_now_ns();
+        sim.send(diag_query(endNs, 0, COUNTERS_CMD));
+        sim.runUntil(endNs + 100000000);
+
+        std::vector<std::vector<uint8_t>> replies = diag_replies(sim.inPackets, COUNTERS_CMD);
+        CHECK_EQ(replies.size(), 1);
+        std::vector<uint32_t> values = counters_decode(replies.empty() ? std::vector<uint8_t>() : replies[0]);
+        CHECK_EQ(values.size(), COUNTERS_COUNT);
+
+        if (values.size() == COUNTERS_COUNT) {
+            CHECK_EQ(values[0], sim.sent.size());
+            CHECK_EQ(values[2], invalid);
+            CHECK(values[3] > 0);
+
+            uint32_t portSelections = 0;
+            for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+                WireDecoder decoder(true);
+                for (const SimByte &b : sim.serial[s]) decoder.feed(b.data, b.timeNs);
+                portSelections += decoder.portSelections;
+
+                CHECK_EQ(values[8 + s], (uint32_t)mock_serial_get_stats(s)->txBytes);
+            }
+            CHECK_EQ(values[5], portSelections);
+
+            test_report("serial_stalls", values[3]);
+            test_report("running_status_saved_bytes", values[4]);
+            test_report("port_selections", values[5]);
+        }
+        test_report("dropped_packets", invalid);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,201 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - PMA COPY TEST AND BENCHMARK
+  ----------------------------------------------------------------------
+
+*/
+
+// Copy routines between the packet buffers and the strided packet memory (each 16-bit
+// PMA halfword occupies a 32-bit word, the upper half isn't backed by memory): the
+// packet routines of usb_midi_device.c are checked against the byte routines they
+// replaced for every transaction size and both directions, then both are timed.
+// The test is C and includes the driver itself, its copy routines are static.
+
+#include <string.h>
+#include <time.h>
+
+#include "usb_midi_device.c"
+#include "mock.h"
+#include "test.h"
+
+#define BENCH_ROUNDS 2000000
+
+#define PMA_SENTINEL 0x5AC3
+
+// --------------------------------------------------------------------------------------
+// Previous byte routines
+// --------------------------------------------------------------------------------------
+static void byte_copy_to_pma(const uint8_t *buf, uint16_t len, uint16_t pma_offset) {
+    uint16_t *dst = (uint16*)usb_pma_ptr(pma_offset);
+    uint16_t n = len >> 1;
+    uint16_t i;
+    for (i = 0; i < n; i++) {
+        *dst = (uint16)(*buf) | *(buf + 1) << 8;
+        buf += 2;
+        dst += 2;
+    }
+    if (len & 1) {
+        *dst = *buf;
+    }
+}
+
+static void byte_copy_from_pma(uint8_t *buf, uint16_t len, uint16_t pma_offset) {
+    uint32_t *src = (uint32*)usb_pma_ptr(pma_offset);
+    uint16_t *dst = (uint16*)buf;
+    uint16_t n = len >> 1;
+    uint16_t i;
+    for (i = 0; i < n; i++) {
+        *dst++ = *src++;
+    }
+    if (len & 1) {
+        *dst = *src & 0xFF;
+    }
+}
+
+// --------------------------------------------------------------------------------------
+// Correctness
+// --------------------------------------------------------------------------------------
+static uint32_t seed = 1;
+
+static uint32_t random_word(void) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) | (seed << 16);
+}
+
+// Fills the buffer and a word after it with the sentinel (upper halves with garbage)
+static void fill_pma(uint16_t offset, uint32_t packets) {
+    uint32_t i;
+    for (i = 0; i <= packets * 2; i++) mock_usb_pma_write(offset + i * 2, PMA_SENTINEL);
+}
+
+static void test_to_pma(uint16_t offset, uint32_t packets) {
+    uint32_t buf[16];
+    uint16_t expected[33];
+    uint32_t i;
+
+    for (i = 0; i < packets; i++) buf[i] = random_word();
+
+    fill_pma(offset, packets);
+    byte_copy_to_pma((const uint8_t *)buf, packets * 4, offset);
+    for (i = 0; i <= packets * 2; i++) expected[i] = mock_usb_pma_read(offset + i * 2);
+
+    fill_pma(offset, packets);
+    usb_copy_packets_to_pma(buf, packets, offset);
+    for (i = 0; i < packets; i++) {
+        CHECK_EQ(mock_usb_pma_read(offset + i * 4), buf[i] & 0xFFFF);
+        CHECK_EQ(mock_usb_pma_read(offset + i * 4 + 2), buf[i] >> 16);
+    }
+    for (i = 0; i <= packets * 2; i++) CHECK_EQ(mock_usb_pma_read(offset + i * 2), expected[i]);
+    CHECK_EQ(mock_usb_pma_read(offset + packets * 4), PMA_SENTINEL);
+}
+
+static void test_from_pma(uint16_t offset, uint32_t packets) {
+    uint32_t expected[17], buf[17];
+    uint32_t i;
+
+    for (i = 0; i < packets; i++) {
+        uint32_t packet = random_word();
+        mock_usb_pma_write(offset + i * 4, (uint16_t)packet);
+        mock_usb_pma_write(offset + i * 4 + 2, (uint16_t)(packet >> 16));
+    }
+
+    memset(expected, 0xEE, sizeof(expected));
+    byte_copy_from_pma((uint8_t *)expected, packets * 4, offset);
+
+    memset(buf, 0xEE, sizeof(buf));
+    usb_copy_packets_from_pma(buf, packets, offset);
+    for (i = 0; i < packets; i++) {
+        CHECK_EQ(buf[i] & 0xFFFF, mock_usb_pma_read(offset + i * 4));
+        CHECK_EQ(buf[i] >> 16, mock_usb_pma_read(offset + i * 4 + 2));
+    }
+    for (i = 0; i <= packets; i++) CHECK_EQ(buf[i], expected[i]);
+}
+
+// --------------------------------------------------------------------------------------
+// Benchmark
+// --------------------------------------------------------------------------------------
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Transactions of 16 packets, the first word of the buffer changes so that the copies
+// can't be hoisted out of the loop
+static void benchmark(void) {
+    uint32_t buf[16];
+    volatile uint32_t sink = 0;
+    double start, to_bytes, to_packets, from_bytes, from_packets;
+    uint32_t round;
+
+    for (round = 0; round < 16; round++) buf[round] = random_word();
+
+    start = now_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        buf[0] = round;
+        byte_copy_to_pma((const uint8_t *)buf, 64, MIDI_STREAM_IN_EPADDR);
+    }
+    to_bytes = now_ns() - start;
+
+    start = now_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        buf[0] = round;
+        usb_copy_packets_to_pma(buf, 16, MIDI_STREAM_IN_EPADDR);
+    }
+    to_packets = now_ns() - start;
+
+    start = now_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        byte_copy_from_pma((uint8_t *)buf, 64, MIDI_STREAM_OUT_EPADDR);
+        sink += buf[round & 15];
+    }
+    from_bytes = now_ns() - start;
+
+    start = now_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        usb_copy_packets_from_pma(buf, 16, MIDI_STREAM_OUT_EPADDR);
+        sink += buf[round & 15];
+    }
+    from_packets = now_ns() - start;
+
+    (void)sink;
+    test_report("to_pma_bytes_ns_per_packet", to_bytes / BENCH_ROUNDS / 16);
+    test_report("to_pma_packets_ns_per_packet", to_packets / BENCH_ROUNDS / 16);
+    test_report("from_pma_bytes_ns_per_packet", from_bytes / BENCH_ROUNDS / 16);
+    test_report("from_pma_packets_ns_per_packet", from_packets / BENCH_ROUNDS / 16);
+}
+
+int main(void) {
+    static const uint16_t offsets[] = { MIDI_STREAM_IN_EPADDR, MIDI_STREAM_OUT_BUF0_EPADDR, MIDI_STREAM_OUT_BUF1_EPADDR };
+    uint32_t o, packets;
+
+    mock_reset();
+
+    for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+        for (packets = 0; packets <= 16; packets++) {
+            test_to_pma(offsets[o], packets);
+            test_from_pma(offsets[o], packets);
+        }
+    }
+
+    benchmark();
+
+    return test_result();
+}
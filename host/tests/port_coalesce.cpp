@@ -0,0 +1,72 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - PORT COALESCING TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// General MIDI songs on two and four USB MIDI ports, all sent to every serial port:
+// bytes on the wire per message (Port Selection messages included) and note latency,
+// with and without grouping the packets by port. The ports of the songs are either
+// slightly apart or quantized together.
+
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+static void play(uint8_t ports, bool quantized) {
+    CorpusOptions options;
+    corpus_preset("gm", ports, 20, options);
+    if (quantized) options.portOffsetUs = 0;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+
+    // Port order is kept within each port
+    CHECK(sim.inOrder(0));
+
+    WireDecoder decoder(true);
+    for (const SimByte &b : sim.serial[0]) decoder.feed(b.data, b.timeNs);
+
+    std::vector<uint64_t> latency;
+    for (const SimLatency &l : sim.latencies(0)) {
+        if (midi_is_note_on(l.bytes)) latency.push_back(l.wireNs - l.dueNs);
+    }
+
+    std::string suffix = "_" + std::to_string(ports) + "ports" + (quantized ? "_quantized" : "");
+    test_report(("wire_bytes_per_message" + suffix).c_str(), (double)decoder.bytes / song.size());
+    test_report(("port_selections_per_message" + suffix).c_str(), (double)decoder.portSelections / song.size());
+    test_report(("note_latency_p50_us" + suffix).c_str(), sim_percentile(latency, 50) / 1e3);
+    test_report(("note_latency_p99_us" + suffix).c_str(), sim_percentile(latency, 99) / 1e3);
+}
+
+int main() {
+    play(2, false);
+    play(4, false);
+    play(2, true);
+    play(4, true);
+    return test_result();
+}
@@ -0,0 +1,117 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - PROFILER TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// Aggregation of the profiler with the cycle counter of the mock (set by the test):
+// count, minimum, maximum and total of recorded sections, also across the wrap around of
+// the cycle counter, and reset. The reply to "F0 7D 57 04 F7" must contain the values of
+// each section (the average as total / count), "F0 7D 57 05 F7" must reset them.
+
+#include <string.h>
+
+#include "sketch.h"
+#include "diag.h"
+#include "sim.h"
+#include "test.h"
+
+#define PROFILE_DUMP_CMD  0x04
+#define PROFILE_RESET_CMD 0x05
+
+// Run a section of the given number of cycles
+static void profile_section(uint8_t section, uint32_t cycles) {
+    PROFILER_SCOPE(section);
+    mock_dwt_cnt += cycles;
+}
+
+int main() {
+    // Aggregation
+    profiler_reset();
+    mock_dwt_cnt = 0xFFFFFF00;
+    profile_section(PROFILER_PROCESS_PACKET, 300);   // Wraps around
+    profile_section(PROFILER_PROCESS_PACKET, 100);
+    profile_section(PROFILER_PROCESS_PACKET, 0);
+    profile_section(PROFILER_PROCESS_PACKET, 0xFFFFFFFF);
+    profile_section(PROFILER_USB_RX, 7);
+
+    CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].count, 4);
+    CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].min, 0);
+    CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].max, 0xFFFFFFFF);
+    CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].total, 400ULL + 0xFFFFFFFF);
+    CHECK_EQ(profilerStats[PROFILER_USB_RX].count, 1);
+    CHECK_EQ(profilerStats[PROFILER_USB_RX].min, 7);
+    CHECK_EQ(profilerStats[PROFILER_USB_RX].max, 7);
+    CHECK_EQ(profilerStats[PROFILER_LOOP].count, 0);
+
+    // The first run sets the minimum, also when it's larger than 0
+    profiler_reset();
+    profile_section(PROFILER_USB_TX, 50);
+    profile_section(PROFILER_USB_TX, 20);
+    profile_section(PROFILER_USB_TX, 30);
+    CHECK_EQ(profilerStats[PROFILER_USB_TX].min, 20);
+    CHECK_EQ(profilerStats[PROFILER_USB_TX].max, 50);
+    CHECK_EQ(profilerStats[PROFILER_USB_TX].total, 100);
+    CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].count, 0);
+
+    // Dump and reset queries
+    {
+        Sim sim;
+        sim.send(diag_query(20000000, 0, PROFILE_DUMP_CMD));
+        sim.send(diag_query(40000000, 0, PROFILE_RESET_CMD));
+        sim.begin();
+        sim.runUntil(10000000);
+
+        // No packets are processed by the queries
+        profilerStats[PROFILER_PROCESS_PACKET].count = 3;
+        profilerStats[PROFILER_PROCESS_PACKET].min = 0x7F;
+        profilerStats[PROFILER_PROCESS_PACKET].max = 0xFFFFFFFF;
+        profilerStats[PROFILER_PROCESS_PACKET].total = 0x200000000ULL;
+
+        sim.runUntil(30000000);
+
+        std::vector<std::vector<uint8_t>> replies = diag_replies(sim.inPackets, PROFILE_DUMP_CMD);
+        CHECK_EQ(replies.size(), PROFILER_SECTIONS);
+        for (size_t i = 0; i < replies.size(); i++) {
+            CHECK_EQ(replies[i].size(), 6 + 4 * 5);
+            CHECK_EQ(replies[i][4], i);
+        }
+        if (replies.size() == PROFILER_SECTIONS && replies[PROFILER_PROCESS_PACKET].size() == 6 + 4 * 5) {
+            const std::vector<uint8_t> &reply = replies[PROFILER_PROCESS_PACKET];
+            CHECK_EQ(diag_value(reply, 5), 3);
+            CHECK_EQ(diag_value(reply, 10), 0x7F);
+            CHECK_EQ(diag_value(reply, 15), 0xAAAAAAAA);
+            CHECK_EQ(diag_value(reply, 20), 0xFFFFFFFF);
+
+            // loop() ran, the query was received and the reply sent
+            CHECK(diag_value(replies[PROFILER_LOOP], 5) > 0);
+            CHECK(diag_value(replies[PROFILER_USB_RX], 5) > 0);
+        }
+
+        sim.runUntil(50000000);
+        CHECK_EQ(diag_replies(sim.inPackets, PROFILE_RESET_CMD).size(), 1);
+        CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].count, 0);
+        CHECK_EQ(profilerStats[PROFILER_PROCESS_PACKET].max, 0);
+    }
+
+    return test_result();
+}
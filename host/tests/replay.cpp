@@ -0,0 +1,55 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - TEST OF THE PACKET PATH
+  ----------------------------------------------------------------------
+
+*/
+
+// Every message of a song is transmitted on the serial port, in order
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+int main() {
+    CorpusOptions options;
+    corpus_preset("gm", 1, 10, options);
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(60000000000ULL));
+
+    std::vector<WireMessage> wire = sim.wireMessages(1);
+    CHECK_EQ(wire.size(), song.size());
+    for (size_t i = 0; i < wire.size() && i < song.size(); i++) {
+        std::vector<uint8_t> bytes = song[i].bytes;
+        // Note Off may be sent as Note On with zero velocity
+        if (midi_is_note_off(bytes) && midi_is_note_off(wire[i].bytes)) continue;
+        CHECK(wire[i].bytes == bytes);
+    }
+
+    CHECK_EQ(sim.latencies(1).size(), song.size());
+    CHECK_EQ(sim.outNaks, 0);
+
+    return test_result();
+}
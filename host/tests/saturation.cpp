@@ -0,0 +1,86 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SATURATION TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// Four USB MIDI ports sent to four serial ports at several times the line speed:
+// packets are only taken from the USB receive buffer when every serial port has room for
+// their bytes (Port Selection and Running Status included), so the firmware never waits
+// for buffer space, the host is NAKed instead and no byte is dropped or reordered (also
+// MIDI clock, which is sent ahead of the queued bytes on the serial ports with DMA).
+
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#define SATURATION_SECONDS 10
+
+int main() {
+    CorpusOptions options;
+    options.ports = USB_MIDI_IO_PORT_NUM;
+    options.seconds = SATURATION_SECONDS;
+    options.bpm = 480;
+    options.chordChannels = 3;
+    options.chordNotes = 6;
+    options.ccPerBeat = 8;
+    options.pitchBendPerBeat = 8;
+    options.sysexBytes = 128;
+    options.sysexEveryBeats = 4;
+    options.clock = true;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+
+    uint64_t songNs = song.back().timeNs;
+    CHECK(sim.runUntilIdle(600000000000ULL));
+    uint64_t endNs = mock_now_ns();
+
+    // Sent faster than the serial ports can transmit
+    CHECK(sim.outNaks > 0);
+    CHECK(endNs > 2 * songNs);
+
+    // The firmware never waited for buffer space
+    CHECK_EQ(mock_wait_count(), 0);
+
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        const mock_serial_stats *stats = mock_serial_get_stats(s);
+        CHECK_EQ(stats->blockedWrites, 0);
+
+        // Messages of each port arrive complete and in order
+        CHECK(sim.inOrder(s));
+
+        std::string prefix = "serial" + std::to_string(s);
+        test_report((prefix + "_bytes").c_str(), stats->txBytes);
+        test_report((prefix + "_utilization").c_str(), (double)stats->busyNs / endNs);
+        test_report((prefix + "_interrupts").c_str(), stats->txInterrupts + stats->dmaInterrupts);
+    }
+
+    test_report("naks", sim.outNaks);
+    test_report("nak_ms", sim.nakNs / 1e6);
+    test_report("seconds", endNs / 1e9);
+    return test_result();
+}
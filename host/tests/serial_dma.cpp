@@ -0,0 +1,142 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SERIAL DMA TRANSMISSION TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// Ring buffer and DMA bookkeeping of serial_tx.cpp against the mocked DMA controller:
+// queued and free space while bytes are transmitted, writes which wrap around and block
+// on the full buffer, System RealTime bytes overtaking queued bytes, and the number of
+// interrupts per byte (DMA transfer complete on USART1-3, TXE on UART4).
+
+#include <vector>
+
+#include <wirish.h>
+#include "serial_tx.h"
+#include "test.h"
+
+#define TEST_BAUD 31250
+
+static HardwareSerial *testSerials[SERIAL_INTERFACE_MAX] = { SERIALS_PLIST };
+static std::vector<uint8_t> line[MOCK_SERIAL_PORTS];
+
+static void on_tx(uint8_t port, uint8_t data, uint64_t time_ns, void *ctx) {
+    line[port].push_back(data);
+}
+
+static bool port_has_dma(uint8_t s) {
+    return CFG_SERIAL_DMA_TX > 0 && s < 3;
+}
+
+static void wait_idle(void) {
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        while (!mock_serial_tx_idle(s)) mock_advance(100000);
+    }
+}
+
+static std::vector<uint8_t> pattern(uint32_t len, uint32_t seed) {
+    std::vector<uint8_t> data(len);
+    for (uint32_t i = 0; i < len; i++) data[i] = (uint8_t)((i * 7 + seed) & 0x7F);
+    return data;
+}
+
+int main() {
+    mock_reset();
+    mock_serial_set_tx_callback(on_tx, NULL);
+
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        testSerials[s]->begin(TEST_BAUD);
+        serial_tx_begin(s, testSerials[s]);
+        CHECK_EQ(serial_tx_queued(s), 0);
+    }
+
+    // Queued bytes and free space follow the transmission
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        std::vector<uint8_t> data = pattern(10, s);
+        uint32_t before = serial_tx_available_for_write(s);
+        serial_tx_write(s, data.data(), data.size());
+        if (port_has_dma(s)) {
+            CHECK_EQ(before, SERIAL_TX_BUFFER_SIZE);
+            CHECK_EQ(serial_tx_queued(s), 10);
+            CHECK_EQ(serial_tx_available_for_write(s), SERIAL_TX_BUFFER_SIZE - 10);
+        }
+    }
+    wait_idle();
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        CHECK(line[s] == pattern(10, s));
+        CHECK_EQ(serial_tx_queued(s), 0);
+        if (port_has_dma(s)) CHECK_EQ(serial_tx_available_for_write(s), SERIAL_TX_BUFFER_SIZE);
+        line[s].clear();
+    }
+
+    // Writes larger than the buffer wrap around and wait for the DMA interrupts
+    std::vector<uint8_t> expected[SERIAL_INTERFACE_MAX];
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        for (uint32_t n = 1; n <= 5; n++) {
+            std::vector<uint8_t> data = pattern(n * SERIAL_TX_BUFFER_SIZE / 3 + 1, s + n);
+            serial_tx_write(s, data.data(), data.size());
+            expected[s].insert(expected[s].end(), data.begin(), data.end());
+        }
+    }
+    wait_idle();
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        CHECK(line[s] == expected[s]);
+        CHECK_EQ(serial_tx_queued(s), 0);
+        line[s].clear();
+    }
+
+    // System RealTime byte written after a full buffer
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        std::vector<uint8_t> data = pattern(SERIAL_TX_BUFFER_SIZE / 2, s);
+        serial_tx_write(s, data.data(), data.size());
+        serial_tx_write_realtime(s, 0xF8);
+    }
+    wait_idle();
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        uint32_t position = 0;
+        while (position < line[s].size() && line[s][position] != 0xF8) position++;
+        CHECK_EQ(line[s].size(), SERIAL_TX_BUFFER_SIZE / 2 + 1);
+        if (port_has_dma(s)) {
+            char key[32];
+            snprintf(key, sizeof(key), "serial%u_realtime_position", s);
+            test_report(key, position);
+            CHECK(position < SERIAL_TX_BUFFER_SIZE / 2);
+        } else {
+            CHECK_EQ(position, SERIAL_TX_BUFFER_SIZE / 2);
+        }
+    }
+
+    // Interrupts per transmitted byte
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        const mock_serial_stats *stats = mock_serial_get_stats(s);
+        char key[32];
+        snprintf(key, sizeof(key), "serial%u_interrupts_per_byte", s);
+        test_report(key, (double)(stats->txInterrupts + stats->dmaInterrupts) / stats->txBytes);
+        if (port_has_dma(s)) {
+            CHECK_EQ(stats->txInterrupts, 0);
+            CHECK(stats->dmaInterrupts < stats->txBytes);
+        } else {
+            CHECK_EQ(stats->dmaInterrupts, 0);
+        }
+    }
+
+    return test_result();
+}
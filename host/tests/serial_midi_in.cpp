@@ -0,0 +1,162 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SERIAL MIDI INPUT TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// MIDI received on a serial port must reach the host as USB MIDI packets: Running Status
+// expanded, RealTime bytes forwarded ahead of the message they interrupt, SysEx of every
+// length split into packets with the right CIN, SysEx interrupted by another status byte
+// ended with F7 before the interrupting message, and stray data bytes dropped. Received
+// packets are batched into IN transactions of up to 16 packets; a packet waits at most
+// USB_IN_FLUSH_US (plus a host poll and a loop() step) for more packets, and while the
+// host doesn't poll the packets are collected into full transactions.
+
+#include <string.h>
+
+#include "sketch.h"
+#include "sim.h"
+#include "test.h"
+
+#define MIDI_IN_SERIAL 1
+#define MIDI_IN_START_NS 10000000ULL
+#define MIDI_IN_BURST 200
+#define MIDI_IN_SLOW_BURST 64
+#define MIDI_IN_SLOW_POLL_NS 12000000ULL
+
+static const uint8_t midiInBytes[] = {
+    0x90, 0x3C, 0x64,                   // Note On
+    0x3E, 0x64,                         // Running Status
+    0x40, 0xF8, 0x00,                   // Timing Clock in the middle of a message
+    0xC5, 0x10, 0x11,                   // Program Change, Running Status
+    0xF2, 0x01, 0x02,                   // Song Position Pointer
+    0x05,                               // Stray data byte (System Common cancels Running Status)
+    0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7, // SysEx ending with three bytes
+    0xF0, 0xF7,                         // SysEx ending with two bytes
+    0xF0, 0x01, 0x02, 0x03, 0xF7,       // SysEx ending with two bytes after a full packet
+    0xF0, 0x01, 0x02, 0x03, 0x04, 0xF7, // SysEx ending with three bytes after a full packet
+    0xF6,                               // Tune Request
+    0xF1, 0x20,                         // MTC Quarter Frame
+    0xF0, 0x01, 0x02, 0x03, 0x04, 0x90, 0x3C, 0x64, // SysEx interrupted by Note On after a full packet
+    0xF0, 0x01, 0xF6,                   // SysEx interrupted by Tune Request
+    0xF0, 0x01, 0x02, 0x03, 0xF1, 0x20, // SysEx interrupted by MTC Quarter Frame after a full packet
+    0xF0, 0x01, 0x02, 0xF0, 0x7E, 0xF7, // SysEx interrupted by SysEx after a full packet
+    0xFA,                               // Start
+};
+
+static const uint32_t midiInPackets[] = {
+    0x643C9009, 0x643E9009, 0x0000F80F, 0x00409009, 0x0010C50C, 0x0011C50C, 0x0201F203,
+    0x7F7EF004, 0xF7010907, 0x00F7F006, 0x0201F004, 0x00F70306, 0x0201F004, 0xF7040307,
+    0x0000F605, 0x0020F102,
+    0x0201F004, 0xF7040307, 0x643C9009,
+    0xF701F007, 0x0000F605,
+    0x0201F004, 0x00F70306, 0x0020F102,
+    0x0201F004, 0x0000F705, 0xF77EF007,
+    0x0000FA0F,
+};
+
+// Packets received by the host, grouped by IN transaction
+static std::vector<std::vector<uint32_t>> midi_in_batches(const Sim &sim) {
+    std::vector<std::vector<uint32_t>> batches;
+
+    for (size_t i = 0; i < sim.inPackets.size(); i++) {
+        if (i == 0 || sim.inTimes[i] != sim.inTimes[i - 1]) batches.push_back(std::vector<uint32_t>());
+        batches.back().push_back(sim.inPackets[i]);
+    }
+
+    return batches;
+}
+
+// Burst of Note On messages with Running Status (two bytes each)
+static std::vector<uint8_t> midi_in_burst(uint32_t messages) {
+    std::vector<uint8_t> bytes = { 0x91 };
+    for (uint32_t i = 0; i < messages; i++) {
+        bytes.push_back(i & 0x7F);
+        bytes.push_back(1 + i % 127);
+    }
+    return bytes;
+}
+
+int main() {
+    // Parsing
+    {
+        Sim sim;
+        sim.begin();
+        sim.runUntil(MIDI_IN_START_NS);
+        mock_serial_rx(MIDI_IN_SERIAL, midiInBytes, sizeof(midiInBytes));
+        sim.runUntil(MIDI_IN_START_NS + 100000000ULL);
+
+        CHECK(sim.inPackets == std::vector<uint32_t>(midiInPackets, midiInPackets + sizeof(midiInPackets) / 4));
+    }
+
+    // The host polls often: batches are sent after USB_IN_FLUSH_US at the latest
+    {
+        std::vector<uint8_t> burst = midi_in_burst(MIDI_IN_BURST);
+        uint64_t byteNs = 10 * 1000000000ULL / serialSpeed[MIDI_IN_SERIAL];
+
+        Sim sim;
+        sim.begin();
+        sim.runUntil(MIDI_IN_START_NS);
+        mock_serial_rx(MIDI_IN_SERIAL, burst.data(), burst.size());
+        sim.runUntil(MIDI_IN_START_NS + burst.size() * byteNs + 100000000ULL);
+
+        CHECK_EQ(sim.inPackets.size(), MIDI_IN_BURST);
+        uint64_t worstNs = 0;
+        for (size_t i = 0; i < sim.inPackets.size(); i++) {
+            CHECK_EQ(sim.inPackets[i], 0x00009109 | ((i & 0x7F) << 16) | ((1 + i % 127) << 24));
+
+            // Time since the stop bit of the last byte of the message
+            uint64_t receivedNs = MIDI_IN_START_NS + (2 * i + 3) * byteNs;
+            if (sim.inTimes[i] - receivedNs > worstNs) worstNs = sim.inTimes[i] - receivedNs;
+        }
+        CHECK(worstNs <= USB_IN_FLUSH_US * 1000ULL + sim.options.idleStepNs + sim.options.inPollNs);
+
+        std::vector<std::vector<uint32_t>> batches = midi_in_batches(sim);
+        for (const std::vector<uint32_t> &batch : batches) CHECK(batch.size() <= USB_IN_BATCH_SIZE);
+
+        test_report("packets_per_transaction", (double)sim.inPackets.size() / batches.size());
+        test_report("worst_wait_us", worstNs / 1e3);
+    }
+
+    // The host polls rarely: the packets are collected into full transactions
+    {
+        std::vector<uint8_t> burst = midi_in_burst(MIDI_IN_SLOW_BURST);
+        SimOptions options;
+        options.inPollNs = MIDI_IN_SLOW_POLL_NS;
+
+        Sim sim(options);
+        sim.begin();
+        sim.runUntil(MIDI_IN_START_NS);
+        mock_serial_rx(MIDI_IN_SERIAL, burst.data(), burst.size());
+        sim.runUntil(MIDI_IN_START_NS + 1000000000ULL);
+
+        CHECK_EQ(sim.inPackets.size(), MIDI_IN_SLOW_BURST);
+        CHECK_EQ(mock_serial_get_stats(MIDI_IN_SERIAL)->rxOverruns, 0);
+        std::vector<std::vector<uint32_t>> batches = midi_in_batches(sim);
+        // Only the first batch (the host polled soon after the burst started) and the last one are partial
+        for (size_t i = 1; i + 1 < batches.size(); i++) CHECK_EQ(batches[i].size(), USB_IN_BATCH_SIZE);
+
+        test_report("packets_per_transaction_slow_host", (double)sim.inPackets.size() / batches.size());
+    }
+
+    return test_result();
+}
@@ -0,0 +1,89 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SERIAL ROUTING TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// Four USB MIDI ports with SysEx dumps sent faster than one serial port can transmit them,
+// routed by the routing table of the configuration: each serial port must receive the
+// messages of the ports routed to it (and no other) complete and in order, without Port
+// Selection messages when it receives only one port, and without SysEx interrupted by
+// other ports. With separate serial ports for the ports, the song is transmitted faster
+// than when all ports are sent to every serial port.
+
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#define ROUTING_SECONDS 10
+
+int main() {
+    CorpusOptions options;
+    corpus_preset("gm", USB_MIDI_IO_PORT_NUM, ROUTING_SECONDS, options);
+    options.bpm *= 5;
+    options.sysexBytes = 64;
+    options.sysexEveryBeats = 4;
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+    uint64_t endNs = mock_now_ns();
+
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        uint16_t mask = 0;
+        for (uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM; port++) {
+            if (serialRouting[port] & (1 << s)) mask |= 1 << port;
+        }
+
+        WireDecoder decoder(true);
+        bool sysEx = false;
+        uint32_t interrupted = 0;
+        for (const SimByte &b : sim.serial[s]) {
+            decoder.feed(b.data, b.timeNs);
+
+            if (b.data == 0xF0) sysEx = true;
+            else if (b.data == 0xF7) sysEx = false;
+            else if (sysEx && b.data >= 0x80 && b.data < 0xF8) interrupted++;
+        }
+
+        CHECK(sim.inOrder(s, mask));
+        CHECK_EQ(interrupted, 0);
+        if ((mask & (mask - 1)) == 0) {
+            CHECK_EQ(decoder.portSelections, 0);
+        } else {
+            for (const WireMessage &w : decoder.messages) CHECK(mask & (1 << w.port));
+        }
+
+        std::string prefix = "serial" + std::to_string(s);
+        test_report((prefix + "_bytes").c_str(), sim.serial[s].size());
+        test_report((prefix + "_port_selections").c_str(), decoder.portSelections);
+        test_report((prefix + "_utilization").c_str(), (double)mock_serial_get_stats(s)->busyNs / endNs);
+    }
+
+    test_report("seconds", endNs / 1e9);
+    return test_result();
+}
@@ -0,0 +1,166 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SERIAL UTILIZATION TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// Math of the utilization estimator: the line capacity of the window, sliding of the
+// window by one or more slots, restart after a long pause, saturated slots and disabled
+// ports. Then a song is sent faster than the serial port can transmit it: the port must be
+// saturated (about 100 %) and the LED must blink. With CFG_USB_MIDI_IN the utilization is
+// read with "F0 7D 57 08 F7", without it only the LED shows it.
+
+#include <algorithm>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "diag.h"
+#include "sim.h"
+#include "test.h"
+
+#define UTILIZATION_CMD 0x08
+
+int main() {
+    // Estimator
+    {
+        // 31250 bauds: 3125 bytes/s, 800 bytes in 256 ms; 115200 bauds: 2949 bytes in 256 ms
+        utilization_begin(0, 31250);
+        utilization_begin(1, 115200);
+        utilization_begin(2, 0);
+
+        // Start the window at 1000 ms (after a long pause)
+        uint32_t now = 1000;
+        utilization_update(now);
+        CHECK_EQ(utilization_percent(0), 0);
+
+        // The current slot isn't counted until it's completed
+        utilization_add(0, 100);
+        utilization_add(1, 295);
+        utilization_add(2, 100);
+        utilization_update(now + UTILIZATION_SLOT_MS - 1);
+        CHECK_EQ(utilization_percent(0), 0);
+
+        now += UTILIZATION_SLOT_MS;
+        utilization_update(now);
+        CHECK_EQ(utilization_percent(0), 100 * 100 / 800);
+        CHECK_EQ(utilization_percent(1), 295 * 100 / 2949);
+        CHECK_EQ(utilization_percent(2), 0);
+
+        // Fill the window
+        for (uint32_t i = 1; i < UTILIZATION_SLOTS; i++) {
+            utilization_add(0, 100);
+            now += UTILIZATION_SLOT_MS;
+            utilization_update(now);
+        }
+        CHECK_EQ(utilization_percent(0), 100);
+
+        // Oldest slots are replaced, several slots can be completed at once
+        utilization_add(0, 20);
+        now += 2 * UTILIZATION_SLOT_MS;
+        utilization_update(now);
+        CHECK_EQ(utilization_percent(0), (6 * 100 + 20) * 100 / 800);
+
+        // Bytes written faster than the line transmits them
+        for (uint32_t i = 0; i < UTILIZATION_SLOTS; i++) {
+            utilization_add(0, 250);
+            now += UTILIZATION_SLOT_MS;
+            utilization_update(now);
+        }
+        CHECK_EQ(utilization_percent(0), 250);
+
+        // A slot holds at most 0xFFFF bytes
+        utilization_add(0, 100000);
+        now += UTILIZATION_SLOT_MS;
+        utilization_update(now);
+        CHECK_EQ(utilization_percent(0), (7 * 250 + 0xFFFF) * 100 / 800);
+
+        // Long pause
+        now += UTILIZATION_WINDOW_MS + UTILIZATION_SLOT_MS;
+        utilization_update(now);
+        CHECK_EQ(utilization_percent(0), 0);
+        CHECK_EQ(utilization_percent(1), 0);
+
+        // Counter of milliseconds wraps around
+        now = 0xFFFFFFFF - UTILIZATION_SLOT_MS / 2;
+        utilization_update(now);
+        utilization_add(0, 400);
+        now += UTILIZATION_SLOT_MS;
+        utilization_update(now);
+        CHECK_EQ(utilization_percent(0), 50);
+    }
+
+    // Saturated serial port
+    {
+        CorpusOptions options;
+        corpus_preset("dense", USB_MIDI_IO_PORT_NUM, 5, options);
+        options.bpm *= 30;
+
+        std::vector<MidiMessage> song = corpus_song(options);
+#ifdef DIAG_SYSEX
+        song.push_back(diag_query(2000000000ULL, 0, UTILIZATION_CMD));
+        std::stable_sort(song.begin(), song.end(), [](const MidiMessage &a, const MidiMessage &b) {
+            return a.timeNs < b.timeNs;
+        });
+#endif
+
+        Sim sim;
+        sim.send(song);
+        sim.begin();
+        uint32_t ledChanges = mock_pin_changes(LED_CONNECT);
+        sim.runUntil(5000000000ULL);
+
+#ifdef DIAG_SYSEX
+        std::vector<std::vector<uint8_t>> replies = diag_replies(sim.inPackets, UTILIZATION_CMD);
+        CHECK_EQ(replies.size(), 1);
+        if (replies.size() == 1) {
+            const std::vector<uint8_t> &reply = replies[0];
+            CHECK_EQ(reply.size(), 6 + 5 * (size_t)SERIAL_INTERFACE_MAX);
+            CHECK_EQ(reply[4], SERIAL_INTERFACE_MAX);
+
+            for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX && reply.size() == 6 + 5 * (size_t)SERIAL_INTERFACE_MAX; s++) {
+                uint32_t percent = diag_value(reply, 5 + 5 * s);
+
+                if (serialSpeed[s] == 0) {
+                    CHECK_EQ(percent, 0);
+                } else {
+                    CHECK(percent >= CFG_SERIAL_UTILIZATION && percent <= 110);
+                    test_report("utilization_percent", percent);
+                }
+            }
+        }
+#else
+        for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+            if (serialSpeed[s] == 0) {
+                CHECK_EQ(utilization_percent(s), 0);
+            } else {
+                CHECK(utilization_percent(s) >= CFG_SERIAL_UTILIZATION && utilization_percent(s) <= 110);
+                test_report("utilization_percent", utilization_percent(s));
+            }
+        }
+#endif
+
+        // The LED changes every LED_SATURATED_TIME milliseconds while the port is saturated
+        CHECK(mock_pin_changes(LED_CONNECT) - ledChanges >= 5);
+    }
+
+    return test_result();
+}
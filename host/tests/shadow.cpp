@@ -0,0 +1,101 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - CHANNEL SHADOW TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// Channel messages which don't change the last sent value are dropped: each step sends
+// messages and lists the ones which must be transmitted. Bank Select, RPN/NRPN selection
+// and resets make the dependent values unknown, so the next message is sent again.
+
+#include "sketch.h"
+#include "sim.h"
+#include "test.h"
+
+#define SHADOW_SERIAL 1
+
+struct ShadowStep {
+    const char *name;
+    std::vector<std::vector<uint8_t>> sent;
+    std::vector<std::vector<uint8_t>> expected;
+};
+
+static const std::vector<uint8_t> BANK_MSB_1 = { 0xB0, 0x00, 0x01 };
+static const std::vector<uint8_t> BANK_MSB_2 = { 0xB0, 0x00, 0x02 };
+static const std::vector<uint8_t> BANK_LSB_3 = { 0xB0, 0x20, 0x03 };
+static const std::vector<uint8_t> PROGRAM_5  = { 0xC0, 0x05 };
+static const std::vector<uint8_t> PROGRAM_5_CH2 = { 0xC1, 0x05 };
+static const std::vector<uint8_t> VOLUME_100 = { 0xB0, 0x07, 0x64 };
+static const std::vector<uint8_t> RPN_MSB_0  = { 0xB0, 0x65, 0x00 };
+static const std::vector<uint8_t> RPN_LSB_0  = { 0xB0, 0x64, 0x00 };
+static const std::vector<uint8_t> NRPN_MSB_1 = { 0xB0, 0x63, 0x01 };
+static const std::vector<uint8_t> RESET_ALL  = { 0xB0, 0x79, 0x00 };
+static const std::vector<uint8_t> GM_ON      = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 };
+
+static const ShadowStep steps[] = {
+    { "first values", { BANK_MSB_1, PROGRAM_5, VOLUME_100 }, { BANK_MSB_1, PROGRAM_5, VOLUME_100 } },
+    { "same values", { BANK_MSB_1, PROGRAM_5, VOLUME_100 }, {} },
+    { "other channel", { PROGRAM_5_CH2 }, { PROGRAM_5_CH2 } },
+    { "same program after Bank Select MSB", { BANK_MSB_2, PROGRAM_5 }, { BANK_MSB_2, PROGRAM_5 } },
+    { "same program after Bank Select LSB", { BANK_LSB_3, PROGRAM_5 }, { BANK_LSB_3, PROGRAM_5 } },
+    { "same program after the same Bank Select", { BANK_LSB_3, PROGRAM_5 }, {} },
+    { "RPN selection", { RPN_MSB_0, RPN_LSB_0, RPN_MSB_0 }, { RPN_MSB_0, RPN_LSB_0 } },
+    { "NRPN deselects RPN", { NRPN_MSB_1, RPN_MSB_0 }, { NRPN_MSB_1, RPN_MSB_0 } },
+    { "Reset All Controllers deselects RPN", { RESET_ALL, RPN_MSB_0 }, { RESET_ALL, RPN_MSB_0 } },
+    { "GM System On", { GM_ON, PROGRAM_5, VOLUME_100 }, { GM_ON, PROGRAM_5, VOLUME_100 } },
+};
+
+int main() {
+    Sim sim;
+    uint64_t t = 10000000;
+    for (const ShadowStep &step : steps) {
+        for (const std::vector<uint8_t> &bytes : step.sent) {
+            sim.send(MidiMessage{t, 0, bytes});
+            t += 1000000;
+        }
+        t += 10000000;
+    }
+
+    sim.begin();
+    CHECK(sim.runUntilIdle(60000000000ULL));
+
+    std::vector<WireMessage> wire = sim.wireMessages(SHADOW_SERIAL);
+    size_t w = 0;
+    uint64_t stepNs = 10000000;
+    for (const ShadowStep &step : steps) {
+        stepNs += step.sent.size() * 1000000;
+
+        std::vector<std::vector<uint8_t>> received;
+        while (w < wire.size() && wire[w].timeNs < stepNs + 5000000) received.push_back(wire[w++].bytes);
+        if (received != step.expected) {
+            fprintf(stderr, "shadow: %s: %zu messages instead of %zu\n", step.name, received.size(), step.expected.size());
+            testFailures++;
+        }
+
+        stepNs += 10000000;
+    }
+    CHECK_EQ(w, wire.size());
+
+#ifdef CHANNEL_SHADOW
+    test_report("suppressed_bytes", shadowSuppressedBytes);
+#endif
+    return test_result();
+}
@@ -0,0 +1,142 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - SYSEX STAGING TEST
+  ----------------------------------------------------------------------
+
+*/
+
+
+// SysEx dumps sent on all ports at once, with the host interleaving the packets of the
+// ports: every serial port must receive each dump without Port Selection (or any other
+// message except System RealTime) inside it, and the messages of each port in order.
+// A dump on one port while the other ports are silent is streamed to the serial ports
+// before its last packet is received.
+
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+#define STAGING_ROUNDS 8
+#define STAGING_DUMP_BYTES 128
+#define STAGING_ROUND_NS 200000000ULL
+
+// Roland DT1 style dump with data depending on the port and round
+static MidiMessage staging_dump(uint64_t timeNs, uint8_t port, uint32_t round) {
+    MidiMessage dump{timeNs, port, { 0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, (uint8_t)port, (uint8_t)round }};
+    uint32_t sum = 0x40 + port + round;
+    while (dump.bytes.size() < STAGING_DUMP_BYTES - 2) {
+        uint8_t v = (uint8_t)((dump.bytes.size() * 7 + port * 31 + round) & 0x7F);
+        dump.bytes.push_back(v);
+        sum += v;
+    }
+    dump.bytes.push_back((128 - (sum & 0x7F)) & 0x7F);
+    dump.bytes.push_back(0xF7);
+    return dump;
+}
+
+// Number of SysEx messages interrupted by other than System RealTime bytes
+static uint32_t staging_interrupted(const std::vector<SimByte> &bytes) {
+    uint32_t interrupted = 0;
+    bool sysEx = false;
+
+    for (const SimByte &b : bytes) {
+        if (b.data == 0xF0) {
+            sysEx = true;
+        } else if (b.data == 0xF7) {
+            sysEx = false;
+        } else if (sysEx && b.data >= 0x80 && b.data < 0xF8) {
+            interrupted++;
+            sysEx = false;
+        }
+    }
+
+    return interrupted;
+}
+
+int main() {
+    Sim sim;
+
+    // Dumps of all ports, their packets interleaved, then a note on each port
+    for (uint32_t round = 0; round < STAGING_ROUNDS; round++) {
+        uint64_t t = round * STAGING_ROUND_NS;
+        std::vector<uint32_t> packets[USB_MIDI_IO_PORT_NUM];
+        size_t longest = 0;
+
+        for (uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM; port++) {
+            MidiMessage dump = staging_dump(t, port, round);
+            midi_to_packets(dump, packets[port]);
+            sim.sentMessages.push_back(dump);
+            if (packets[port].size() > longest) longest = packets[port].size();
+        }
+
+        for (size_t i = 0; i < longest; i++) {
+            for (uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM; port++) {
+                if (i < packets[port].size()) sim.sendPacket(t, packets[port][i]);
+            }
+        }
+
+        for (uint8_t port = 0; port < USB_MIDI_IO_PORT_NUM; port++) {
+            sim.send(MidiMessage{t, port, { 0x90, (uint8_t)(60 + port), 100 }});
+        }
+    }
+
+    // Dump of one port, sent slower than the serial ports transmit it
+    uint64_t singleNs = STAGING_ROUNDS * STAGING_ROUND_NS;
+    MidiMessage single = staging_dump(singleNs, 0, STAGING_ROUNDS);
+    std::vector<uint32_t> singlePackets;
+    midi_to_packets(single, singlePackets);
+    sim.sentMessages.push_back(single);
+    for (size_t i = 0; i < singlePackets.size(); i++) sim.sendPacket(singleNs + i * 1000000, singlePackets[i]);
+#ifdef SYSEX_STAGING
+    uint64_t singleLastNs = singleNs + (singlePackets.size() - 1) * 1000000;
+#endif
+
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+
+    uint32_t interrupted = 0;
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        uint32_t count = staging_interrupted(sim.serial[s]);
+        interrupted += count;
+
+#ifdef SYSEX_STAGING
+        CHECK_EQ(count, 0);
+        CHECK(sim.inOrder(s));
+
+        // The single dump started before its last packet was sent
+        uint64_t startNs = UINT64_MAX;
+        for (const SimByte &b : sim.serial[s]) {
+            if (b.timeNs >= singleNs && b.data == 0xF0) {
+                startNs = b.timeNs;
+                break;
+            }
+        }
+        CHECK(startNs < singleLastNs);
+#endif
+
+        test_report(("serial" + std::to_string(s) + "_bytes").c_str(), sim.serial[s].size());
+    }
+
+    test_report("sysex_interrupted", interrupted);
+    return test_result();
+}
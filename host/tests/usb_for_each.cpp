@@ -0,0 +1,108 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - FOREACHPACKET TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// USBMidi::forEachPacket() against the simulated PMA: the host fills the receive ring
+// until the endpoint NAKs (the mocked PMA words carry garbage in the upper halves), the
+// iterator must hand over every packet once and in order, leave the packets after an
+// early stop unread, and release the endpoint once it has made room.
+
+#include <vector>
+
+#include <wirish.h>
+#include "usb_midi.h"
+#include "usb_midi_device.h"
+#include "test.h"
+
+static std::vector<uint32_t> received;
+static uint32_t stopAfter = 0;
+
+static uint32_t test_packet(uint32_t n) {
+    return ((n & 0xFFFFFF) << 8) | 0x09;
+}
+
+static uint8_t collect(uint32_t packet) {
+    if (stopAfter == 0) return 0;
+    stopAfter--;
+    received.push_back(packet);
+    return 1;
+}
+
+// Reads up to len packets, stopping after stop of them
+static uint32_t read_packets(USBMidi &midi, uint32_t len, uint32_t stop) {
+    stopAfter = stop;
+    return midi.forEachPacket(collect, len);
+}
+
+// OUT transaction of 16 packets numbered from first
+static bool send_transaction(uint32_t first) {
+    uint32_t packets[16];
+    for (uint32_t i = 0; i < 16; i++) packets[i] = test_packet(first + i);
+    return mock_usb_host_out(packets, 16);
+}
+
+int main() {
+    USBMidi midi;
+
+    mock_reset();
+    midi.begin();
+    CHECK(midi.isConnected());
+
+    CHECK_EQ(midi.forEachPacket(collect, 16), 0);
+    CHECK_EQ(midi.forEachPacket(nullptr, 16), 0);
+
+    // Fill the ring and the PMA buffers
+    uint32_t sent = 0;
+    while (send_transaction(sent)) sent += 16;
+    CHECK(sent >= USB_MIDI_RX_RING_SIZE);
+    CHECK_EQ(midi.available(), USB_MIDI_RX_RING_SIZE);
+
+    // Early stop by the callback and by the length
+    CHECK_EQ(read_packets(midi, 16, 5), 5);
+    CHECK_EQ(read_packets(midi, 3, 16), 3);
+    CHECK_EQ(read_packets(midi, 0, 16), 0);
+    CHECK_EQ(received.size(), 8);
+    CHECK_EQ(midi.available(), USB_MIDI_RX_RING_SIZE - 8);
+
+    // Not enough room yet for a transaction
+    CHECK(!send_transaction(sent));
+
+    // Room for the kept buffers and one more transaction: the iterator re-arms the endpoint
+    CHECK_EQ(read_packets(midi, sent - USB_MIDI_RX_RING_SIZE + 8, UINT32_MAX), sent - USB_MIDI_RX_RING_SIZE + 8);
+    CHECK(send_transaction(sent));
+    sent += 16;
+
+    while (midi.available()) read_packets(midi, 1 + received.size() % 16, UINT32_MAX);
+
+    CHECK_EQ(received.size(), sent);
+    for (uint32_t i = 0; i < received.size() && i < sent; i++) {
+        if (received[i] != test_packet(i)) {
+            CHECK_EQ(received[i], test_packet(i));
+            break;
+        }
+    }
+
+    test_report("ring_packets", USB_MIDI_RX_RING_SIZE);
+    test_report("kept_packets", sent - 16 - USB_MIDI_RX_RING_SIZE);
+    return test_result();
+}
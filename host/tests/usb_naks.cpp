@@ -0,0 +1,118 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - USB NAK SIMULATION
+  ----------------------------------------------------------------------
+
+*/
+
+// Songs with dense chords and with large SysEx dumps, sent faster than the serial port
+// can transmit them: the host is NAKed while the receive buffers are full, but no packet
+// is lost or reordered.
+// Short bursts well below the serial port's rate: the second PMA buffer of the double
+// buffered endpoint holds the last transaction of a burst, which NAKs the host when the
+// endpoint is single buffered.
+
+#include <string>
+
+#include "sketch.h"
+#include "corpus.h"
+#include "sim.h"
+#include "test.h"
+
+static void play(const char *name, const CorpusOptions &options) {
+    std::vector<MidiMessage> song = corpus_song(options);
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+
+    std::vector<WireMessage> wire = sim.wireMessages(1);
+    CHECK_EQ(wire.size(), song.size());
+    for (size_t i = 0; i < wire.size() && i < song.size(); i++) {
+        if (midi_is_note_off(song[i].bytes) && midi_is_note_off(wire[i].bytes)) continue;
+        CHECK(wire[i].bytes == song[i].bytes);
+    }
+
+    test_report((std::string("naks_") + name).c_str(), sim.outNaks);
+    test_report((std::string("nak_ms_") + name).c_str(), sim.nakNs / 1e6);
+    test_report((std::string("transactions_") + name).c_str(), sim.outTransactions);
+}
+
+// Bursts of packets sent at once: a burst of 23 transactions fills the serial transmit
+// buffer, the pending window and the receive ring, and its last transaction stays in the
+// second PMA buffer
+static void bursts(int bursts, int packets, uint64_t intervalNs) {
+    std::vector<MidiMessage> song;
+    for (int b = 0; b < bursts; b++) {
+        for (int i = 0; i < packets; i++) {
+            MidiMessage msg;
+            msg.timeNs = b * intervalNs;
+            msg.port = 0;
+            msg.bytes = { (uint8_t)(0x90 | (i & 0x0F)), (uint8_t)(36 + (i & 0x3F)), (uint8_t)((i & 0x40) ? 0 : 100) };
+            song.push_back(msg);
+        }
+    }
+
+    Sim sim;
+    sim.send(song);
+    sim.begin();
+    CHECK(sim.runUntilIdle(600000000000ULL));
+    uint64_t endNs = mock_now_ns();
+
+    CHECK_EQ(sim.wireMessages(1).size(), song.size());
+    CHECK(sim.inOrder(1));
+
+    // The serial port isn't saturated
+    double utilization = (double)mock_serial_get_stats(1)->busyNs / endNs;
+    CHECK(utilization < 0.5);
+
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+    CHECK_EQ(sim.outNaks, 0);
+#else
+    // Every burst is NAKed until the serial port makes room for its last transaction
+    CHECK(sim.outNaks >= 500 * (uint64_t)bursts);
+#endif
+
+    test_report("naks_burst", sim.outNaks);
+    test_report("nak_ms_burst", sim.nakNs / 1e6);
+    test_report("utilization_burst", utilization);
+}
+
+int main() {
+    CorpusOptions dense;
+    dense.seconds = 10;
+    dense.bpm = 1600;
+    dense.chordChannels = 7;
+    dense.chordNotes = 8;
+    play("dense", dense);
+
+    // Large dumps (i.e. samples or patch banks) between the notes
+    CorpusOptions sysex;
+    sysex.seconds = 20;
+    sysex.sysexBytes = 8192;
+    sysex.sysexEveryBeats = 8;
+    play("sysex", sysex);
+
+    // 23 transactions every 2 seconds (about 20% of the serial port's rate)
+    bursts(5, 23 * 16, 2000000000ULL);
+
+    return test_result();
+}
@@ -0,0 +1,128 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - USB RECEIVE STRESS TEST
+  ----------------------------------------------------------------------
+
+*/
+
+// The host thread sends numbered packets in OUT transactions of random size (the RX
+// callback runs in this thread, like an interrupt), while the main thread reads them in
+// random batches and sometimes leaves packets unread. Every packet must be read exactly
+// once and in order, the received PMA buffers kept while midiRingRx is full must be
+// retried under nvic_irq_disable().
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include <wirish.h>
+#include "usb_midi.h"
+#include "usb_midi_device.h"
+#include "test.h"
+
+#define STRESS_PACKETS 200000
+
+static uint32_t stressNext = 0;
+static std::mt19937 stressRandom(1);
+
+static uint32_t stress_packet(uint32_t n) {
+    return (n << 8) | 0x0F;
+}
+
+static uint8_t stress_read(uint32_t packet) {
+    // Leave some packets unread (like when the serial ports are full)
+    if (stressRandom() % 16 == 0) return 0;
+
+    CHECK_EQ(packet, stress_packet(stressNext));
+    stressNext++;
+    return 1;
+}
+
+int main() {
+    USBMidi midi;
+
+    mock_reset();
+    midi.begin();
+    CHECK(midi.isConnected());
+
+    std::atomic<bool> failed(false);
+    std::atomic<uint64_t> naks(0);
+
+    std::thread host([&]() {
+        std::mt19937 random(2);
+        uint32_t packets[16];
+        uint32_t sent = 0;
+
+        while (sent < STRESS_PACKETS && !failed) {
+            uint32_t count = 1 + random() % 16;
+            if (count > STRESS_PACKETS - sent) count = STRESS_PACKETS - sent;
+            for (uint32_t i = 0; i < count; i++) packets[i] = stress_packet(sent + i);
+
+            while (!mock_usb_host_out(packets, count)) {
+                naks++;
+                if (failed) return;
+                std::this_thread::yield();
+            }
+            sent += count;
+        }
+    });
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    uint32_t buf[16];
+
+    while (stressNext < STRESS_PACKETS) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            fprintf(stderr, "stress: stuck at packet %u\n", stressNext);
+            failed = true;
+            testFailures++;
+            break;
+        }
+
+        if (!usb_midi_data_available()) {
+            // Unlike an interrupt, the other thread may see the advanced read index late,
+            // so the kept PMA buffers are also retried when there is nothing to read
+            usb_midi_mark_read(0);
+            continue;
+        }
+
+        if (stressRandom() % 4 == 0) {
+            // Peek and mark read
+            uint32_t n = usb_midi_peek(buf, 1 + stressRandom() % 16);
+            for (uint32_t i = 0; i < n; i++) CHECK_EQ(buf[i], stress_packet(stressNext + i));
+            stressNext += n;
+            usb_midi_mark_read(n);
+        } else {
+            usb_midi_for_each(stress_read, 1 + stressRandom() % 16);
+        }
+
+        if (testFailures) {
+            failed = true;
+            break;
+        }
+    }
+
+    host.join();
+
+    CHECK_EQ(stressNext, STRESS_PACKETS);
+    CHECK_EQ(usb_midi_data_available(), 0);
+    test_report("naks", naks);
+    return test_result();
+}
@@ -0,0 +1,55 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - CORPUS TOOL
+  ----------------------------------------------------------------------
+
+*/
+
+// Writes a generated song (see corpus.h) to a Standard MIDI File
+// wbcorpus PRESET PORTS SECONDS OUTPUT.mid
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "corpus.h"
+#include "smf.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s gm|dense|automation|sysex|clock PORTS SECONDS OUTPUT.mid\n", argv[0]);
+        return 2;
+    }
+
+    CorpusOptions options;
+    int ports = atoi(argv[2]);
+    int seconds = atoi(argv[3]);
+    if (ports < 1 || ports > 16 || seconds < 1 || !corpus_preset(argv[1], ports, seconds, options)) {
+        fprintf(stderr, "%s: invalid song\n", argv[0]);
+        return 2;
+    }
+
+    std::string error;
+    if (!smf_write(argv[4], corpus_song(options), error)) {
+        fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+        return 1;
+    }
+    return 0;
+}
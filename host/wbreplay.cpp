@@ -0,0 +1,132 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  HOST BUILD - REPLAY TOOL
+  ----------------------------------------------------------------------
+
+*/
+
+// Plays a Standard MIDI File through the USB packet path of the firmware
+// wbreplay [-o PREFIX] [-s STATS] INPUT.mid
+//   -o PREFIX  write the bytes transmitted on each serial port to PREFIX.<port>.bin
+//   -s STATS   write the statistics to the file (instead of the standard output)
+// The statistics are "key=value" lines.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+#include "sketch.h"
+#include "sim.h"
+#include "smf.h"
+
+static void replay_stats(FILE *f, Sim &sim, uint64_t durationNs) {
+    fprintf(f, "messages=%zu\n", sim.sentMessages.size());
+    fprintf(f, "packets=%zu\n", sim.sent.size());
+    fprintf(f, "duration_ms=%.3f\n", durationNs / 1e6);
+    fprintf(f, "out_transactions=%llu\n", (unsigned long long)sim.outTransactions);
+    fprintf(f, "out_naks=%llu\n", (unsigned long long)sim.outNaks);
+    fprintf(f, "nak_ms=%.3f\n", sim.nakNs / 1e6);
+
+    std::vector<uint64_t> delays;
+    for (const SimPacket &p : sim.sent) delays.push_back(p.ackNs - p.dueNs);
+    fprintf(f, "usb_delay_p99_us=%.1f\n", sim_percentile(delays, 99) / 1e3);
+    fprintf(f, "usb_delay_max_us=%.1f\n", sim_percentile(delays, 100) / 1e3);
+
+    for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+        if (serialSpeed[s] == 0) continue;
+
+        const mock_serial_stats *stats = mock_serial_get_stats(s);
+        std::vector<uint64_t> latency;
+        for (const SimLatency &l : sim.latencies(s)) latency.push_back(l.wireNs - l.dueNs);
+
+        fprintf(f, "serial%u_bytes=%llu\n", s + 1, (unsigned long long)stats->txBytes);
+        fprintf(f, "serial%u_utilization=%.2f\n", s + 1, durationNs ? 100.0 * stats->busyNs / durationNs : 0.0);
+        fprintf(f, "serial%u_blocked_writes=%llu\n", s + 1, (unsigned long long)stats->blockedWrites);
+        fprintf(f, "serial%u_messages=%zu\n", s + 1, latency.size());
+        fprintf(f, "serial%u_latency_p50_us=%.1f\n", s + 1, sim_percentile(latency, 50) / 1e3);
+        fprintf(f, "serial%u_latency_p99_us=%.1f\n", s + 1, sim_percentile(latency, 99) / 1e3);
+        fprintf(f, "serial%u_latency_max_us=%.1f\n", s + 1, sim_percentile(latency, 100) / 1e3);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *prefix = NULL;
+    const char *statsPath = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:s:")) != -1) {
+        switch (opt) {
+            case 'o': prefix = optarg; break;
+            case 's': statsPath = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-o PREFIX] [-s STATS] INPUT.mid\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: %s [-o PREFIX] [-s STATS] INPUT.mid\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<MidiMessage> messages;
+    std::string error;
+    if (!smf_read(argv[optind], messages, error)) {
+        fprintf(stderr, "%s: %s\n", argv[0], error.c_str());
+        return 1;
+    }
+
+    Sim sim;
+    sim.send(messages);
+    sim.begin();
+
+    // Start of the song is the time after the enumeration
+    uint64_t start = mock_now_ns();
+    uint64_t end = messages.empty() ? 0 : messages.back().timeNs;
+    if (!sim.runUntilIdle(start + end + 600000000000ULL)) {
+        fprintf(stderr, "%s: the replay didn't finish\n", argv[0]);
+        return 1;
+    }
+
+    if (prefix != NULL) {
+        for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+            if (serialSpeed[s] == 0) continue;
+
+            std::string path = std::string(prefix) + "." + std::to_string(s + 1) + ".bin";
+            FILE *f = fopen(path.c_str(), "wb");
+            if (f == NULL) {
+                fprintf(stderr, "%s: can't write %s\n", argv[0], path.c_str());
+                return 1;
+            }
+            for (const SimByte &b : sim.serial[s]) fputc(b.data, f);
+            fclose(f);
+        }
+    }
+
+    FILE *f = stdout;
+    if (statsPath != NULL && (f = fopen(statsPath, "w")) == NULL) {
+        fprintf(stderr, "%s: can't write %s\n", argv[0], statsPath);
+        return 1;
+    }
+    replay_stats(f, sim, mock_now_ns() - start);
+    if (f != stdout) fclose(f);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  LATENCY HISTOGRAMS
+  ----------------------------------------------------------------------
+
+*/
+
+#include "latency.h"
+
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+
+// Number of measured latencies in each bucket of each histogram
+static volatile uint32_t latencyCounts[LATENCY_HISTOGRAMS][LATENCY_BUCKETS];
+
+// Get the histogram of the USB MIDI port and message class of the packet
+// The USB MIDI port of the packet must be lower than USB_MIDI_IO_PORT_NUM
+uint8_t latency_histogram(uint32_t packet) {
+    uint8_t port = (packet >> 4) & 0x0F;
+    uint8_t cin = packet & 0x0F;
+    uint8_t status = (packet >> 8) & 0xFF;
+    uint8_t cls;
+
+    if (cin == 0x08 || cin == 0x09) {
+        cls = LATENCY_CLASS_NOTE;
+    } else if (cin >= 0x0A && cin <= 0x0E) {
+        cls = LATENCY_CLASS_CHANNEL;
+    } else if (cin == 0x04 || cin == 0x06 || cin == 0x07 || (cin == 0x05 && status == 0xF7)) {
+        cls = LATENCY_CLASS_SYSEX;
+    } else if (status >= 0xF8) {
+        cls = LATENCY_CLASS_REALTIME;
+    } else {
+        cls = LATENCY_CLASS_COMMON;
+    }
+
+    return port * LATENCY_CLASSES + cls;
+}
+
+// Get the bucket of the latency
+uint8_t latency_bucket(uint32_t cycles) {
+    uint32_t us = cycles / CYCLES_PER_MICROSECOND;
+
+    if (us == 0) {
+        return 0;
+    }
+
+    uint8_t bucket = 32 - __builtin_clz(us);
+    return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+void latency_record(uint8_t histogram, uint32_t cycles) {
+    latencyCounts[histogram][latency_bucket(cycles)]++;
+}
+
+void latency_reset(void) {
+    noInterrupts();
+    for (uint8_t h = 0; h < LATENCY_HISTOGRAMS; h++) {
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+            latencyCounts[h][b] = 0;
+        }
+    }
+    interrupts();
+}
+
+uint32_t latency_count(uint8_t histogram, uint8_t bucket) {
+    return latencyCounts[histogram][bucket];
+}
+
+#endif
@@ -0,0 +1,61 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  LATENCY HISTOGRAMS
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+#pragma once
+
+#include <wirish.h>
+
+#include "usb_midi_device.h"
+
+// --------------------------------------------------------------------------------------
+// Latency histograms API
+// --------------------------------------------------------------------------------------
+// Latency (in CPU cycles) from USB reception of a packet to serial transmission of its
+// last byte is counted in histograms for each USB MIDI port and message class.
+// Bucket 0 counts latencies below 1 us, bucket n counts latencies from 2^(n-1) us
+// to 2^n us, the last bucket also counts all longer latencies (from about 4 s, so that
+// the latencies of a saturated serial port are still told apart).
+// latency_record() can be called from interrupt handlers.
+
+enum {
+    LATENCY_CLASS_NOTE = 0,     // Note On/Off
+    LATENCY_CLASS_CHANNEL,      // Other Channel messages
+    LATENCY_CLASS_SYSEX,        // SysEx
+    LATENCY_CLASS_COMMON,       // System Common messages
+    LATENCY_CLASS_REALTIME,     // System RealTime messages
+    LATENCY_CLASSES
+};
+
+#define LATENCY_BUCKETS    24
+#define LATENCY_HISTOGRAMS (USB_MIDI_IO_PORT_NUM * LATENCY_CLASSES)
+
+uint8_t  latency_histogram(uint32_t packet);
+uint8_t  latency_bucket(uint32_t cycles);
+void     latency_record(uint8_t histogram, uint32_t cycles);
+void     latency_reset(void);
+uint32_t latency_count(uint8_t histogram, uint8_t bucket);
+
+#endif
@@ -0,0 +1,67 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  PERFORMANCE COUNTERS
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+#pragma once
+
+#include <stdint.h>
+
+#include "hardware_config.h"
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// --------------------------------------------------------------------------------------
+// Performance counters
+// --------------------------------------------------------------------------------------
+// Counters are only incremented, they wrap around. Shared by C and C++ code,
+// PERF_COUNT() compiles to nothing when the counters are disabled.
+
+#if defined(CFG_PERF_COUNTERS) && CFG_PERF_COUNTERS > 0
+
+typedef struct {
+    uint32_t usbRxPackets;              // Packets received from USB
+    uint32_t usbRxNakPeriods;           // Times the host was NAKed because the receive buffer was full
+    uint32_t usbDroppedPackets;         // Packets from unused USB MIDI ports or with invalid CIN
+    uint32_t serialStalls;              // Times packets were left in the receive buffer because serial ports were busy
+    uint32_t runningStatusSavedBytes;   // Status bytes not sent thanks to Running Status
+    uint32_t portSelections;            // Port Selection messages "F5 nn" sent
+    uint32_t serialBytes[SERIAL_INTERFACE_MAX]; // Bytes written to each serial port
+} perf_counters_t;
+
+extern volatile perf_counters_t perfCounters;
+
+ #define PERF_COUNT(counter, n) (perfCounters.counter += (n))
+#else
+ #define PERF_COUNT(counter, n) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  PROFILER
+  ----------------------------------------------------------------------
+
+*/
+
+#include "profiler.h"
+
+#if defined(CFG_PROFILER) && CFG_PROFILER > 0
+
+#include <libmaple/nvic.h>
+
+volatile profiler_stat_t profilerStats[PROFILER_SECTIONS];
+
+// Add the cycles of one run of the section
+// Sections profiled in interrupt handlers must not be profiled in usercode
+void profiler_record(uint8_t section, uint32_t cycles) {
+    volatile profiler_stat_t *stat = &profilerStats[section];
+
+    if (stat->count == 0 || cycles < stat->min) {
+        stat->min = cycles;
+    }
+    if (cycles > stat->max) {
+        stat->max = cycles;
+    }
+    stat->total += cycles;
+    stat->count++;
+}
+
+void profiler_reset(void) {
+    uint8_t section;
+
+    nvic_globalirq_disable();
+    for (section = 0; section < PROFILER_SECTIONS; section++) {
+        profilerStats[section].count = 0;
+        profilerStats[section].min = 0;
+        profilerStats[section].max = 0;
+        profilerStats[section].total = 0;
+    }
+    nvic_globalirq_enable();
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  PROFILER
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+#pragma once
+
+#include <stdint.h>
+
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// --------------------------------------------------------------------------------------
+// Profiler
+// --------------------------------------------------------------------------------------
+// Minimum, average and maximum number of CPU cycles of profiled sections, measured
+// with the DWT cycle counter. The macros compile to nothing when the profiler is disabled.
+// PROFILER_BEGIN() / PROFILER_END() enclose a section in C code,
+// PROFILER_SCOPE() profiles the rest of the enclosing block in C++ code.
+
+enum {
+    PROFILER_LOOP = 0,          // loop() iteration
+    PROFILER_PROCESS_PACKET,    // ProcessPacket() call
+    PROFILER_USB_RX,            // usb_midi_DataRxCb() interrupt
+    PROFILER_USB_TX,            // usb_midi_DataTxCb() interrupt
+    PROFILER_SECTIONS
+};
+
+#if defined(CFG_PROFILER) && CFG_PROFILER > 0
+
+#include "cycle_counter.h"
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} profiler_stat_t;
+
+extern volatile profiler_stat_t profilerStats[PROFILER_SECTIONS];
+
+void profiler_record(uint8_t section, uint32_t cycles);
+void profiler_reset(void);
+
+ #define PROFILER_BEGIN()       uint32_t profilerStart = cycle_counter_now()
+ #define PROFILER_END(section)  profiler_record((section), cycle_counter_now() - profilerStart)
+#else
+ #define PROFILER_BEGIN()       ((void)0)
+ #define PROFILER_END(section)  ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+
+#if defined(CFG_PROFILER) && CFG_PROFILER > 0
+// Records the cycles from construction to destruction
+class ProfilerScope {
+private:
+    uint8_t section;
+    uint32_t start;
+
+public:
+    ProfilerScope(uint8_t s) : section(s), start(cycle_counter_now()) {}
+    ~ProfilerScope() { profiler_record(section, cycle_counter_now() - start); }
+};
+
+ #define PROFILER_SCOPE(section) ProfilerScope profilerScope(section)
+#else
+ #define PROFILER_SCOPE(section) ((void)0)
+#endif
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  SERIAL PORTS RECEPTION
+  ----------------------------------------------------------------------
+
+*/
+
+#include "serial_rx.h"
+
+// --------------------------------------------------------------------------------------
+// SERIAL PORT STATE
+// --------------------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t status;   // Running status (or status of System Common message), 0 if none
+    uint8_t needed;   // Number of data bytes of the message
+    uint8_t count;    // Number of bytes in the buffer
+    uint8_t sysEx;    // SysEx was started and not ended yet
+    uint8_t data[3];
+} serialRxState_t;
+
+static serialRxState_t rxState[SERIAL_INTERFACE_MAX];
+
+// Make USB MIDI packet from code index number and bytes
+static inline uint32_t MakePacket(uint8_t cin, const uint8_t *data, uint8_t len)
+{
+    uint32_t packet = cin;
+
+    for ( uint8_t i = 0; i < len; i++ ) packet |= ((uint32_t)data[i]) << (8 * (i + 1));
+
+    return packet;
+}
+
+void serial_rx_reset(uint8_t s)
+{
+    if ( s >= SERIAL_INTERFACE_MAX ) return;
+
+    rxState[s].status = 0;
+    rxState[s].needed = 0;
+    rxState[s].count = 0;
+    rxState[s].sysEx = 0;
+}
+
+uint8_t serial_rx_parse(uint8_t s, uint8_t data, uint32_t *packet)
+{
+    serialRxState_t *state = &rxState[s];
+
+    // System RealTime
+    if ( data >= 0xF8 )
+    {
+        *packet = MakePacket(0x0F, &data, 1);
+        return SERIAL_RX_PACKET;
+    }
+
+    // Status byte
+    if ( data >= 0x80 )
+    {
+        if ( data == 0xF7 || state->sysEx )
+        {
+            state->status = 0;
+            if ( !state->sysEx ) return 0;
+
+            // SysEx ends with following single-byte, two-byte or three-byte
+            // (SysEx interrupted by another status byte is ended before the status byte is parsed again)
+            state->data[state->count++] = 0xF7;
+            *packet = MakePacket(0x04 + state->count, state->data, state->count);
+            state->count = 0;
+            state->sysEx = 0;
+            return ( data == 0xF7 ) ? SERIAL_RX_PACKET : SERIAL_RX_PACKET | SERIAL_RX_AGAIN;
+        }
+
+        state->count = 0;
+
+        if ( data == 0xF0 )
+        {
+            state->status = 0;
+            state->sysEx = 1;
+            state->data[state->count++] = data;
+            return 0;
+        }
+
+        if ( data == 0xF6 )
+        {
+            state->status = 0;
+            *packet = MakePacket(0x05, &data, 1);
+            return SERIAL_RX_PACKET;
+        }
+
+        if ( data == 0xF4 || data == 0xF5 )
+        {
+            // Undefined
+            state->status = 0;
+            return 0;
+        }
+
+        state->status = data;
+        if ( data >= 0xF0 ) state->needed = ( data == 0xF2 ) ? 2 : 1;
+        else state->needed = ( data >= 0xC0 && data < 0xE0 ) ? 1 : 2;
+        state->data[state->count++] = data;
+        return 0;
+    }
+
+    // Data byte
+    if ( state->sysEx )
+    {
+        state->data[state->count++] = data;
+        if ( state->count < 3 ) return 0;
+
+        *packet = MakePacket(0x04, state->data, 3);
+        state->count = 0;
+        return SERIAL_RX_PACKET;
+    }
+
+    if ( state->status == 0 ) return 0;
+
+    // Running status
+    if ( state->count == 0 ) state->data[state->count++] = state->status;
+
+    state->data[state->count++] = data;
+    if ( state->count <= state->needed ) return 0;
+
+    if ( state->status >= 0xF0 )
+    {
+        // System Common messages cancel the running status
+        *packet = MakePacket(( state->needed == 1 ) ? 0x02 : 0x03, state->data, state->count);
+        state->status = 0;
+    }
+    else
+    {
+        *packet = MakePacket(state->status >> 4, state->data, state->count);
+    }
+    state->count = 0;
+    return SERIAL_RX_PACKET;
+}
@@ -0,0 +1,50 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  SERIAL PORTS RECEPTION
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _SERIAL_RX_H_
+#define _SERIAL_RX_H_
+#pragma once
+
+#include <wirish.h>
+
+#include "hardware_config.h"
+
+// --------------------------------------------------------------------------------------
+// Serial reception API
+// --------------------------------------------------------------------------------------
+// Bytes received from a serial port are assembled into USB MIDI packets (with cable
+// number 0). Running status is expanded, System RealTime bytes are returned
+// immediately, even inside other messages. SysEx is split into packets of 3 bytes,
+// a SysEx interrupted by another status byte is ended with F7 first (the host may
+// have received its first packets already).
+// serial_rx_parse() returns SERIAL_RX_PACKET when a packet is complete, and also
+// SERIAL_RX_AGAIN when the byte must be parsed again (after the end of SysEx).
+
+#define SERIAL_RX_PACKET 0x01
+#define SERIAL_RX_AGAIN  0x02
+
+void     serial_rx_reset(uint8_t s);
+uint8_t  serial_rx_parse(uint8_t s, uint8_t data, uint32_t *packet);
+
+#endif
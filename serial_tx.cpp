@@ -0,0 +1,371 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  SERIAL PORTS TRANSMISSION
+  ----------------------------------------------------------------------
+
+*/
+
+#include "serial_tx.h"
+#include <libmaple/dma.h>
+#include <libmaple/usart.h>
+
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+ #include "cycle_counter.h"
+ #include "latency.h"
+ #define SERIAL_TX_LATENCY
+#endif
+
+// --------------------------------------------------------------------------------------
+// SERIAL PORT STATE
+// --------------------------------------------------------------------------------------
+// Bytes are queued in a ring buffer by serial_tx_write(). A contiguous part of the
+// queued bytes (at most SERIAL_TX_MAX_CHUNK bytes) is handed to the DMA channel of the
+// USART, the DMA transfer complete interrupt frees it and starts the next part.
+// System RealTime bytes are queued in a separate small ring buffer, which is served
+// first, so they wait for at most one part of the other bytes.
+
+// Maximum number of bytes in one DMA transfer from the transmit buffer
+// (smaller parts only matter for System RealTime bytes, but cost more interrupts)
+#if defined(CFG_SERIAL_REALTIME_EXPRESS) && CFG_SERIAL_REALTIME_EXPRESS > 0
+ #define SERIAL_TX_MAX_CHUNK CFG_SERIAL_REALTIME_EXPRESS
+#else
+ #define SERIAL_TX_MAX_CHUNK SERIAL_TX_BUFFER_SIZE
+#endif
+
+// Size of the System RealTime buffer of each serial port (power of 2)
+#define SERIAL_TX_REALTIME_SIZE 8
+
+// Called while waiting for the DMA interrupt to free buffer space
+// (the host build advances its clock here)
+#ifndef SERIAL_TX_WAIT
+ #define SERIAL_TX_WAIT()
+#endif
+
+#ifdef SERIAL_TX_LATENCY
+// Message whose latency is recorded when its last byte is transmitted
+typedef struct {
+    uint32_t start;     // Cycle counter at reception of the message
+    uint16_t end;       // Index after the last byte of the message (lowest 16 bits)
+    uint8_t histogram;
+} serial_tx_mark_t;
+
+// Marked messages waiting for transmission
+typedef struct {
+    serial_tx_mark_t *mark;
+    uint32_t size;                      // Number of marks (power of 2)
+    volatile uint32_t head;             // Write index into mark (free running, only modified by usercode)
+    volatile uint32_t tail;             // Read index into mark (free running, only modified by DMA interrupt)
+} serial_tx_marks;
+#endif
+
+typedef struct {
+    HardwareSerial *serial;
+    dma_dev *dma;                       // NULL when the port uses HardwareSerial
+    dma_channel channel;
+    volatile uint32_t head;             // Write index into buffer (free running, only modified by usercode)
+    volatile uint32_t tail;             // Read index into buffer (free running, only modified by DMA interrupt)
+    volatile uint32_t chunk;            // Number of bytes in the running DMA transfer (0 = DMA is idle)
+    volatile uint32_t realtimeHead;     // Write index into realtime (free running, only modified by usercode)
+    volatile uint32_t realtimeTail;     // Read index into realtime (free running, only modified by DMA interrupt)
+    volatile bool chunkRealtime;        // The running DMA transfer is from realtime
+#if defined(CFG_SERIAL_DMA_TX) && CFG_SERIAL_DMA_TX > 0
+    uint8_t buffer[SERIAL_TX_BUFFER_SIZE];
+    uint8_t realtime[SERIAL_TX_REALTIME_SIZE];
+#endif
+#ifdef SERIAL_TX_LATENCY
+    serial_tx_marks marks;
+    serial_tx_marks realtimeMarks;
+    // A marked message has at least one byte, so there's a mark for each byte of the buffers
+    serial_tx_mark_t markBuffer[SERIAL_TX_BUFFER_SIZE];
+    serial_tx_mark_t realtimeMarkBuffer[SERIAL_TX_REALTIME_SIZE];
+#endif
+} serial_tx_state;
+
+static serial_tx_state serialTx[SERIAL_INTERFACE_MAX];
+
+#ifdef SERIAL_TX_LATENCY
+// Mark the message ending at the index, blocks while all marks are in use
+// (only while the transmit buffer is full too)
+static void serial_tx_marks_push(serial_tx_marks *marks, uint32_t end, uint32_t start, uint8_t histogram) {
+    uint32_t head = marks->head;
+    while (head - marks->tail >= marks->size) SERIAL_TX_WAIT();
+
+    serial_tx_mark_t *mark = &marks->mark[head & (marks->size - 1)];
+    mark->end = end;
+    mark->start = start;
+    mark->histogram = histogram;
+    marks->head = head + 1;
+}
+#endif
+
+#if defined(CFG_SERIAL_DMA_TX) && CFG_SERIAL_DMA_TX > 0
+
+static void serial_tx_dma_transfer(serial_tx_state *tx, uint8_t *data, uint32_t len) {
+    tx->chunk = len;
+    dma_disable(tx->dma, tx->channel);
+    dma_set_mem_addr(tx->dma, tx->channel, data);
+    dma_set_num_transfers(tx->dma, tx->channel, len);
+    dma_enable(tx->dma, tx->channel);
+}
+
+// Start DMA transfer of the queued bytes, if there are any.
+// Must not be interrupted by the DMA interrupt of the port.
+static void serial_tx_start(serial_tx_state *tx) {
+    uint32_t queued = tx->realtimeHead - tx->realtimeTail;
+
+    if (queued != 0) {
+        uint32_t index = tx->realtimeTail & (SERIAL_TX_REALTIME_SIZE - 1);
+        uint32_t len = SERIAL_TX_REALTIME_SIZE - index;
+        if (len > queued) len = queued;
+
+        tx->chunkRealtime = true;
+        serial_tx_dma_transfer(tx, &tx->realtime[index], len);
+        return;
+    }
+
+    queued = tx->head - tx->tail;
+
+    if (queued == 0) {
+        tx->chunk = 0;
+        return;
+    }
+
+    uint32_t index = tx->tail & (SERIAL_TX_BUFFER_SIZE - 1);
+    uint32_t len = SERIAL_TX_BUFFER_SIZE - index;
+    if (len > queued) len = queued;
+    if (len > SERIAL_TX_MAX_CHUNK) len = SERIAL_TX_MAX_CHUNK;
+
+    tx->chunkRealtime = false;
+    serial_tx_dma_transfer(tx, &tx->buffer[index], len);
+}
+
+#ifdef SERIAL_TX_LATENCY
+// Record the latency of marked messages whose last byte was transmitted
+static void serial_tx_marks_complete(serial_tx_marks *marks, uint32_t sent) {
+    uint32_t now = cycle_counter_now();
+    uint32_t tail = marks->tail;
+
+    while (tail != marks->head) {
+        serial_tx_mark_t *mark = &marks->mark[tail & (marks->size - 1)];
+        if ((int16_t)(uint16_t)(sent - mark->end) < 0) break;
+
+        latency_record(mark->histogram, now - mark->start);
+        tail++;
+    }
+
+    marks->tail = tail;
+}
+#endif
+
+// DMA transfer complete
+static void serial_tx_complete(serial_tx_state *tx) {
+    if (tx->chunkRealtime) {
+        tx->realtimeTail += tx->chunk;
+#ifdef SERIAL_TX_LATENCY
+        serial_tx_marks_complete(&tx->realtimeMarks, tx->realtimeTail);
+#endif
+    } else {
+        tx->tail += tx->chunk;
+#ifdef SERIAL_TX_LATENCY
+        serial_tx_marks_complete(&tx->marks, tx->tail);
+#endif
+    }
+    serial_tx_start(tx);
+}
+
+static void serial_tx_dma_irq_0(void) { serial_tx_complete(&serialTx[0]); }
+#if SERIAL_INTERFACE_MAX >= 2
+static void serial_tx_dma_irq_1(void) { serial_tx_complete(&serialTx[1]); }
+#endif
+#if SERIAL_INTERFACE_MAX >= 3
+static void serial_tx_dma_irq_2(void) { serial_tx_complete(&serialTx[2]); }
+#endif
+#if SERIAL_INTERFACE_MAX >= 4
+static void serial_tx_dma_irq_3(void) { serial_tx_complete(&serialTx[3]); }
+#endif
+
+static void (* const serial_tx_dma_irq[SERIAL_INTERFACE_MAX])(void) = {
+    serial_tx_dma_irq_0,
+#if SERIAL_INTERFACE_MAX >= 2
+    serial_tx_dma_irq_1,
+#endif
+#if SERIAL_INTERFACE_MAX >= 3
+    serial_tx_dma_irq_2,
+#endif
+#if SERIAL_INTERFACE_MAX >= 4
+    serial_tx_dma_irq_3,
+#endif
+};
+
+#endif
+
+// --------------------------------------------------------------------------------------
+// SERIAL TRANSMISSION API
+// --------------------------------------------------------------------------------------
+
+// Call after HardwareSerial::begin()
+void serial_tx_begin(uint8_t s, HardwareSerial *serial) {
+    serial_tx_state *tx = &serialTx[s];
+
+    tx->serial = serial;
+    tx->dma = NULL;
+    tx->head = 0;
+    tx->tail = 0;
+    tx->chunk = 0;
+    tx->realtimeHead = 0;
+    tx->realtimeTail = 0;
+    tx->chunkRealtime = false;
+#ifdef SERIAL_TX_LATENCY
+    tx->marks.mark = tx->markBuffer;
+    tx->marks.size = SERIAL_TX_BUFFER_SIZE;
+    tx->marks.head = tx->marks.tail = 0;
+    tx->realtimeMarks.mark = tx->realtimeMarkBuffer;
+    tx->realtimeMarks.size = SERIAL_TX_REALTIME_SIZE;
+    tx->realtimeMarks.head = tx->realtimeMarks.tail = 0;
+#endif
+
+#if defined(CFG_SERIAL_DMA_TX) && CFG_SERIAL_DMA_TX > 0
+    // USART TX DMA channels on STM32F1
+    usart_dev *dev = serial->c_dev();
+    if (dev == USART1) {
+        tx->dma = DMA1;
+        tx->channel = DMA_CH4;
+    } else if (dev == USART2) {
+        tx->dma = DMA1;
+        tx->channel = DMA_CH7;
+    } else if (dev == USART3) {
+        tx->dma = DMA1;
+        tx->channel = DMA_CH2;
+    } else {
+        return;
+    }
+
+    dma_init(tx->dma);
+    dma_setup_transfer(tx->dma, tx->channel, &dev->regs->DR, DMA_SIZE_8BITS,
+                       tx->buffer, DMA_SIZE_8BITS, DMA_MINC_MODE | DMA_FROM_MEM | DMA_TRNS_CMPLT);
+    dma_attach_interrupt(tx->dma, tx->channel, serial_tx_dma_irq[s]);
+
+    // USART requests DMA transfer when the data register is empty
+    dev->regs->CR3 |= USART_CR3_DMAT;
+#endif
+}
+
+// Whether the serial port transmits using DMA
+bool serial_tx_dma(uint8_t s) {
+    return serialTx[s].dma != NULL;
+}
+
+// Number of bytes which can be written without blocking
+uint32_t serial_tx_available_for_write(uint8_t s) {
+    serial_tx_state *tx = &serialTx[s];
+
+    if (tx->dma == NULL) {
+        return tx->serial->availableForWrite();
+    }
+
+    return SERIAL_TX_BUFFER_SIZE - (tx->head - tx->tail);
+}
+
+// Number of bytes waiting for transmission
+uint32_t serial_tx_queued(uint8_t s) {
+    serial_tx_state *tx = &serialTx[s];
+
+    if (tx->dma == NULL) {
+        return rb_full_count(tx->serial->c_dev()->wb);
+    }
+
+    return tx->head - tx->tail;
+}
+
+// Queue bytes for transmission, blocks while the buffer is full
+void serial_tx_write(uint8_t s, const uint8_t *data, uint32_t len) {
+    serial_tx_state *tx = &serialTx[s];
+
+    if (tx->dma == NULL) {
+        tx->serial->write(data, len);
+        return;
+    }
+
+#if defined(CFG_SERIAL_DMA_TX) && CFG_SERIAL_DMA_TX > 0
+    while (len) {
+        uint32_t head = tx->head;
+        uint32_t free = SERIAL_TX_BUFFER_SIZE - (head - tx->tail);
+        if (free == 0) {
+            SERIAL_TX_WAIT();
+            continue;
+        }
+        if (free > len) free = len;
+
+        for (uint32_t i = 0; i < free; i++) {
+            tx->buffer[(head + i) & (SERIAL_TX_BUFFER_SIZE - 1)] = data[i];
+        }
+        data += free;
+        len -= free;
+
+        noInterrupts();
+        tx->head = head + free;
+        if (tx->chunk == 0) serial_tx_start(tx);
+        interrupts();
+    }
+#endif
+}
+
+// Queue System RealTime byte for transmission ahead of the bytes queued by serial_tx_write(),
+// blocks while the realtime buffer is full
+void serial_tx_write_realtime(uint8_t s, uint8_t data) {
+    serial_tx_state *tx = &serialTx[s];
+
+    if (tx->dma == NULL) {
+        tx->serial->write(data);
+        return;
+    }
+
+#if defined(CFG_SERIAL_DMA_TX) && CFG_SERIAL_DMA_TX > 0
+    uint32_t head = tx->realtimeHead;
+    while (head - tx->realtimeTail >= SERIAL_TX_REALTIME_SIZE) SERIAL_TX_WAIT();
+
+    tx->realtime[head & (SERIAL_TX_REALTIME_SIZE - 1)] = data;
+
+    noInterrupts();
+    tx->realtimeHead = head + 1;
+    if (tx->chunk == 0) serial_tx_start(tx);
+    interrupts();
+#endif
+}
+
+#ifdef SERIAL_TX_LATENCY
+// Call before serial_tx_write() of the message
+void serial_tx_mark(uint8_t s, uint32_t len, uint32_t start, uint8_t histogram) {
+    serial_tx_state *tx = &serialTx[s];
+
+    if (tx->dma == NULL) return;
+
+    serial_tx_marks_push(&tx->marks, tx->head + len, start, histogram);
+}
+
+// Call before serial_tx_write_realtime() of the message
+void serial_tx_mark_realtime(uint8_t s, uint32_t start, uint8_t histogram) {
+    serial_tx_state *tx = &serialTx[s];
+
+    if (tx->dma == NULL) return;
+
+    serial_tx_marks_push(&tx->realtimeMarks, tx->realtimeHead + 1, start, histogram);
+}
+#endif
@@ -0,0 +1,69 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  SERIAL PORTS TRANSMISSION
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _SERIAL_TX_H_
+#define _SERIAL_TX_H_
+#pragma once
+
+#include <wirish.h>
+
+#include "hardware_config.h"
+#include "config.h"
+
+// Size of the transmit buffer of each serial port (power of 2)
+#ifdef CFG_SERIAL_TX_BUFFER_SIZE
+ #define SERIAL_TX_BUFFER_SIZE CFG_SERIAL_TX_BUFFER_SIZE
+#else
+ #define SERIAL_TX_BUFFER_SIZE 256
+#endif
+
+#if (SERIAL_TX_BUFFER_SIZE & (SERIAL_TX_BUFFER_SIZE - 1)) != 0
+ #error "SERIAL_TX_BUFFER_SIZE must be a power of 2"
+#endif
+
+// --------------------------------------------------------------------------------------
+// Serial transmission API
+// --------------------------------------------------------------------------------------
+// Serial ports are identified by their index in the serial interfaces array.
+// With DMA transmission enabled, USART1, USART2 and USART3 transmit from a buffer
+// using DMA, other serial ports use HardwareSerial.
+// System RealTime bytes written by serial_tx_write_realtime() are transmitted before
+// the bytes queued by serial_tx_write() (only with DMA transmission).
+
+void     serial_tx_begin(uint8_t s, HardwareSerial *serial);
+bool     serial_tx_dma(uint8_t s);
+uint32_t serial_tx_available_for_write(uint8_t s);
+uint32_t serial_tx_queued(uint8_t s);
+void     serial_tx_write(uint8_t s, const uint8_t *data, uint32_t len);
+void     serial_tx_write_realtime(uint8_t s, uint8_t data);
+
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+// The latency of the bytes written next by serial_tx_write() (or serial_tx_write_realtime())
+// is recorded in the histogram when the DMA transfer of their last byte completes
+// (only with DMA transmission, start is the value of the cycle counter at reception).
+void     serial_tx_mark(uint8_t s, uint32_t len, uint32_t start, uint8_t histogram);
+void     serial_tx_mark_realtime(uint8_t s, uint32_t start, uint8_t histogram);
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2024  Roman Pauer
+#
+# This file is part of USBMidiWaveblaster.
+# https://github.com/M-HT/USBMidiWaveblaster/
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# ----------------------------------------------------------------------
+# PACKET TRACE DECODER
+# ----------------------------------------------------------------------
+#
+# Shows the packet trace (CFG_PACKET_TRACE) as a timeline.
+# The input is the reply to SysEx "F0 7D 57 06 F7", either as binary file
+# or as hexadecimal text, e.g.:
+#
+#   amidi -p hw:1 -S 'F0 7D 57 06 F7' -r trace.syx -t 1
+#   python3 tools/trace_decode.py trace.syx
+#
+
+import struct
+import sys
+
+TRACE_RX = 0x10
+TRACE_STALL = 0x11
+
+
+def read_bytes(path):
+    with open(path, 'rb') as f:
+        raw = f.read()
+    try:
+        return bytes.fromhex(raw.decode('ascii').replace(',', ' '))
+    except ValueError:
+        return raw
+
+
+def sysex_messages(data):
+    start = None
+    for i, b in enumerate(data):
+        if b == 0xF0:
+            start = i
+        elif b == 0xF7 and start is not None:
+            yield data[start + 1:i]
+            start = None
+
+
+def unpack7(data):
+    out = bytearray()
+    for i in range(0, len(data), 8):
+        msb = data[i]
+        for j, b in enumerate(data[i + 1:i + 8]):
+            out.append(b | (((msb >> j) & 1) << 7))
+    return bytes(out)
+
+
+def hexbytes(data):
+    return ' '.join('%02X' % b for b in data)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print('usage: %s <trace dump>' % sys.argv[0], file=sys.stderr)
+        return 1
+
+    entries = []
+    for msg in sysex_messages(read_bytes(sys.argv[1])):
+        if msg[:3] != b'\x7D\x57\x06' or len(msg) == 3:
+            continue
+        entry = unpack7(msg[3:])
+        if len(entry) != 16:
+            print('invalid entry: %s' % hexbytes(msg), file=sys.stderr)
+            continue
+        entries.append(struct.unpack('<IIBB6s', entry))
+
+    if not entries:
+        print('no trace entries', file=sys.stderr)
+        return 1
+
+    first = entries[0][0]
+    for time, packet, event, length, data in entries:
+        pk = struct.pack('<I', packet)
+        port = (pk[0] >> 4) + 1
+        if event == TRACE_RX:
+            what = 'USB port %-2d RX     ' % port
+        elif event == TRACE_STALL:
+            what = 'USB port %-2d stalled' % port
+        elif event & 0x08:
+            what = '  serial %d  express' % ((event & 0x07) + 1)
+        else:
+            what = '  serial %d  write  ' % ((event & 0x07) + 1)
+        line = '%12.3f ms  %s  [%s]' % (((time - first) & 0xFFFFFFFF) / 1000.0, what, hexbytes(pk))
+        if event < TRACE_RX:
+            line += '  -> %s' % (hexbytes(data[:length]) if length else '(nothing)')
+        print(line)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,77 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  PACKET TRACE
+  ----------------------------------------------------------------------
+
+*/
+
+#include "trace.h"
+
+#if defined(CFG_PACKET_TRACE) && CFG_PACKET_TRACE > 0
+
+static traceEntry_t traceEntries[TRACE_SIZE];
+static uint32_t traceHead = 0;  // Index of the next entry (free running)
+static bool tracePaused = false;
+
+// Add entry to the trace, overwriting the oldest entry when the trace is full
+// Returns the index of the entry
+uint32_t trace_record(uint8_t event, uint32_t packet, const uint8_t *data, uint8_t len) {
+    if (tracePaused) return traceHead;
+
+    traceEntry_t *entry = &traceEntries[traceHead & (TRACE_SIZE - 1)];
+
+    entry->time = micros();
+    entry->packet = packet;
+    entry->event = event;
+    entry->len = len;
+    for (uint8_t i = 0; i < len; i++) {
+        entry->data[i] = data[i];
+    }
+
+    return traceHead++;
+}
+
+// Change the event of the entry (if it wasn't overwritten yet)
+void trace_set_event(uint32_t index, uint8_t event) {
+    if (tracePaused || traceHead - index > TRACE_SIZE || index == traceHead) return;
+
+    traceEntries[index & (TRACE_SIZE - 1)].event = event;
+}
+
+// While the trace is paused, new events aren't recorded
+void trace_pause(bool pause) {
+    tracePaused = pause;
+}
+
+void trace_reset(void) {
+    traceHead = 0;
+}
+
+// Number of entries in the trace
+uint32_t trace_count(void) {
+    return (traceHead < TRACE_SIZE) ? traceHead : TRACE_SIZE;
+}
+
+// Get entry, index 0 is the oldest entry
+const traceEntry_t *trace_entry(uint32_t index) {
+    return &traceEntries[(traceHead - trace_count() + index) & (TRACE_SIZE - 1)];
+}
+
+#endif
@@ -0,0 +1,71 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  PACKET TRACE
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+#pragma once
+
+#include <wirish.h>
+
+#include "config.h"
+
+// Number of entries in the trace (power of 2)
+#ifdef CFG_PACKET_TRACE
+ #define TRACE_SIZE CFG_PACKET_TRACE
+#else
+ #define TRACE_SIZE 64
+#endif
+
+#if (TRACE_SIZE & (TRACE_SIZE - 1)) != 0
+ #error "TRACE_SIZE must be a power of 2"
+#endif
+
+// --------------------------------------------------------------------------------------
+// Packet trace API
+// --------------------------------------------------------------------------------------
+// The trace keeps the last TRACE_SIZE events: USB MIDI packets received from the host
+// and bytes written to serial ports for them (including Port Selection messages).
+// Entries are 16 bytes (little-endian), the dump format sends them unchanged.
+
+#define TRACE_SERIAL(s)          (s)            // Bytes written to serial port s
+#define TRACE_SERIAL_REALTIME(s) (0x08 | (s))   // RealTime byte written ahead of queued bytes to serial port s
+#define TRACE_RX                 0x10           // Packet received from USB
+#define TRACE_STALL              0x11           // Packet received from USB, but not accepted yet (serial ports were busy)
+
+typedef struct {
+    uint32_t time;      // micros()
+    uint32_t packet;    // USB MIDI packet
+    uint8_t  event;
+    uint8_t  len;       // Number of bytes written to serial port
+    uint8_t  data[6];
+} __packed traceEntry_t;
+
+uint32_t trace_record(uint8_t event, uint32_t packet, const uint8_t *data, uint8_t len);
+void     trace_set_event(uint32_t index, uint8_t event);
+void     trace_pause(bool pause);
+void     trace_reset(void);
+uint32_t trace_count(void);
+const traceEntry_t *trace_entry(uint32_t index);
+
+#endif
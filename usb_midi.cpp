@@ -47,22 +47,22 @@
 // MIDI USB packet lenght
 const uint8_t USBMidi::CINToLenTable[] =
 {
-  0, // 0X00 Miscellaneous function codes. Reserved for future extensions.
-  0, // 0X01 Cable events.Reserved for future expansion.
-  2, // 0x02 Two-byte System Common messages like  MTC, SongSelect, etc.
-  3, // 0x03 Three-byte System Common messages like SPP, etc.
-  3, // 0x04 SysEx starts or continues
-  1, // 0x05 Single-byte System Common Message or SysEx ends with following single byte.
-  2, // 0x06 SysEx ends with following two bytes.
-  3, // 0x07 SysEx ends withfollowing three bytes.
-  3, // 0x08 Note-off
-  3, // 0x09 Note-on
-  3, // 0x0A Poly-KeyPress
-  3, // 0x0B Control Change
-  2, // 0x0C Program Change
-  2, // 0x0D Channel Pressure
-  3, // 0x0E PitchBend Change
-  1  // 0x0F Single Byte
+  USB_MIDI_CIN_LEN(0x00), // 0x00 Miscellaneous function codes. Reserved for future extensions.
+  USB_MIDI_CIN_LEN(0x01), // 0x01 Cable events.Reserved for future expansion.
+  USB_MIDI_CIN_LEN(0x02), // 0x02 Two-byte System Common messages like  MTC, SongSelect, etc.
+  USB_MIDI_CIN_LEN(0x03), // 0x03 Three-byte System Common messages like SPP, etc.
+  USB_MIDI_CIN_LEN(0x04), // 0x04 SysEx starts or continues
+  USB_MIDI_CIN_LEN(0x05), // 0x05 Single-byte System Common Message or SysEx ends with following single byte.
+  USB_MIDI_CIN_LEN(0x06), // 0x06 SysEx ends with following two bytes.
+  USB_MIDI_CIN_LEN(0x07), // 0x07 SysEx ends withfollowing three bytes.
+  USB_MIDI_CIN_LEN(0x08), // 0x08 Note-off
+  USB_MIDI_CIN_LEN(0x09), // 0x09 Note-on
+  USB_MIDI_CIN_LEN(0x0A), // 0x0A Poly-KeyPress
+  USB_MIDI_CIN_LEN(0x0B), // 0x0B Control Change
+  USB_MIDI_CIN_LEN(0x0C), // 0x0C Program Change
+  USB_MIDI_CIN_LEN(0x0D), // 0x0D Channel Pressure
+  USB_MIDI_CIN_LEN(0x0E), // 0x0E PitchBend Change
+  USB_MIDI_CIN_LEN(0x0F)  // 0x0F Single Byte
 };
 // Constructor
 USBMidi::USBMidi(void) {
@@ -118,7 +118,8 @@ void USBMidi::writePackets(const void *buf, uint32_t len) {
     }
 
 
-    if (sent == MIDI_STREAM_EPSIZE) {
+    // usb_midi_tx() counts packets, a full endpoint buffer needs a zero length packet
+    if (sent * 4 == MIDI_STREAM_EPSIZE) {
         while (usb_midi_is_transmitting() != 0) {
         }
         /* flush out to avoid having the pc wait for more data */
@@ -126,6 +127,15 @@ void USBMidi::writePackets(const void *buf, uint32_t len) {
     }
 }
 
+// Non-blocking variant: queues at most one IN transaction and returns the number
+// of packets taken, 0 while the previous transaction is still pending.
+uint32_t USBMidi::tryWritePackets(const void *buf, uint32_t len) {
+    if (!this->isConnected()) {
+        return 0;
+    }
+    return usb_midi_tx((const uint32*)buf, len);
+}
+
 uint32_t USBMidi::available(void) {
     return usb_midi_data_available();
 }
@@ -158,6 +168,23 @@ void USBMidi::markPacketRead() {
     usb_midi_mark_read(1) ;
 }
 
+/* Calls callback for up to len received packets without copying them.
+   Stops when callback returns 0, returns number of packets read */
+uint32_t USBMidi::forEachPacket(uint8_t (*callback)(uint32_t packet), uint32_t len) {
+    if (!callback) {
+        return 0;
+    }
+
+    return usb_midi_for_each(callback, len);
+}
+
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+// Cycle counter at USB reception of the packet handed to the forEachPacket() callback
+uint32_t USBMidi::packetTime(void) {
+    return usb_midi_packet_time();
+}
+#endif
+
 /* Blocks forever until 1 byte is received */
 uint32_t USBMidi::readPacket() {
     uint32_t p=0;
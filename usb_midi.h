@@ -42,6 +42,16 @@
 #include <Print.h>
 #include <boards.h>
 
+/* user configuration */
+#include "config.h"
+
+
+// Len of MIDI message in USB MIDI packet with Code Index Number (CIN)
+#define USB_MIDI_CIN_LEN(cin) ( \
+    (cin) <= 0x01 ? 0 : \
+    (cin) == 0x05 || (cin) == 0x0F ? 1 : \
+    (cin) == 0x02 || (cin) == 0x06 || (cin) == 0x0C || (cin) == 0x0D ? 2 : \
+    3 )
 
 class USBMidi {
 private:
@@ -60,8 +70,13 @@ public:
     uint32_t readPacket();
     uint32_t peekPacket();
     void   markPacketRead();
+    uint32_t forEachPacket(uint8_t (*callback)(uint32_t packet), uint32_t len);
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+    uint32_t packetTime(void);
+#endif
     void   writePacket(const uint32*);
     void   writePackets(const void*, uint32);
+    uint32_t tryWritePackets(const void*, uint32);
     uint8_t  isConnected();
     uint8_t  pending();
  };
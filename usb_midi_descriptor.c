@@ -170,8 +170,112 @@ typedef struct {
     MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_20;
     #endif
 
+    #if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+    // MIDI IN DESCRIPTORS - 16 MAX
+    // External
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_21;
+    #if USB_MIDI_IO_PORT_NUM >= 2
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_22;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 3
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_23;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 4
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_24;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 5
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_25;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 6
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_26;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 7
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_27;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 8
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_28;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 9
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_29;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 10
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_2A;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 11
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_2B;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 12
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_2C;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 13
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_2D;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 14
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_2E;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 15
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_2F;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 16
+    MIDI_IN_JACK_DESCRIPTOR            MIDI_IN_JACK_30;
+    #endif
+
+    // MIDI OUT DESCRIPTORS - 16 MAX
+    // Embedded
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_31;
+    #if USB_MIDI_IO_PORT_NUM >= 2
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_32;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 3
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_33;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 4
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_34;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 5
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_35;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 6
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_36;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 7
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_37;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 8
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_38;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 9
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_39;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 10
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_3A;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 11
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_3B;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 12
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_3C;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 13
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_3D;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 14
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_3E;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 15
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_3F;
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 16
+    MIDI_OUT_JACK_DESCRIPTOR(1)        MIDI_OUT_JACK_40;
+    #endif
+    #endif
+
     MIDI_USB_DESCRIPTOR_ENDPOINT       DataOutEndpoint;
     MS_CS_BULK_ENDPOINT_DESCRIPTOR(USB_MIDI_IO_PORT_NUM)  MS_CS_DataOutEndpoint;
+    #if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+    MIDI_USB_DESCRIPTOR_ENDPOINT       DataInEndpoint;
+    MS_CS_BULK_ENDPOINT_DESCRIPTOR(USB_MIDI_IO_PORT_NUM)  MS_CS_DataInEndpoint;
+    #endif
 } __packed usb_midi_descriptor_config;
 
 static const usb_midi_descriptor_config usbMIDIDescriptor_Config = {
@@ -215,7 +319,7 @@ static const usb_midi_descriptor_config usbMIDIDescriptor_Config = {
         .bDescriptorType    = USB_DESCRIPTOR_TYPE_INTERFACE,
         .bInterfaceNumber   = 0x01,
         .bAlternateSetting  = 0x00,
-        .bNumEndpoints      = 0x01,
+        .bNumEndpoints      = MIDI_STREAM_NUM_ENDP,
         .bInterfaceClass    = USB_INTERFACE_CLASS_AUDIO,
         .bInterfaceSubClass = USB_INTERFACE_MIDISTREAMING,
         .bInterfaceProtocol = 0x00,
@@ -231,7 +335,14 @@ static const usb_midi_descriptor_config usbMIDIDescriptor_Config = {
                               +USB_MIDI_IO_PORT_NUM*sizeof(MIDI_IN_JACK_DESCRIPTOR)
                               +USB_MIDI_IO_PORT_NUM*MIDI_OUT_JACK_DESCRIPTOR_SIZE(1)
                               +sizeof(MIDI_USB_DESCRIPTOR_ENDPOINT)
-                              +MS_CS_BULK_ENDPOINT_DESCRIPTOR_SIZE(USB_MIDI_IO_PORT_NUM),
+                              +MS_CS_BULK_ENDPOINT_DESCRIPTOR_SIZE(USB_MIDI_IO_PORT_NUM)
+                            #if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+                              +USB_MIDI_IO_PORT_NUM*sizeof(MIDI_IN_JACK_DESCRIPTOR)
+                              +USB_MIDI_IO_PORT_NUM*MIDI_OUT_JACK_DESCRIPTOR_SIZE(1)
+                              +sizeof(MIDI_USB_DESCRIPTOR_ENDPOINT)
+                              +MS_CS_BULK_ENDPOINT_DESCRIPTOR_SIZE(USB_MIDI_IO_PORT_NUM)
+                            #endif
+                              ,
     },
 
     // Start of MIDI JACK Descriptor =======================================
@@ -605,6 +716,376 @@ static const usb_midi_descriptor_config usbMIDIDescriptor_Config = {
     },
     #endif
 
+    #if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+    // MIDI IN JACK - EXTERNAL - 16 Descriptors -----------------------------
+    .MIDI_IN_JACK_21 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x21,
+        .iJack              = 0x00,
+    },
+    #if USB_MIDI_IO_PORT_NUM >= 2
+    .MIDI_IN_JACK_22 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x22,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 3
+    .MIDI_IN_JACK_23 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x23,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 4
+    .MIDI_IN_JACK_24 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x24,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 5
+    .MIDI_IN_JACK_25 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x25,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 6
+    .MIDI_IN_JACK_26 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x26,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 7
+    .MIDI_IN_JACK_27 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x27,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 8
+    .MIDI_IN_JACK_28 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x28,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 9
+    .MIDI_IN_JACK_29 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x29,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 10
+    .MIDI_IN_JACK_2A = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x2A,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 11
+    .MIDI_IN_JACK_2B = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x2B,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 12
+    .MIDI_IN_JACK_2C = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x2C,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 13
+    .MIDI_IN_JACK_2D = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x2D,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 14
+    .MIDI_IN_JACK_2E = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x2E,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 15
+    .MIDI_IN_JACK_2F = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x2F,
+        .iJack              = 0x00,
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 16
+    .MIDI_IN_JACK_30 = {
+        .bLength            = sizeof(MIDI_IN_JACK_DESCRIPTOR),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_IN_JACK,
+        .bJackType          = MIDI_JACK_EXTERNAL,
+        .bJackId            = 0x30,
+        .iJack              = 0x00,
+    },
+    #endif
+
+    // MIDI OUT JACK - EMBEDDED - 16 Descriptors ---------------------------
+    .MIDI_OUT_JACK_31 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x31,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x21}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x04,  // Waveblaster  1
+    },
+    #if USB_MIDI_IO_PORT_NUM >= 2
+    .MIDI_OUT_JACK_32 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x32,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x22}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x05,  // Waveblaster  2
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 3
+    .MIDI_OUT_JACK_33 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x33,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x23}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x06,  // Waveblaster  3
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 4
+    .MIDI_OUT_JACK_34 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x34,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x24}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x07,  // Waveblaster  4
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 5
+    .MIDI_OUT_JACK_35 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x35,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x25}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x08,  // Waveblaster  5
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 6
+    .MIDI_OUT_JACK_36 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x36,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x26}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x09,  // Waveblaster  6
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 7
+    .MIDI_OUT_JACK_37 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x37,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x27}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x0A,  // Waveblaster  7
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 8
+    .MIDI_OUT_JACK_38 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x38,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x28}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x0B,  // Waveblaster  8
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 9
+    .MIDI_OUT_JACK_39 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x39,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x29}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x0C,  // Waveblaster  9
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 10
+    .MIDI_OUT_JACK_3A = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x3A,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x2A}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x0D,  // Waveblaster 10
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 11
+    .MIDI_OUT_JACK_3B = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x3B,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x2B}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x0E,  // Waveblaster 11
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 12
+    .MIDI_OUT_JACK_3C = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x3C,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x2C}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x0F,  // Waveblaster 12
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 13
+    .MIDI_OUT_JACK_3D = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x3D,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x2D}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x10,  // Waveblaster 13
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 14
+    .MIDI_OUT_JACK_3E = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x3E,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x2E}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x11,  // Waveblaster 14
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 15
+    .MIDI_OUT_JACK_3F = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x3F,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x2F}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x12,  // Waveblaster 15
+    },
+    #endif
+    #if USB_MIDI_IO_PORT_NUM >= 16
+    .MIDI_OUT_JACK_40 = {
+        .bLength            = MIDI_OUT_JACK_DESCRIPTOR_SIZE(1),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_CS_INTERFACE,
+        .SubType            = MIDI_OUT_JACK,
+        .bJackType          = MIDI_JACK_EMBEDDED,
+        .bJackId            = 0x40,
+        .bNrInputPins       = 0x01,
+        .baSourceId         = {0x30}, // IN External
+        .baSourcePin        = {0x01},
+        .iJack              = 0x13,  // Waveblaster 16
+    },
+    #endif
+    #endif
+
     // End of MIDI JACK Descriptor =======================================
 
     .DataOutEndpoint = {
@@ -676,6 +1157,77 @@ static const usb_midi_descriptor_config usbMIDIDescriptor_Config = {
       },
   },
 
+    #if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+    .DataInEndpoint = {
+        .bLength            = sizeof(MIDI_USB_DESCRIPTOR_ENDPOINT),
+        .bDescriptorType    = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress   = (USB_DESCRIPTOR_ENDPOINT_IN |
+                             MIDI_STREAM_IN_ENDP),
+        .bmAttributes       = USB_EP_TYPE_BULK,
+        .wMaxPacketSize     = MIDI_STREAM_EPSIZE,
+        .bInterval          = 0x00,
+        .bRefresh           = 0x00,
+        .bSynchAddress      = 0x00,
+    },
+
+    .MS_CS_DataInEndpoint = {
+      .bLength              = MS_CS_BULK_ENDPOINT_DESCRIPTOR_SIZE(USB_MIDI_IO_PORT_NUM),
+      .bDescriptorType      = USB_DESCRIPTOR_TYPE_CS_ENDPOINT,
+      .SubType              = 0x01,
+      // MIDI OUT EMBEDDED
+      .bNumEmbMIDIJack      = USB_MIDI_IO_PORT_NUM,
+      .baAssocJackID        = {
+        0X31,
+        #if USB_MIDI_IO_PORT_NUM >= 2
+        0X32,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 3
+        0X33,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 4
+        0X34,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 5
+        0X35,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 6
+        0X36,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 7
+        0X37,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 8
+        0X38,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 9
+        0X39,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 10
+        0X3A,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 11
+        0X3B,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 12
+        0X3C,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 13
+        0X3D,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 14
+        0X3E,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 15
+        0X3F,
+        #endif
+        #if USB_MIDI_IO_PORT_NUM >= 16
+        0X40,
+        #endif
+
+      },
+  },
+    #endif
+
 };
 // --------------------------------------------------------------------------------------
 //  String Descriptors:
@@ -40,6 +40,9 @@
 
 #include "hardware_config.h"
 #include "usb_midi_device.h"
+#include "cycle_counter.h"
+#include "perf_counters.h"
+#include "profiler.h"
 
 #include <libmaple/usb.h>
 #include <libmaple/nvic.h>
@@ -75,10 +78,31 @@ static void   usb_midi_SetDeviceAddress(void);
 
 /* I/O state */
 
-/* Received data */
-static volatile uint32_t midiBufferRx[MIDI_STREAM_EPSIZE/4];
-/* Read index into midiBufferRx */
-static volatile uint32_t rx_offset = 0;
+/* Received packets (single producer: RX callback, single consumer: usercode) */
+static uint32_t midiRingRx[USB_MIDI_RX_RING_SIZE];
+/* Write index into midiRingRx (free running, only advanced by the RX callback) */
+static volatile uint32_t rx_head = 0;
+/* Read index into midiRingRx (free running, only advanced by usercode) */
+static volatile uint32_t rx_tail = 0;
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+#define USB_MIDI_RX_BUFFERS 2
+#else
+#define USB_MIDI_RX_BUFFERS 1
+#endif
+/* Number of received PMA buffers waiting for free space in midiRingRx */
+static volatile uint8_t rx_pending = 0;
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+/* Was SW_BUF already toggled to take the oldest received PMA buffer? */
+static volatile uint8_t rx_held = 0;
+#endif
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+/* Cycle counter at reception of each packet in midiRingRx */
+static uint32_t midiRingRxTime[USB_MIDI_RX_RING_SIZE];
+/* Cycle counter at the RX callback of each received PMA buffer */
+static volatile uint32_t rx_time[USB_MIDI_RX_BUFFERS];
+/* Reception time of the packet handed to the usb_midi_for_each() callback */
+static uint32_t rx_packet_time = 0;
+#endif
 /* Transmit data */
 static volatile uint32_t midiBufferTx[MIDI_STREAM_EPSIZE/4];
 /* Write index into midiBufferTx */
@@ -87,8 +111,6 @@ static volatile uint32_t tx_offset = 0;
 static volatile uint32_t n_unsent_packets = 0;
 /* Are we currently sending an IN packet? */
 static volatile uint8_t transmitting = 0;
-/* Number of unread bytes */
-static volatile uint32_t n_unread_packets = 0;
 
 
 // --------------------------------------------------------------------------------------
@@ -324,34 +346,168 @@ void usb_midi_disable(gpio_dev *disc_dev, uint8_t disc_bit, uint8_t level) {
 // --------------------------------------------------------------------------------------
 // USB BUFFERS I/O
 // --------------------------------------------------------------------------------------
-/* TODO these could use some improvement; they're fairly
- * straightforward ports of the analogous ST code.  The PMA blit
- * routines in particular are obvious targets for performance
- * measurement and tuning. */
-static void usb_copy_to_pma(const uint8_t *buf, uint16_t len, uint16_t pma_offset) {
-    uint16_t *dst = (uint16*)usb_pma_ptr(pma_offset);
-    uint16_t n = len >> 1;
-    uint16_t i;
-    for (i = 0; i < n; i++) {
-        *dst = (uint16)(*buf) | *(buf + 1) << 8;
-        buf += 2;
-        dst += 2;
+/* The PMA is accessed as 16-bit halfwords, each one occupying a 32-bit
+ * word in the CPU address space. The USB MIDI endpoints only transfer
+ * whole 4-byte packets, so the copy routines move one packet (two PMA
+ * words) per step, unrolled by four packets, and assemble it with word
+ * operations instead of per-byte loads and stores. */
+static void usb_copy_packets_to_pma(const uint32_t *buf, uint32_t packets, uint16_t pma_offset) {
+    volatile uint16_t *dst = (volatile uint16*)usb_pma_ptr(pma_offset);
+    uint32_t p0, p1, p2, p3;
+
+    while (packets >= 4) {
+        p0 = buf[0];
+        p1 = buf[1];
+        p2 = buf[2];
+        p3 = buf[3];
+        dst[0]  = (uint16_t)p0;
+        dst[2]  = (uint16_t)(p0 >> 16);
+        dst[4]  = (uint16_t)p1;
+        dst[6]  = (uint16_t)(p1 >> 16);
+        dst[8]  = (uint16_t)p2;
+        dst[10] = (uint16_t)(p2 >> 16);
+        dst[12] = (uint16_t)p3;
+        dst[14] = (uint16_t)(p3 >> 16);
+        buf += 4;
+        dst += 16;
+        packets -= 4;
+    }
+    while (packets) {
+        p0 = *buf++;
+        dst[0] = (uint16_t)p0;
+        dst[2] = (uint16_t)(p0 >> 16);
+        dst += 4;
+        packets--;
     }
-    if (len & 1) {
-        *dst = *buf;
+}
+
+static void usb_copy_packets_from_pma(uint32_t *buf, uint32_t packets, uint16_t pma_offset) {
+    const volatile uint32_t *src = (const volatile uint32*)usb_pma_ptr(pma_offset);
+
+    while (packets >= 4) {
+        buf[0] = (src[0] & 0xFFFF) | (src[1] << 16);
+        buf[1] = (src[2] & 0xFFFF) | (src[3] << 16);
+        buf[2] = (src[4] & 0xFFFF) | (src[5] << 16);
+        buf[3] = (src[6] & 0xFFFF) | (src[7] << 16);
+        buf += 4;
+        src += 8;
+        packets -= 4;
     }
+    while (packets) {
+        *buf++ = (src[0] & 0xFFFF) | (src[1] << 16);
+        src += 2;
+        packets--;
+    }
+}
+
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+/* In double-buffered OUT mode, DTOG_RX selects the PMA buffer used by
+ * the USB peripheral and DTOG_TX (SW_BUF) the buffer used by us. The
+ * peripheral NAKs the host only when both bits are equal, i.e. when
+ * it filled its buffer and we still hold the other one. */
+static void usb_midi_reset_rx_dtog(void) {
+    uint32_t epr = USB_BASE->EP[MIDI_STREAM_OUT_ENDP];
+
+    /* Clear DTOG_RX and set SW_BUF, so the first packet goes to buffer 0 */
+    USB_BASE->EP[MIDI_STREAM_OUT_ENDP] = (epr & (USB_EP_EP_TYPE | USB_EP_EP_KIND | USB_EP_EA)) |
+                                         USB_EP_CTR_RX | USB_EP_CTR_TX |
+                                         (epr & USB_EP_DTOG_RX) | (~epr & USB_EP_DTOG_TX);
+}
+
+static void usb_midi_toggle_rx_sw_buf(void) {
+    uint32_t epr = USB_BASE->EP[MIDI_STREAM_OUT_ENDP];
+
+    USB_BASE->EP[MIDI_STREAM_OUT_ENDP] = (epr & (USB_EP_EP_TYPE | USB_EP_EP_KIND | USB_EP_EA)) |
+                                         USB_EP_CTR_RX | USB_EP_CTR_TX | USB_EP_DTOG_TX;
 }
+#endif
+
+/* Copy the oldest received PMA buffer into midiRingRx.
+ *
+ * Returns 0 without touching the PMA buffer when midiRingRx doesn't
+ * have enough free space.
+ *
+ * Must not be interrupted by the RX callback. */
+static uint8_t usb_midi_read_pma_buffer(void) {
+    uint16_t pma_offset;
+    uint32_t packets, head, index, first;
+
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+    /* The held buffer is the one selected by SW_BUF */
+    if (USB_BASE->EP[MIDI_STREAM_OUT_ENDP] & USB_EP_DTOG_TX) {
+        packets = usb_get_ep_rx_buf1_count(MIDI_STREAM_OUT_ENDP) / 4;
+        pma_offset = MIDI_STREAM_OUT_BUF1_EPADDR;
+    } else {
+        packets = usb_get_ep_rx_buf0_count(MIDI_STREAM_OUT_ENDP) / 4;
+        pma_offset = MIDI_STREAM_OUT_BUF0_EPADDR;
+    }
+#else
+    packets = usb_get_ep_rx_count(MIDI_STREAM_OUT_ENDP) / 4;
+    pma_offset = MIDI_STREAM_OUT_EPADDR;
+#endif
+
+    head = rx_head;
+    if (packets > USB_MIDI_RX_RING_SIZE - (head - __atomic_load_n(&rx_tail, __ATOMIC_ACQUIRE))) {
+        return 0;
+    }
 
-static void usb_copy_from_pma(uint8_t *buf, uint16_t len, uint16_t pma_offset) {
-    uint32_t *src = (uint32*)usb_pma_ptr(pma_offset);
-    uint16_t *dst = (uint16*)buf;
-    uint16_t n = len >> 1;
-    uint16_t i;
-    for (i = 0; i < n; i++) {
-        *dst++ = *src++;
+    /* Copy packets, wrapping around the end of midiRingRx */
+    index = head & (USB_MIDI_RX_RING_SIZE - 1);
+    first = USB_MIDI_RX_RING_SIZE - index;
+    if (first > packets) {
+        first = packets;
     }
-    if (len & 1) {
-        *dst = *src & 0xFF;
+    usb_copy_packets_from_pma(&midiRingRx[index], first, pma_offset);
+    if (packets > first) {
+        usb_copy_packets_from_pma(midiRingRx, packets - first, pma_offset + first * 4);
+    }
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+    for (index = 0; index < packets; index++) {
+        midiRingRxTime[(head + index) & (USB_MIDI_RX_RING_SIZE - 1)] = rx_time[0];
+    }
+#endif
+
+    /* Publish the packets to usercode */
+    __atomic_store_n(&rx_head, head + packets, __ATOMIC_RELEASE);
+    PERF_COUNT(usbRxPackets, packets);
+
+#if !(defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0)
+    usb_set_ep_rx_count(MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE);
+    usb_set_ep_rx_stat(MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_VALID);
+#endif
+
+    return 1;
+}
+
+/* Copy the received PMA buffers into midiRingRx in the order of
+ * reception, as long as there is enough free space.
+ *
+ * With double buffering, SW_BUF is toggled before copying, so the
+ * peripheral receives the next transaction into the other buffer while
+ * the held buffer waits for free space in midiRingRx. The host is only
+ * NAKed when both buffers are waiting.
+ *
+ * Must not be interrupted by the RX callback. */
+static void usb_midi_read_pma_buffers(void) {
+    while (rx_pending) {
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+        if (!rx_held) {
+            usb_midi_toggle_rx_sw_buf();
+            rx_held = 1;
+        }
+#endif
+
+        if (!usb_midi_read_pma_buffer()) {
+            return;
+        }
+
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+        rx_held = 0;
+#endif
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+        rx_time[0] = rx_time[USB_MIDI_RX_BUFFERS - 1];
+#endif
+        rx_pending--;
     }
 }
 
@@ -381,7 +537,7 @@ uint32_t usb_midi_tx(const uint32* buf, uint32_t packets) {
 
     /* Queue bytes for sending. */
     if (packets) {
-        usb_copy_to_pma((uint8_t *)buf, bytes, MIDI_STREAM_IN_EPADDR);
+        usb_copy_packets_to_pma(buf, packets, MIDI_STREAM_IN_EPADDR);
     }
     // We still need to wait for the interrupt, even if we're sending
     // zero bytes. (Sending zero-size packets is useful for flushing
@@ -396,7 +552,7 @@ uint32_t usb_midi_tx(const uint32* buf, uint32_t packets) {
 
 /* Nonblocking byte receive.
  *
- * Copies up to len bytes from our private data buffer (*NOT* the PMA)
+ * Copies up to len bytes from our private ring buffer (*NOT* the PMA)
  * into buf and deq's the FIFO. */
 uint32_t usb_midi_rx(uint32* buf, uint32_t packets) {
     /* Copy bytes to buffer. */
@@ -404,18 +560,6 @@ uint32_t usb_midi_rx(uint32* buf, uint32_t packets) {
 
     usb_midi_mark_read(n_copied);
 
-    // /* Mark bytes as read. */
-    // n_unread_packets -= n_copied;
-    // rx_offset += n_copied;
-    //
-    // /* If all bytes have been read, re-enable the RX endpoint, which
-    //  * was set to NAK when the current batch of bytes was received. */
-    // if (n_unread_packets == 0) {
-    //     usb_set_ep_rx_count(MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE);
-    //     usb_set_ep_rx_stat(MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_VALID);
-    //     rx_offset = 0;
-    // }
-
     return n_copied;
 }
 
@@ -423,18 +567,52 @@ uint32_t usb_midi_rx(uint32* buf, uint32_t packets) {
  *
  * Looks at unread bytes without marking them as read. */
 uint32_t usb_midi_peek(uint32* buf, uint32_t packets) {
-    int i;
+    uint32_t i;
+    uint32_t tail = rx_tail;
+    uint32_t n_unread_packets = __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE) - tail;
+
     if (packets > n_unread_packets) {
         packets = n_unread_packets;
     }
 
     for (i = 0; i < packets; i++) {
-        buf[i] = midiBufferRx[i + rx_offset];
+        buf[i] = midiRingRx[(tail + i) & (USB_MIDI_RX_RING_SIZE - 1)];
     }
 
     return packets;
 }
 
+/* Nonblocking packet receive without copying.
+ *
+ * Hands up to len unread packets to callback, straight from our private
+ * ring buffer, then marks them as read (which re-arms the RX endpoint if
+ * it was waiting for free space). Stops at the first packet for which
+ * callback returns 0, that packet stays unread. */
+uint32_t usb_midi_for_each(uint8_t (*callback)(uint32_t packet), uint32_t packets) {
+    uint32_t i;
+    uint32_t tail = rx_tail;
+    uint32_t n_unread_packets = __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE) - tail;
+
+    if (packets > n_unread_packets) {
+        packets = n_unread_packets;
+    }
+
+    for (i = 0; i < packets; i++) {
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+        rx_packet_time = midiRingRxTime[(tail + i) & (USB_MIDI_RX_RING_SIZE - 1)];
+#endif
+        if (!callback(midiRingRx[(tail + i) & (USB_MIDI_RX_RING_SIZE - 1)])) {
+            break;
+        }
+    }
+
+    if (i) {
+        usb_midi_mark_read(i);
+    }
+
+    return i;
+}
+
 /* Nonblocking byte receive.
  * Mark n packets as read  when they have been peeked
  * Warning : this call must only follow  a peek !!
@@ -443,15 +621,16 @@ uint32_t usb_midi_peek(uint32* buf, uint32_t packets) {
 
 uint32_t usb_midi_mark_read(uint32_t n_copied) {
     /* Mark bytes as read. */
-    n_unread_packets -= n_copied;
-    rx_offset += n_copied;
-
-    /* If all bytes have been read, re-enable the RX endpoint, which
-     * was set to NAK when the current batch of bytes was received. */
-    if (n_unread_packets == 0) {
-        usb_set_ep_rx_count(MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE);
-        usb_set_ep_rx_stat(MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_VALID);
-        rx_offset = 0;
+    __atomic_store_n(&rx_tail, rx_tail + n_copied, __ATOMIC_RELEASE);
+
+    /* If the RX callback couldn't store the received PMA buffers,
+     * retry now that there's more free space. The RX callback only
+     * gives up when midiRingRx isn't empty, so there's always another
+     * call to this function to retry. */
+    if (rx_pending) {
+        nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+        usb_midi_read_pma_buffers();
+        nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
     }
 
     return n_copied;
@@ -463,7 +642,7 @@ uint32_t usb_midi_mark_read(uint32_t n_copied) {
 // --------------------------------------------------------------------------------------
 
 uint32_t usb_midi_data_available(void) {
-    return n_unread_packets;
+    return __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE) - rx_tail;
 }
 
 uint8_t usb_midi_is_transmitting(void) {
@@ -474,31 +653,42 @@ uint16_t usb_midi_get_pending(void) {
     return n_unsent_packets;
 }
 
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+/* Cycle counter at reception of the packet handed to the usb_midi_for_each() callback */
+uint32_t usb_midi_packet_time(void) {
+    return rx_packet_time;
+}
+#endif
+
 // --------------------------------------------------------------------------------------
 // ENDPOINTS CALLBACKS
 // --------------------------------------------------------------------------------------
 
 static void usb_midi_DataTxCb(void) {
+    PROFILER_BEGIN();
     n_unsent_packets = 0;
     transmitting = 0;
+    PROFILER_END(PROFILER_USB_TX);
 }
 
 static void usb_midi_DataRxCb(void) {
+    PROFILER_BEGIN();
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+    rx_time[rx_pending] = cycle_counter_now();
+#endif
+#if !(defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0)
     usb_set_ep_rx_stat(MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_NAK);
-    n_unread_packets = usb_get_ep_rx_count(MIDI_STREAM_OUT_ENDP) / 4;
-    /* This copy won't overwrite unread bytes, since we've set the RX
-     * endpoint to NAK, and will only set it to VALID when all bytes
-     * have been read. */
-
-    usb_copy_from_pma((uint8*)midiBufferRx, n_unread_packets * 4,
-                      MIDI_STREAM_OUT_EPADDR);
-
-    if (n_unread_packets == 0) {
-        usb_set_ep_rx_count(MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE);
-        usb_set_ep_rx_stat(MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_VALID);
-        rx_offset = 0;
-    }
+#endif
 
+    /* Copy the packets and re-arm the endpoint right away. If there's
+     * not enough space, keep the PMA buffer until usercode reads some
+     * packets (the host is NAKed when all PMA buffers are kept). */
+    rx_pending++;
+    usb_midi_read_pma_buffers();
+    if (rx_pending == USB_MIDI_RX_BUFFERS) {
+        PERF_COUNT(usbRxNakPeriods, 1);
+    }
+    PROFILER_END(PROFILER_USB_RX);
 }
 
 // --------------------------------------------------------------------------------------
@@ -548,10 +738,22 @@ static void usb_midi_Reset(void) {
     /* TODO figure out differences in style between RX/TX EP setup */
 
    /* set up data endpoint OUT (RX) */
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+    usb_set_ep_type         (MIDI_STREAM_OUT_ENDP, USB_EP_EP_TYPE_BULK        );
+    usb_set_ep_kind         (MIDI_STREAM_OUT_ENDP, USB_EP_EP_KIND_DBL_BUF     );
+    usb_set_ep_rx_buf0_addr (MIDI_STREAM_OUT_ENDP, MIDI_STREAM_OUT_BUF0_EPADDR);
+    usb_set_ep_rx_buf1_addr (MIDI_STREAM_OUT_ENDP, MIDI_STREAM_OUT_BUF1_EPADDR);
+    usb_set_ep_rx_buf0_count(MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE         );
+    usb_set_ep_rx_buf1_count(MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE         );
+    usb_midi_reset_rx_dtog  (                                                 );
+    usb_set_ep_rx_stat      (MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_VALID       );
+    usb_set_ep_tx_stat      (MIDI_STREAM_OUT_ENDP, USB_EP_STAT_TX_DISABLED    );
+#else
     usb_set_ep_type       (MIDI_STREAM_OUT_ENDP, USB_EP_EP_TYPE_BULK   );
     usb_set_ep_rx_addr    (MIDI_STREAM_OUT_ENDP, MIDI_STREAM_OUT_EPADDR);
     usb_set_ep_rx_count   (MIDI_STREAM_OUT_ENDP, MIDI_STREAM_EPSIZE    );
     usb_set_ep_rx_stat    (MIDI_STREAM_OUT_ENDP, USB_EP_STAT_RX_VALID  );
+#endif
 
     /* set up data endpoint IN (TX)  */
     usb_set_ep_type       (MIDI_STREAM_IN_ENDP, USB_EP_EP_TYPE_BULK   );
@@ -563,9 +765,13 @@ static void usb_midi_Reset(void) {
     SetDeviceAddress(0);
 
     /* Reset the RX/TX state */
-    n_unread_packets = 0;
+    rx_head = 0;
+    rx_tail = 0;
+    rx_pending = 0;
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+    rx_held = 0;
+#endif
     n_unsent_packets = 0;
-    rx_offset = 0;
 }
 
 static RESULT usb_midi_DataSetup(uint8_t request) {
@@ -70,10 +70,14 @@ uint32_t usb_midi_tx(const uint32* buf, uint32_t len);
 uint32_t usb_midi_rx(uint32* buf, uint32_t len);
 uint32_t usb_midi_peek(uint32* buf, uint32_t len);
 uint32_t usb_midi_mark_read(uint32_t n_copied) ;
+uint32_t usb_midi_for_each(uint8_t (*callback)(uint32_t packet), uint32_t len);
 
 uint32_t usb_midi_data_available(void); /* in RX buffer */
 uint16_t usb_midi_get_pending(void);
 uint8_t usb_midi_is_transmitting(void);
+#if defined(CFG_LATENCY_HISTOGRAM) && CFG_LATENCY_HISTOGRAM > 0
+uint32_t usb_midi_packet_time(void);
+#endif
 
 // --------------------------------------------------------------------------------------
 // GLOBAL USB CONFIGURATION
@@ -96,6 +100,20 @@ uint8_t usb_midi_is_transmitting(void);
  #define USB_MIDI_IO_PORT_NUM 1
 #endif
 
+// --------------------------------------------------------------------------------------
+// RECEIVE BUFFER
+// --------------------------------------------------------------------------------------
+// Size of the ring buffer between the USB RX callback and usercode (in USB MIDI packets)
+#ifdef CFG_USB_MIDI_RX_RING_SIZE
+ #define USB_MIDI_RX_RING_SIZE CFG_USB_MIDI_RX_RING_SIZE
+#else
+ #define USB_MIDI_RX_RING_SIZE 256
+#endif
+
+#if (USB_MIDI_RX_RING_SIZE & (USB_MIDI_RX_RING_SIZE - 1)) != 0
+ #error "USB_MIDI_RX_RING_SIZE must be a power of 2"
+#endif
+
 // --------------------------------------------------------------------------------------
 // DESCRIPTOR IDS
 // --------------------------------------------------------------------------------------
@@ -145,9 +163,6 @@ uint8_t usb_midi_is_transmitting(void);
 
 #define USB_MIDI_NUM_ENDPTS            0x04
 
-// buffer table base address
-#define USB_MIDI_BTABLE_ADDRESS      0x0000
-
 // Every USB device must provide at least one control endpoint at address 0 called the
 // default endpoint or Endpoint0. This endpoint is bidirectional.
 // that is, the host can send data to the endpoint and receive data from it within one transfer.
@@ -155,11 +170,9 @@ uint8_t usb_midi_is_transmitting(void);
 // configure the device, or perform control operations that are unique to the device.
 // Control Endpoint
 
-#define USB_MIDI_MAX_PACKET_SIZE          0x10  /* 64B, maximum for USB FS Devices */
+#define USB_MIDI_MAX_PACKET_SIZE          0x10  /* 16B (8, 16, 32 or 64B for USB FS Devices) */
 
 #define USB_MIDI_CTRL_ENDP       USB_EP0
-#define USB_MIDI_CTRL_RX_ADDR    0x40
-#define USB_MIDI_CTRL_TX_ADDR    0x80
 
 // MIDI data endpoints are used for transferring data. They are unidirectional,
 // has a type (control, interrupt, bulk, isochronous) and other properties.
@@ -168,13 +181,76 @@ uint8_t usb_midi_is_transmitting(void);
 // to transfers to the host from a device and OUT always refers to transfers
 // from the host to a device.
 
-#define MIDI_STREAM_EPSIZE       0x10
+#define MIDI_STREAM_EPSIZE       0x40  /* 64B = 16 USB MIDI packets, maximum for USB FS bulk endpoints */
 
 #define MIDI_STREAM_IN_ENDP      USB_EP1
-#define MIDI_STREAM_IN_EPADDR    0xC0
-
 #define MIDI_STREAM_OUT_ENDP     USB_EP2
-#define MIDI_STREAM_OUT_EPADDR   0x100
+
+// The IN endpoint is only declared to the host when serial MIDI input is forwarded
+#if defined(CFG_USB_MIDI_IN) && CFG_USB_MIDI_IN > 0
+ #define MIDI_STREAM_NUM_ENDP    0x02
+#else
+ #define MIDI_STREAM_NUM_ENDP    0x01
+#endif
+
+#if USB_MIDI_MAX_PACKET_SIZE != 8 && USB_MIDI_MAX_PACKET_SIZE != 16 && USB_MIDI_MAX_PACKET_SIZE != 32 && USB_MIDI_MAX_PACKET_SIZE != 64
+ #error "USB_MIDI_MAX_PACKET_SIZE must be 8, 16, 32 or 64"
+#endif
+#if MIDI_STREAM_EPSIZE != 8 && MIDI_STREAM_EPSIZE != 16 && MIDI_STREAM_EPSIZE != 32 && MIDI_STREAM_EPSIZE != 64
+ #error "MIDI_STREAM_EPSIZE must be 8, 16, 32 or 64"
+#endif
+
+#if USB_MIDI_RX_RING_SIZE < MIDI_STREAM_EPSIZE / 4
+ #error "USB_MIDI_RX_RING_SIZE must be able to hold a full MIDI OUT transaction"
+#endif
+
+// --------------------------------------------------------------------------------------
+// PACKET MEMORY AREA (PMA) LAYOUT
+// --------------------------------------------------------------------------------------
+// The buffer table and the endpoint buffers are placed one after another in the PMA.
+// Offsets are derived from the endpoint sizes and the total size is checked at compile time.
+
+#define USB_MIDI_PMA_SIZE            0x200
+
+// PMA buffers are aligned to 8 bytes
+#define USB_MIDI_PMA_ALIGN(addr)     (((addr) + 7) & ~7)
+
+// Space reserved for a TX buffer and for a RX buffer (RX buffers are allocated in blocks
+// of 2 bytes up to 62 bytes and in blocks of 32 bytes above that)
+#define USB_MIDI_PMA_TX_SIZE(size)   (((size) + 1) & ~1)
+#define USB_MIDI_PMA_RX_SIZE(size)   ((size) > 62 ? (((size) + 31) & ~31) : (((size) + 1) & ~1))
+
+// buffer table base address, 8 bytes per endpoint
+#define USB_MIDI_BTABLE_ADDRESS      0x0000
+#define USB_MIDI_BTABLE_SIZE         (USB_MIDI_NUM_ENDPTS * 8)
+
+#define USB_MIDI_CTRL_RX_ADDR        USB_MIDI_PMA_ALIGN(USB_MIDI_BTABLE_ADDRESS + USB_MIDI_BTABLE_SIZE)
+#define USB_MIDI_CTRL_RX_SIZE        USB_MIDI_PMA_RX_SIZE(USB_MIDI_MAX_PACKET_SIZE)
+
+#define USB_MIDI_CTRL_TX_ADDR        USB_MIDI_PMA_ALIGN(USB_MIDI_CTRL_RX_ADDR + USB_MIDI_CTRL_RX_SIZE)
+#define USB_MIDI_CTRL_TX_SIZE        USB_MIDI_PMA_TX_SIZE(USB_MIDI_MAX_PACKET_SIZE)
+
+#define MIDI_STREAM_IN_EPADDR        USB_MIDI_PMA_ALIGN(USB_MIDI_CTRL_TX_ADDR + USB_MIDI_CTRL_TX_SIZE)
+#define MIDI_STREAM_IN_SIZE          USB_MIDI_PMA_TX_SIZE(MIDI_STREAM_EPSIZE)
+
+// With double buffering, the OUT endpoint uses two consecutive PMA buffers.
+// The USB peripheral receives into one of them while the other one is read.
+#define MIDI_STREAM_OUT_EPADDR       USB_MIDI_PMA_ALIGN(MIDI_STREAM_IN_EPADDR + MIDI_STREAM_IN_SIZE)
+#define MIDI_STREAM_OUT_BUF0_EPADDR  MIDI_STREAM_OUT_EPADDR
+#define MIDI_STREAM_OUT_BUF1_EPADDR  USB_MIDI_PMA_ALIGN(MIDI_STREAM_OUT_BUF0_EPADDR + MIDI_STREAM_OUT_SIZE)
+#define MIDI_STREAM_OUT_SIZE         USB_MIDI_PMA_RX_SIZE(MIDI_STREAM_EPSIZE)
+
+#if defined(CFG_USB_MIDI_RX_DOUBLE_BUFFER) && CFG_USB_MIDI_RX_DOUBLE_BUFFER > 0
+ #define USB_MIDI_PMA_END            (MIDI_STREAM_OUT_BUF1_EPADDR + MIDI_STREAM_OUT_SIZE)
+#else
+ #define USB_MIDI_PMA_END            (MIDI_STREAM_OUT_EPADDR + MIDI_STREAM_OUT_SIZE)
+#endif
+
+// Buffers can't overlap, each one starts after the end of the previous one,
+// so only the total size needs to be checked
+#if USB_MIDI_PMA_END > USB_MIDI_PMA_SIZE
+ #error "USB PMA layout: endpoint buffers don't fit into the PMA"
+#endif
 
 // --------------------------------------------------------------------------------------
 // MIDI DEVICE DESCRIPTOR STRUCTURES
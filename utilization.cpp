@@ -0,0 +1,96 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  SERIAL PORTS UTILIZATION
+  ----------------------------------------------------------------------
+
+*/
+
+#include "utilization.h"
+
+#if defined(CFG_SERIAL_UTILIZATION) && CFG_SERIAL_UTILIZATION > 0
+
+typedef struct {
+    uint32_t capacity;                  // Bytes the line can transmit during the window (0 = disabled port)
+    uint32_t bytes;                     // Bytes in the current slot
+    uint32_t sum;                       // Bytes in the completed slots
+    uint16_t slots[UTILIZATION_SLOTS];
+} utilization_state;
+
+static utilization_state utilization[SERIAL_INTERFACE_MAX];
+static uint32_t utilizationSlotStart = 0;  // Start of the current slot (milliseconds)
+static uint8_t utilizationSlot = 0;        // Index of the oldest completed slot
+
+// Call for each enabled serial port
+void utilization_begin(uint8_t s, uint32_t speed) {
+    utilization_state *state = &utilization[s];
+
+    state->capacity = (speed * UTILIZATION_WINDOW_MS) / 10000;
+    state->bytes = 0;
+    state->sum = 0;
+    for (uint8_t i = 0; i < UTILIZATION_SLOTS; i++) {
+        state->slots[i] = 0;
+    }
+}
+
+// Count bytes written to the serial port
+void utilization_add(uint8_t s, uint32_t bytes) {
+    utilization[s].bytes += bytes;
+}
+
+// Move the window (now is the time in milliseconds)
+void utilization_update(uint32_t now) {
+    // Start again after a long pause
+    if (now - utilizationSlotStart >= UTILIZATION_WINDOW_MS + UTILIZATION_SLOT_MS) {
+        for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+            utilization_state *state = &utilization[s];
+
+            state->sum = 0;
+            for (uint8_t i = 0; i < UTILIZATION_SLOTS; i++) {
+                state->slots[i] = 0;
+            }
+        }
+        utilizationSlotStart = now - UTILIZATION_SLOT_MS;
+    }
+
+    while (now - utilizationSlotStart >= UTILIZATION_SLOT_MS) {
+        utilizationSlotStart += UTILIZATION_SLOT_MS;
+
+        // The current slot replaces the oldest slot
+        for (uint8_t s = 0; s < SERIAL_INTERFACE_MAX; s++) {
+            utilization_state *state = &utilization[s];
+            uint16_t bytes = (state->bytes < 0xFFFF) ? state->bytes : 0xFFFF;
+
+            state->sum += bytes - state->slots[utilizationSlot];
+            state->slots[utilizationSlot] = bytes;
+            state->bytes = 0;
+        }
+
+        utilizationSlot = (utilizationSlot + 1) & (UTILIZATION_SLOTS - 1);
+    }
+}
+
+// Get the utilization of the serial port (percent)
+uint32_t utilization_percent(uint8_t s) {
+    utilization_state *state = &utilization[s];
+
+    return state->capacity ? (state->sum * 100) / state->capacity : 0;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+  Copyright (C) 2024  Roman Pauer
+
+  This file is part of USBMidiWaveblaster.
+  https://github.com/M-HT/USBMidiWaveblaster/
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, version 3 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+  ----------------------------------------------------------------------
+  SERIAL PORTS UTILIZATION
+  ----------------------------------------------------------------------
+
+*/
+
+#ifndef _UTILIZATION_H_
+#define _UTILIZATION_H_
+#pragma once
+
+#include <wirish.h>
+
+#include "hardware_config.h"
+#include "config.h"
+
+// Sliding window of the utilization meter
+#define UTILIZATION_SLOTS     8     // Number of slots in the window (power of 2)
+#define UTILIZATION_SLOT_MS   32    // Length of one slot (milliseconds)
+#define UTILIZATION_WINDOW_MS (UTILIZATION_SLOTS * UTILIZATION_SLOT_MS)
+
+// --------------------------------------------------------------------------------------
+// Serial utilization API
+// --------------------------------------------------------------------------------------
+// Bytes written to each serial port are counted in slots of a sliding window.
+// The utilization is the number of bytes in the completed slots compared to the number
+// of bytes the line can transmit during the window (10 bits per byte). It's above 100 %
+// when the bytes are written faster than the line transmits them.
+
+void     utilization_begin(uint8_t s, uint32_t speed);
+void     utilization_add(uint8_t s, uint32_t bytes);
+void     utilization_update(uint32_t now);
+uint32_t utilization_percent(uint8_t s);
+
+#endif